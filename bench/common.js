@@ -0,0 +1,109 @@
+// Helpers shared by the benchmark scripts in this directory.
+
+var childProcess = require('child_process');
+
+// Milliseconds from an arbitrary start, with sub-millisecond resolution where
+// the runtime has it.
+exports.now = process.hrtime ? function () {
+  var t = process.hrtime();
+  return t[0] * 1e3 + t[1] / 1e6;
+} : Date.now;
+
+// Sorts samples in place and returns { count, mean, p50, p90, p99, max }.
+exports.percentiles = function (samples) {
+  samples.sort(function (a, b) { return a - b; });
+  var n = samples.length, sum = 0;
+  for (var i = 0; i < n; i++) sum += samples[i];
+  function at(p) { return n ? samples[Math.min(n - 1, Math.floor(p * n))] : 0; }
+  return {
+    count: n,
+    mean: n ? sum / n : 0,
+    p50: at(0.5),
+    p90: at(0.9),
+    p99: at(0.99),
+    max: n ? samples[n - 1] : 0
+  };
+};
+
+exports.rss = function () {
+  return process.memoryUsage().rss;
+};
+
+exports.mb = function (bytes) {
+  return (bytes / (1024 * 1024)).toFixed(1) + 'MB';
+};
+
+exports.ms = function (value) {
+  return value.toFixed(value < 10 ? 2 : 1) + 'ms';
+};
+
+// Replaces Math.random with a fixed sequence so runs are comparable.
+exports.seedRandom = function (seed) {
+  var state = seed >>> 0 || 1;
+  Math.random = function () {
+    // xorshift32
+    state ^= state << 13; state >>>= 0;
+    state ^= state >>> 17;
+    state ^= state << 5; state >>>= 0;
+    return state / 4294967296;
+  };
+};
+
+// Parses --name value and --flag options; the rest are returned in `names`.
+exports.parseArgs = function (argv, defaults) {
+  var options = {}, names = [];
+  for (var key in defaults) options[key] = defaults[key];
+  for (var i = 0; i < argv.length; i++) {
+    var arg = argv[i];
+    if (arg.slice(0, 2) !== '--') { names.push(arg); continue; }
+    key = arg.slice(2);
+    if (typeof options[key] === 'boolean') options[key] = true;
+    else if (typeof options[key] === 'number') options[key] = Number(argv[++i]);
+    else options[key] = argv[++i];
+  }
+  options.names = names;
+  return options;
+};
+
+// Child processes print their result as a single line starting with this.
+var RESULT = 'RESULT ';
+
+exports.report = function (result) {
+  console.log(RESULT + JSON.stringify(result));
+};
+
+// Runs `script` with `args` in a fresh node process under the dummy video
+// driver and calls back with the object it reported.  The child's stderr is
+// passed through so progress shows up while it runs; `flags` go to node.
+exports.runChild = function (script, args, callback, flags) {
+  var env = {};
+  for (var key in process.env) env[key] = process.env[key];
+  env.SDL_VIDEODRIVER = 'dummy';
+  if (!env.SDL_AUDIODRIVER) env.SDL_AUDIODRIVER = 'dummy';
+  var child = childProcess.spawn(process.execPath, (flags || []).concat([script], args), {
+    env: env
+  });
+  var stdout = '';
+  child.stdout.on('data', function (chunk) { stdout += chunk; });
+  child.stderr.on('data', function (chunk) { process.stderr.write(chunk); });
+
+  // The result may still be in the pipe when the child exits, so wait for
+  // the end of stdout as well.  ('close' does both, but only from node 0.7.)
+  var pending = 2, status;
+  function finish() {
+    if (--pending) return;
+    var lines = stdout.split('\n');
+    for (var i = lines.length - 1; i >= 0; i--) {
+      if (lines[i].slice(0, RESULT.length) === RESULT) {
+        return callback(null, JSON.parse(lines[i].slice(RESULT.length)));
+      }
+    }
+    callback(new Error(status.signal ? 'killed by ' + status.signal
+      : 'exited with ' + status.code + ' and no result'));
+  }
+  child.stdout.on('end', finish);
+  child.on('exit', function (code, signal) {
+    status = { code: code, signal: signal };
+    finish();
+  });
+};
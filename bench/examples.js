@@ -0,0 +1,143 @@
+// The examples as repeatable workloads.  They drive themselves with
+// setInterval; load() captures those callbacks instead, and frame() calls
+// each of them once after pushing that frame's scripted input through
+// SDL.pushEvent.  Date.now advances 16ms a frame and Math.random is seeded,
+// so every run does the same work.  Run them under the dummy video driver,
+// one per process.
+
+var path = require('path');
+var common = require('./common');
+
+var EXAMPLES = path.join(__dirname, '..', 'examples');
+var FRAME_MS = 16;
+
+// Keys the examples react to.
+var KEY_C = 99;
+
+var scenarios = exports.scenarios = {
+  // Isometric tile map, ~300 colour keyed blits a frame.
+  tiles: {
+    file: 'img.js'
+  },
+
+  // The same map and two walking objects, drawn by one SDL.ISO.draw a frame.
+  iso: {
+    file: 'iso.js'
+  },
+
+  // One blit and flip a frame; 'c' pauses and resumes drawing.
+  boxes: {
+    file: 'BoxShower.js',
+    input: function (frame, push) {
+      var phase = frame % 240;
+      if (phase === 200 || phase === 220) {
+        push({ type: 'KEYDOWN', sym: KEY_C, mod: 0, scancode: 0, unicode: 0 });
+        push({ type: 'KEYUP', sym: KEY_C, mod: 0, scancode: 0, unicode: 0 });
+      }
+    }
+  },
+
+  // Two joystick players swing into each other and a mouse drag circles the
+  // screen, both of which spawn sparks: many small fills a frame.
+  chaser: {
+    file: 'Chaser.js',
+    joysticks: 2,
+    input: function (frame, push) {
+      var swing = Math.round(Math.sin(frame / 30) * 32767);
+      push({ type: 'JOYAXISMOTION', which: 0, axis: 1, value: -swing });
+      push({ type: 'JOYAXISMOTION', which: 1, axis: 1, value: swing });
+      if (frame % 10 === 0) {
+        var a = frame / 50;
+        push({
+          type: 'MOUSEMOTION', state: 1, which: 0,
+          x: 512 + Math.round(Math.cos(a) * 300), y: 384 + Math.round(Math.sin(a) * 300),
+          xrel: 0, yrel: 0
+        });
+      }
+    }
+  },
+
+  // A line of text rendered, blitted and freed a frame.
+  fonts: {
+    file: 'Fonts.js'
+  },
+
+  // Ten 256x256 alpha blits a frame.
+  surface: {
+    file: 'surface.js'
+  }
+};
+
+// Namespaces on the addon whose functions get counted along with its own.
+var NAMESPACES = ['IMG', 'TTF', 'WM', 'AUDIO', 'ISO', 'eventRing'];
+
+function countCalls(SDL, counts) {
+  function wrap(object, prefix) {
+    Object.keys(object).forEach(function (name) {
+      var fn = object[name];
+      if (typeof fn !== 'function') return;
+      var key = prefix + name;
+      object[name] = function () {
+        counts[key] = (counts[key] || 0) + 1;
+        return fn.apply(this, arguments);
+      };
+    });
+  }
+  wrap(SDL, '');
+  NAMESPACES.forEach(function (ns) {
+    if (SDL[ns] && typeof SDL[ns] === 'object') wrap(SDL[ns], ns + '.');
+  });
+}
+
+// Loads a scenario.  With `count` set, calls to the binding made by the
+// example are counted by name in the returned `counts`.
+exports.load = function (name, count) {
+  var scenario = scenarios[name];
+  if (!scenario) throw new Error('Unknown scenario ' + name);
+  var SDL = require('../sdl');
+
+  common.seedRandom(1);
+  var clock = 0;
+  Date.now = function () { return clock; };
+
+  // The dummy driver reports no desktop size and an 8 bit format; give
+  // examples that ask for "whatever the screen is" a fixed 32 bit one.
+  var setVideoMode = SDL.setVideoMode;
+  SDL.setVideoMode = function (w, h, bpp, flags) {
+    return setVideoMode(w || 1024, h || 768, bpp || 32, flags);
+  };
+
+  // Stand-ins for joysticks; their input arrives as pushed events.
+  if (scenario.joysticks) {
+    SDL.numJoysticks = function () { return scenario.joysticks; };
+    SDL.joystickOpen = function (index) { return { index: index }; };
+    SDL.joystickName = function (index) { return 'Scripted joystick ' + index; };
+  }
+
+  var pushEvent = SDL.pushEvent;
+  var counts = {};
+  if (count) countCalls(SDL, counts);
+
+  var timers = [];
+  var setIntervalWas = global.setInterval;
+  global.setInterval = function (fn) {
+    timers.push(fn);
+    return timers.length;
+  };
+  require(path.join(EXAMPLES, scenario.file));
+  global.setInterval = setIntervalWas;
+  if (!timers.length) throw new Error(name + ": the example doesn't run a frame loop");
+
+  var input = scenario.input;
+  return {
+    SDL: SDL,
+    counts: counts,
+
+    // Feeds the input for frame number `frame` and runs the frame.
+    frame: function (frame) {
+      if (input) input(frame, pushEvent);
+      clock += FRAME_MS;
+      for (var i = 0; i < timers.length; i++) timers[i]();
+    }
+  };
+};
@@ -0,0 +1,316 @@
+// Image decoding throughput: IMG.load on the JS thread, IMG.loadAsync with
+// several loads in flight and IMG.loadBatch on 1..N threads, each with and
+// without conversion to the screen's format.  Reports images/sec, MB/s of
+// files read and of pixels produced, and peak resident memory.
+//
+//   node bench/images.js [--seconds 2] [--threads 1,2,4,8] [--corpus dir]
+//                        [--json] [mode ...]
+//
+// The corpus is the example PNGs plus generated RGBA PNGs of 256, 1024 and
+// 2048 pixels square (cached in the temp directory), plus every .png, .jpg,
+// .jpeg and .bmp file in --corpus.  loadAsync runs on node's thread pool, so
+// beyond its size more loads in flight don't add threads.  Each run is a
+// separate process.
+
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
+var common = require('./common');
+
+// Only APIs node 0.4 has, or feature tests for them: node 0.4 has no zlib,
+// and tmpdir, existsSync and Buffer.concat came later.
+var zlib = null;
+try { zlib = require('zlib'); } catch (e) {}
+var existsSync = fs.existsSync || path.existsSync;
+var TMP_DIR = os.tmpdir ? os.tmpdir() : process.env.TMPDIR || process.env.TEMP || '/tmp';
+
+var EXAMPLES = path.join(__dirname, '..', 'examples');
+var GENERATED_SIZES = [256, 1024, 2048];
+
+// A PNG writer, just enough to make test images.
+
+function writeUInt32BE(buf, value, offset) {
+  buf[offset] = (value >>> 24) & 0xff;
+  buf[offset + 1] = (value >>> 16) & 0xff;
+  buf[offset + 2] = (value >>> 8) & 0xff;
+  buf[offset + 3] = value & 0xff;
+}
+
+function concat(buffers) {
+  var length = 0, offset = 0;
+  buffers.forEach(function (buf) { length += buf.length; });
+  var result = new Buffer(length);
+  buffers.forEach(function (buf) {
+    buf.copy(result, offset, 0, buf.length);
+    offset += buf.length;
+  });
+  return result;
+}
+
+var CRC_TABLE = [];
+for (var n = 0; n < 256; n++) {
+  var c = n;
+  for (var k = 0; k < 8; k++) c = c & 1 ? 0xedb88320 ^ (c >>> 1) : c >>> 1;
+  CRC_TABLE[n] = c >>> 0;
+}
+
+function crc32(buffers) {
+  var crc = 0xffffffff;
+  buffers.forEach(function (buf) {
+    for (var i = 0; i < buf.length; i++) crc = CRC_TABLE[(crc ^ buf[i]) & 0xff] ^ (crc >>> 8);
+  });
+  return (crc ^ 0xffffffff) >>> 0;
+}
+
+// A zlib stream of stored blocks, for when there's no zlib to compress with.
+function store(raw) {
+  var blocks = Math.max(1, Math.ceil(raw.length / 65535));
+  var out = new Buffer(2 + blocks * 5 + raw.length + 4), o = 2;
+  out[0] = 0x78;
+  out[1] = 0x01;
+  for (var i = 0; i < blocks; i++) {
+    var start = i * 65535, length = Math.min(65535, raw.length - start);
+    out[o++] = i === blocks - 1 ? 1 : 0;
+    out[o++] = length & 0xff;
+    out[o++] = length >>> 8;
+    out[o++] = ~length & 0xff;
+    out[o++] = (~length >>> 8) & 0xff;
+    raw.copy(out, o, start, start + length);
+    o += length;
+  }
+  var a = 1, b = 0;
+  for (var j = 0; j < raw.length; j++) {
+    a = (a + raw[j]) % 65521;
+    b = (b + a) % 65521;
+  }
+  writeUInt32BE(out, ((b << 16) | a) >>> 0, o);
+  return out;
+}
+
+function deflate(raw, callback) {
+  if (zlib) zlib.deflate(raw, callback);
+  else callback(null, store(raw));
+}
+
+function chunk(type, data) {
+  var head = new Buffer(8), tail = new Buffer(4);
+  writeUInt32BE(head, data.length, 0);
+  head.write(type, 4, 'ascii');
+  writeUInt32BE(tail, crc32([head.slice(4, 8), data]), 0);
+  return concat([head, data, tail]);
+}
+
+function encodePNG(width, height, rgba, callback) {
+  var ihdr = new Buffer(13);
+  writeUInt32BE(ihdr, width, 0);
+  writeUInt32BE(ihdr, height, 4);
+  ihdr[8] = 8;   // bits per channel
+  ihdr[9] = 6;   // RGBA
+  ihdr[10] = ihdr[11] = ihdr[12] = 0;
+  var stride = width * 4, raw = new Buffer((stride + 1) * height);
+  for (var y = 0; y < height; y++) {
+    raw[y * (stride + 1)] = 0;   // no filter
+    rgba.copy(raw, y * (stride + 1) + 1, y * stride, (y + 1) * stride);
+  }
+  deflate(raw, function (err, data) {
+    if (err) return callback(err);
+    callback(null, concat([
+      new Buffer([0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a]),
+      chunk('IHDR', ihdr),
+      chunk('IDAT', data),
+      chunk('IEND', new Buffer(0))
+    ]));
+  });
+}
+
+function generatedFile(size) {
+  return path.join(TMP_DIR, 'node-sdl-bench-' + size + '.png');
+}
+
+// Gradients with a little noise and soft alpha edges, so the files compress
+// about as well as game art does (on node 0.4 they're stored uncompressed).
+function generate(size, callback) {
+  var file = generatedFile(size);
+  if (existsSync(file)) return callback(null);
+  common.seedRandom(size);
+  var rgba = new Buffer(size * size * 4);
+  for (var y = 0, i = 0; y < size; y++) {
+    for (var x = 0; x < size; x++, i += 4) {
+      var noise = Math.random() * 6;
+      rgba[i] = (x * 255 / size + noise) & 0xff;
+      rgba[i + 1] = (y * 255 / size + noise) & 0xff;
+      rgba[i + 2] = ((x + y) * 127 / size) & 0xff;
+      var edge = Math.min(x, y, size - 1 - x, size - 1 - y);
+      rgba[i + 3] = edge < 16 ? edge * 16 : 255;
+    }
+  }
+  encodePNG(size, size, rgba, function (err, png) {
+    if (err) return callback(err);
+    fs.writeFileSync(file, png);
+    callback(null);
+  });
+}
+
+// Writes the generated images that aren't cached yet.
+function prepare(callback) {
+  (function next(i) {
+    if (i === GENERATED_SIZES.length) return callback(null);
+    generate(GENERATED_SIZES[i], function (err) {
+      if (err) return callback(err);
+      next(i + 1);
+    });
+  })(0);
+}
+
+function corpus(dir) {
+  var files = ['tiles.png', 'rock.png', 'eight.png'].map(function (name) {
+    return path.join(EXAMPLES, name);
+  });
+  files = files.concat(GENERATED_SIZES.map(generatedFile));
+  if (dir) {
+    fs.readdirSync(dir).forEach(function (name) {
+      if (/\.(png|jpe?g|bmp)$/i.test(name)) files.push(path.join(dir, name));
+    });
+  }
+  return files;
+}
+
+// Each mode calls back with the surfaces it loaded from one pass over the
+// corpus; the caller frees them.
+
+var modes = {
+  load: function (SDL, files, options, callback) {
+    var surfaces = files.map(function (file) {
+      var image = SDL.IMG.load(file);
+      if (!options.displayFormat) return image;
+      var converted = SDL.displayFormat(image);
+      SDL.freeSurface(image);
+      return converted;
+    });
+    callback(null, surfaces);
+  },
+
+  async: function (SDL, files, options, callback) {
+    var surfaces = [], started = 0, done = 0, failed = null;
+    function start() {
+      var i = started++;
+      SDL.IMG.loadAsync(files[i], { displayFormat: options.displayFormat }, function (err, image) {
+        if (err) failed = err;
+        else surfaces[i] = image;
+        if (started < files.length) start();
+        if (++done === files.length) callback(failed, surfaces);
+      });
+    }
+    for (var i = 0; i < Math.min(options.threads, files.length); i++) start();
+  },
+
+  batch: function (SDL, files, options, callback) {
+    SDL.IMG.loadBatch(files, options, callback);
+  }
+};
+
+function run(mode, threads, displayFormat, options) {
+  var SDL = require('../sdl');
+  SDL.init(SDL.INIT.VIDEO);
+  SDL.setVideoMode(64, 64, 32, 0);
+  SDL.IMG.init(0);
+
+  var files = corpus(options.corpus);
+  var fileBytes = files.map(function (file) { return fs.statSync(file).size; });
+  var settings = { threads: threads, displayFormat: displayFormat };
+  var images = 0, readBytes = 0, pixelBytes = 0, rssPeak = common.rss();
+  var start = common.now();
+
+  (function pass() {
+    modes[mode](SDL, files, settings, function (err, surfaces) {
+      if (err) throw err;
+      rssPeak = Math.max(rssPeak, common.rss());
+      surfaces.forEach(function (surface, i) {
+        images++;
+        readBytes += fileBytes[i];
+        pixelBytes += surface.pitch * surface.h;
+        SDL.freeSurface(surface);
+      });
+      var elapsed = (common.now() - start) / 1000;
+      if (elapsed < options.seconds) return process.nextTick(pass);
+
+      common.report({
+        mode: mode,
+        threads: threads,
+        displayFormat: displayFormat,
+        files: files.length,
+        images: images,
+        seconds: elapsed,
+        imagesPerSecond: images / elapsed,
+        readMBPerSecond: readBytes / elapsed / (1024 * 1024),
+        pixelMBPerSecond: pixelBytes / elapsed / (1024 * 1024),
+        rssPeak: rssPeak
+      });
+      process.exit(0);
+    });
+  })();
+}
+
+function print(result) {
+  console.log('%s threads %d%s: %s images/s, %s MB/s read, %s MB/s pixels, peak rss %s',
+    result.mode, result.threads, result.displayFormat ? ' +displayFormat' : '',
+    result.imagesPerSecond.toFixed(1), result.readMBPerSecond.toFixed(1),
+    result.pixelMBPerSecond.toFixed(1), common.mb(result.rssPeak));
+}
+
+var defaultThreads = [1, 2, 4, 8].filter(function (n) {
+  return n <= os.cpus().length;
+});
+if (defaultThreads.indexOf(os.cpus().length) < 0) defaultThreads.push(os.cpus().length);
+
+var options = common.parseArgs(process.argv.slice(2), {
+  seconds: 2,
+  threads: defaultThreads.join(','),
+  corpus: '',
+  json: false,
+  child: false,
+  convert: false
+});
+
+if (options.child) {
+  run(options.names[0], Number(options.names[1]), options.convert, options);
+} else {
+  var names = options.names.length ? options.names : Object.keys(modes);
+  var threads = options.threads.split(',').map(Number);
+  var runs = [];
+  names.forEach(function (mode) {
+    if (!modes[mode]) {
+      console.error('Unknown mode %s (have %s)', mode, Object.keys(modes).join(', '));
+      process.exit(1);
+    }
+    // load only ever uses the JS thread.
+    (mode === 'load' ? [1] : threads).forEach(function (n) {
+      runs.push([mode, n, false], [mode, n, true]);
+    });
+  });
+  // Generate the corpus once, not in every child.
+  prepare(function (err) {
+    if (err) throw err;
+    var results = [], failed = false;
+    (function next(i) {
+      if (i === runs.length) {
+        if (options.json) console.log(JSON.stringify(results, null, 2));
+        process.exit(failed ? 1 : 0);
+      }
+      var run = runs[i];
+      var args = ['--child', '--seconds', String(options.seconds)];
+      if (options.corpus) args.push('--corpus', options.corpus);
+      if (run[2]) args.push('--convert');
+      common.runChild(__filename, args.concat([run[0], String(run[1])]), function (err, result) {
+        if (err) {
+          console.error('%s threads %d failed: %s', run[0], run[1], err.message);
+          failed = true;
+        } else {
+          results.push(result);
+          if (!options.json) print(result);
+        }
+        next(i + 1);
+      });
+    })(0);
+  });
+}
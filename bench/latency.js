@@ -0,0 +1,144 @@
+// Measures how long input takes from entering SDL's queue to reaching a JS
+// handler.  A native thread (SDL.INJECT) pushes USEREVENTs at a steady rate
+// and each handler asks how long ago its event was pushed.
+//
+//   node bench/latency.js [--seconds 3] [--rates 60,500,2000] [--json] [mode ...]
+//
+// Modes are the ways a program can take events off the queue:
+//
+//   interval  SDL.events listeners, polled every 16ms by sdl.js
+//   wait      SDL.waitEvent, then pollEvent until the queue is empty
+//   poll      pollEvent from a setImmediate loop, as fast as JS can go
+//   ring      pumpEventRing and eventRing.read every 1ms
+//
+// Besides latency percentiles it reports events SDL refused because its queue
+// (128 events) was full, events the ring dropped, and events that never
+// arrived.  Each mode and rate runs in its own process.
+
+var common = require('./common');
+
+var GRACE_MS = 1000;   // wait this long after the last push for stragglers
+
+var modes = {
+  interval: function (SDL, deliver) {
+    SDL.events.on('USEREVENT', deliver);
+  },
+
+  wait: function (SDL, deliver) {
+    (function wait() {
+      SDL.waitEvent(function (err, evt) {
+        if (err) throw err;
+        if (evt) deliver(evt);
+        while (evt = SDL.pollEvent()) deliver(evt);
+        wait();
+      });
+    })();
+  },
+
+  poll: function (SDL, deliver) {
+    var later = typeof setImmediate === 'function' ? setImmediate : function (fn) {
+      setTimeout(fn, 0);
+    };
+    (function poll() {
+      var evt;
+      while (evt = SDL.pollEvent()) deliver(evt);
+      later(poll);
+    })();
+  },
+
+  ring: function (SDL, deliver) {
+    var ring = SDL.createEventRing(4096);
+    setInterval(function () {
+      SDL.pumpEventRing(ring);
+      SDL.eventRing.read(ring, deliver);
+    }, 1);
+    return function () { return SDL.eventRing.dropped(ring); };
+  }
+};
+
+function run(mode, rate, options) {
+  var SDL = require('../sdl');
+  SDL.init(SDL.INIT.VIDEO);
+  SDL.setVideoMode(64, 64, 32, 0);
+
+  var latencies = [];
+  function deliver(evt) {
+    if (evt.type === 'USEREVENT') latencies.push(SDL.INJECT.age(evt.code));
+  }
+  var dropped = modes[mode](SDL, deliver) || function () { return 0; };
+
+  var count = Math.max(1, Math.round(rate * options.seconds));
+  SDL.INJECT.start(rate, count);
+
+  var doneAt = 0;
+  setInterval(function () {
+    var stats = SDL.INJECT.stats();
+    if (!stats.done) return;
+    var now = common.now();
+    if (!doneAt) doneAt = now;
+    var accounted = latencies.length + stats.failed + dropped();
+    if (accounted < stats.sent && now - doneAt < GRACE_MS) return;
+
+    common.report({
+      mode: mode,
+      rate: rate,
+      sent: stats.sent,
+      received: latencies.length,
+      queueFull: stats.failed,
+      ringDropped: dropped(),
+      lost: Math.max(0, stats.sent - accounted),
+      latency: common.percentiles(latencies)
+    });
+    SDL.INJECT.stop();
+    process.exit(0);
+  }, 50);
+}
+
+function print(result) {
+  var t = result.latency;
+  console.log('%s @ %d/s: p50 %s  p90 %s  p99 %s  max %s  (%d/%d delivered, %d queue full, %d ring dropped, %d lost)',
+    result.mode, result.rate, common.ms(t.p50), common.ms(t.p90), common.ms(t.p99), common.ms(t.max),
+    result.received, result.sent, result.queueFull, result.ringDropped, result.lost);
+}
+
+var options = common.parseArgs(process.argv.slice(2), {
+  seconds: 3,
+  rates: '60,500,2000',
+  json: false,
+  child: false
+});
+
+if (options.child) {
+  run(options.names[0], Number(options.names[1]), options);
+} else {
+  var names = options.names.length ? options.names : Object.keys(modes);
+  var rates = options.rates.split(',').map(Number);
+  var runs = [];
+  names.forEach(function (mode) {
+    if (!modes[mode]) {
+      console.error('Unknown mode %s (have %s)', mode, Object.keys(modes).join(', '));
+      process.exit(1);
+    }
+    rates.forEach(function (rate) { runs.push([mode, rate]); });
+  });
+
+  var results = [], failed = false;
+  (function next(i) {
+    if (i === runs.length) {
+      if (options.json) console.log(JSON.stringify(results, null, 2));
+      process.exit(failed ? 1 : 0);
+    }
+    common.runChild(__filename, [
+      '--child', '--seconds', String(options.seconds), runs[i][0], String(runs[i][1])
+    ], function (err, result) {
+      if (err) {
+        console.error('%s @ %d/s failed: %s', runs[i][0], runs[i][1], err.message);
+        failed = true;
+      } else {
+        results.push(result);
+        if (!options.json) print(result);
+      }
+      next(i + 1);
+    });
+  })(0);
+}
@@ -0,0 +1,114 @@
+// Replays the examples headless (see examples.js) for a fixed number of
+// frames and reports frame time percentiles, binding calls per frame and
+// resident memory.
+//
+//   node bench/scenarios.js [--frames 600] [--warmup 60] [--json] [scenario ...]
+//
+// Each scenario runs in its own process.
+
+var common = require('./common');
+var examples = require('./examples');
+
+function run(name, options) {
+  var example = examples.load(name, true);
+  var counts = example.counts;
+  var alloc = example.SDL.ALLOC;
+  var times = [];
+  var rssStart = 0, rssPeak = 0;
+  var total = options.warmup + options.frames;
+
+  for (var frame = 0; frame < total; frame++) {
+    if (frame === options.warmup) {
+      for (var key in counts) delete counts[key];
+      alloc.enable(true);
+      alloc.reset();
+      rssStart = rssPeak = common.rss();
+    }
+    var start = common.now();
+    example.frame(frame);
+    if (frame >= options.warmup) {
+      times.push(common.now() - start);
+      if (frame % 60 === 0) rssPeak = Math.max(rssPeak, common.rss());
+    }
+  }
+
+  var rssEnd = common.rss();
+  var allocs = alloc.read().total;
+  delete counts['ALLOC.read'];
+
+  var perFrame = {}, calls = 0;
+  Object.keys(counts).forEach(function (key) {
+    calls += counts[key];
+    perFrame[key] = counts[key] / options.frames;
+  });
+
+  common.report({
+    scenario: name,
+    frames: options.frames,
+    frameTime: common.percentiles(times),
+    callsPerFrame: calls / options.frames,
+    calls: perFrame,
+    objectsPerFrame: allocs.objects / options.frames,
+    stringsPerFrame: allocs.strings / options.frames,
+    rssStart: rssStart,
+    rssEnd: rssEnd,
+    rssPeak: Math.max(rssPeak, rssEnd)
+  });
+}
+
+function print(result) {
+  var t = result.frameTime;
+  console.log('%s: %d frames', result.scenario, result.frames);
+  console.log('  frame time  p50 %s  p90 %s  p99 %s  max %s  mean %s',
+    common.ms(t.p50), common.ms(t.p90), common.ms(t.p99), common.ms(t.max), common.ms(t.mean));
+  var top = Object.keys(result.calls).sort(function (a, b) {
+    return result.calls[b] - result.calls[a];
+  }).slice(0, 5).map(function (key) {
+    return key + ' ' + result.calls[key].toFixed(1);
+  });
+  console.log('  calls/frame %s (%s)', result.callsPerFrame.toFixed(1), top.join(', '));
+  console.log('  allocs/frame %s objects, %s strings',
+    result.objectsPerFrame.toFixed(1), result.stringsPerFrame.toFixed(1));
+  console.log('  rss %s -> %s, peak %s',
+    common.mb(result.rssStart), common.mb(result.rssEnd), common.mb(result.rssPeak));
+}
+
+var options = common.parseArgs(process.argv.slice(2), {
+  frames: 600,
+  warmup: 60,
+  json: false,
+  child: false
+});
+
+if (options.child) {
+  run(options.names[0], options);
+  process.exit(0);
+}
+
+var scenarios = examples.scenarios;
+var names = options.names.length ? options.names : Object.keys(scenarios);
+var results = [], failed = false;
+(function next(i) {
+  if (i === names.length) {
+    if (options.json) console.log(JSON.stringify(results, null, 2));
+    if (failed) process.exit(1);
+    return;
+  }
+  var name = names[i];
+  if (!scenarios[name]) {
+    console.error('Unknown scenario %s (have %s)', name, Object.keys(scenarios).join(', '));
+    process.exit(1);
+  }
+  common.runChild(__filename, [
+    '--child', '--frames', String(options.frames), '--warmup', String(options.warmup), name
+  ], function (err, result) {
+    if (err) {
+      console.error('%s failed: %s', name, err.message);
+      failed = true;
+    } else {
+      results.push(result);
+      if (!options.json) print(result);
+    }
+    next(i + 1);
+  });
+})(0);
@@ -0,0 +1,162 @@
+// Runs the examples' render loops headless (see examples.js) for a long time
+// and fails when memory keeps growing: resident size, the V8 heap after a
+// full collection, or the surfaces JS holds (SDL.ALLOC.surfaces()).
+//
+//   node bench/soak.js [--minutes 60] [--sample 10] [--warmup 30]
+//                      [--rss 32] [--heap 16] [--surfaces 0] [--json] [scenario ...]
+//
+// Frames run back to back, so an hour here covers several hours of a game
+// running at 60fps.  Memory is sampled every --sample seconds; the first
+// sample after --warmup seconds is the baseline, and growth is the lowest
+// reading over the last quarter of the run minus the baseline, which ignores
+// garbage that just hasn't been collected yet.  Limits are in MB, surfaces in
+// count.  Exits with 1 when a limit is exceeded.
+
+var common = require('./common');
+var examples = require('./examples');
+
+var MB = 1024 * 1024;
+
+function sample(SDL, elapsed, frames) {
+  if (global.gc) global.gc();
+  var memory = process.memoryUsage();
+  var surfaces = SDL.ALLOC.surfaces();
+  return {
+    seconds: elapsed / 1000,
+    frames: frames,
+    rss: memory.rss,
+    heap: memory.heapUsed,
+    surfaces: surfaces.count,
+    surfaceBytes: surfaces.bytes
+  };
+}
+
+// Least squares slope of `key` over time, per hour.
+function slope(samples, key) {
+  var n = samples.length;
+  if (n < 2) return 0;
+  var sx = 0, sy = 0, sxx = 0, sxy = 0;
+  samples.forEach(function (s) {
+    var x = s.seconds / 3600;
+    sx += x; sy += s[key]; sxx += x * x; sxy += x * s[key];
+  });
+  var d = n * sxx - sx * sx;
+  return d ? (n * sxy - sx * sy) / d : 0;
+}
+
+function run(name, options) {
+  var example = examples.load(name, false);
+  var SDL = example.SDL;
+  var start = common.now();
+  var duration = options.minutes * 60000;
+  var interval = options.sample * 1000;
+  var samples = [sample(SDL, 0, 0)];
+  var next = interval;
+  var frame = 0;
+
+  for (;;) {
+    // Check the clock every few frames rather than every frame.
+    for (var i = 0; i < 16; i++) example.frame(frame++);
+    var elapsed = common.now() - start;
+    if (elapsed < next) continue;
+    var s = sample(SDL, elapsed, frame);
+    samples.push(s);
+    console.error('%s %ss: %d frames, rss %s, heap %s, %d surfaces (%s)',
+      name, Math.round(s.seconds), s.frames, common.mb(s.rss), common.mb(s.heap),
+      s.surfaces, common.mb(s.surfaceBytes));
+    next += interval;
+    if (elapsed >= duration) break;
+  }
+
+  var measured = samples.filter(function (s) { return s.seconds >= options.warmup; });
+  if (!measured.length) measured = samples.slice(-1);
+  var baseline = measured[0];
+  var tail = measured.slice(Math.floor(measured.length * 3 / 4));
+  function growth(key) {
+    var low = Infinity;
+    tail.forEach(function (s) { low = Math.min(low, s[key]); });
+    return low - baseline[key];
+  }
+
+  var result = {
+    scenario: name,
+    seconds: samples[samples.length - 1].seconds,
+    frames: frame,
+    baseline: baseline,
+    growth: {
+      rss: growth('rss'),
+      heap: growth('heap'),
+      surfaces: samples[samples.length - 1].surfaces - baseline.surfaces,
+      surfaceBytes: samples[samples.length - 1].surfaceBytes - baseline.surfaceBytes
+    },
+    perHour: {
+      rss: slope(measured, 'rss'),
+      heap: slope(measured, 'heap'),
+      surfaces: slope(measured, 'surfaces')
+    },
+    samples: samples
+  };
+
+  result.failures = [];
+  if (result.growth.rss > options.rss * MB) result.failures.push('rss');
+  if (result.growth.heap > options.heap * MB) result.failures.push('heap');
+  if (result.growth.surfaces > options.surfaces) result.failures.push('surfaces');
+  common.report(result);
+}
+
+function print(result) {
+  var g = result.growth, h = result.perHour;
+  console.log('%s: %s after %d frames in %dmin', result.scenario,
+    result.failures.length ? 'FAIL (' + result.failures.join(', ') + ')' : 'ok',
+    result.frames, Math.round(result.seconds / 60));
+  console.log('  rss      %s growth, %s/hour', common.mb(g.rss), common.mb(h.rss));
+  console.log('  heap     %s growth, %s/hour', common.mb(g.heap), common.mb(h.heap));
+  console.log('  surfaces %d growth (%s), %s/hour', g.surfaces, common.mb(g.surfaceBytes),
+    h.surfaces.toFixed(1));
+}
+
+var options = common.parseArgs(process.argv.slice(2), {
+  minutes: 60,
+  sample: 10,
+  warmup: 30,
+  rss: 32,
+  heap: 16,
+  surfaces: 0,
+  json: false,
+  child: false
+});
+
+if (options.child) {
+  run(options.names[0], options);
+  process.exit(0);
+}
+
+var scenarios = examples.scenarios;
+var names = options.names.length ? options.names : Object.keys(scenarios);
+var results = [], failed = false;
+(function next(i) {
+  if (i === names.length) {
+    if (options.json) console.log(JSON.stringify(results, null, 2));
+    process.exit(failed ? 1 : 0);
+  }
+  var name = names[i];
+  if (!scenarios[name]) {
+    console.error('Unknown scenario %s (have %s)', name, Object.keys(scenarios).join(', '));
+    process.exit(1);
+  }
+  var args = ['--child'];
+  ['minutes', 'sample', 'warmup', 'rss', 'heap', 'surfaces'].forEach(function (key) {
+    args.push('--' + key, String(options[key]));
+  });
+  common.runChild(__filename, args.concat([name]), function (err, result) {
+    if (err) {
+      console.error('%s failed: %s', name, err.message);
+      failed = true;
+    } else {
+      results.push(result);
+      if (result.failures.length) failed = true;
+      if (!options.json) print(result);
+    }
+    next(i + 1);
+  }, ['--expose-gc']);
+})(0);
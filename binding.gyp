@@ -1,4 +1,9 @@
 {
+  'variables': {
+    # node-gyp configure -- -Dusdt=1 compiles in the static tracepoints
+    # (needs sys/sdt.h, from systemtap-sdt-dev).
+    'usdt%': 0
+  },
   'targets': [
     {
       # have to specify 'liblib' here since gyp will remove the first one :\
@@ -6,15 +11,42 @@
       'sources': [
         'src/helpers.cc',
         'src/sdl.cc',
+        'src/eventring.cc',
+        'src/pixels.cc',
+        'src/stats.cc',
+        'src/workers.cc',
+        'src/quantize.cc',
+        'src/gif.cc',
+        'src/affine.cc',
+        'src/raster.cc',
+        'src/text.cc',
+        'src/glyphcache.cc',
+        'src/dsp.cc',
+        'src/vorbis.cc',
+        'src/audio.cc',
+        'src/alloctrack.cc',
+        'src/probes.cc',
+        'src/inject.cc',
+        'src/imgload.cc',
+        'src/assets.cc',
+        'src/taskgraph.cc',
+        'src/iso.cc',
+        'src/parallax.cc',
       ],
       'ldflags': [
         '<!@(sdl-config --libs)',
         "-lSDL_ttf",
-        "-lSDL_image"
+        "-lSDL_image",
+        "-lvorbisfile"
       ],
       'cflags': [
         '<!@(sdl-config --cflags)'
       ],
+      'conditions': [
+        ['usdt==1', {
+          'defines': [ 'NODE_SDL_USDT' ]
+        }]
+      ],
     }
   ]
 }
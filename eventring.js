@@ -0,0 +1,128 @@
+// Consumer side of the native event ring (see src/eventring.h for the layout).
+// This file doesn't load the addon so it can be required from any thread that
+// was handed the ring's memory.
+
+var HEADER_SIZE = 192,
+    RECORD_SIZE = 32,
+    CAPACITY = 2,  // Int32 indices into the header
+    DROPPED = 4,
+    HEAD = 16,
+    TAIL = 32;
+
+var TYPES = {
+  1: 'ACTIVEEVENT',
+  2: 'KEYDOWN',
+  3: 'KEYUP',
+  4: 'MOUSEMOTION',
+  5: 'MOUSEBUTTONDOWN',
+  6: 'MOUSEBUTTONUP',
+  7: 'JOYAXISMOTION',
+  8: 'JOYBALLMOTION',
+  9: 'JOYHATMOTION',
+  10: 'JOYBUTTONDOWN',
+  11: 'JOYBUTTONUP',
+  12: 'QUIT',
+  24: 'USEREVENT'
+};
+
+var hasAtomics = typeof Atomics !== 'undefined';
+
+// Accepts a Buffer, ArrayBuffer or SharedArrayBuffer holding the ring.
+function view(memory) {
+  if (memory.buffer) {
+    return new Int32Array(memory.buffer, memory.byteOffset, memory.byteLength >> 2);
+  }
+  return new Int32Array(memory);
+}
+
+function load(i32, index) {
+  return hasAtomics && isShared(i32) ? Atomics.load(i32, index) : i32[index];
+}
+
+function store(i32, index, value) {
+  if (hasAtomics && isShared(i32)) Atomics.store(i32, index, value);
+  else i32[index] = value;
+}
+
+function isShared(i32) {
+  return typeof SharedArrayBuffer !== 'undefined' && i32.buffer instanceof SharedArrayBuffer;
+}
+
+// Turns the record at Int32 index `base` into the same shape pollEvent returns.
+function decode(i32, base) {
+  var type = i32[base], f = base + 2;
+  var evt = { type: TYPES[type] || 'UNKNOWN', timestamp: i32[base + 1] >>> 0 };
+  switch (type) {
+    case 1:
+      evt.gain = !!i32[f]; evt.state = i32[f + 1];
+      break;
+    case 2: case 3:
+      evt.scancode = i32[f]; evt.sym = i32[f + 1]; evt.mod = i32[f + 2]; evt.unicode = i32[f + 3];
+      break;
+    case 4:
+      evt.which = i32[f]; evt.state = i32[f + 1]; evt.x = i32[f + 2]; evt.y = i32[f + 3];
+      evt.xrel = i32[f + 4]; evt.yrel = i32[f + 5];
+      break;
+    case 5: case 6:
+      evt.which = i32[f]; evt.button = i32[f + 1]; evt.x = i32[f + 2]; evt.y = i32[f + 3];
+      break;
+    case 7:
+      evt.which = i32[f]; evt.axis = i32[f + 1]; evt.value = i32[f + 2];
+      break;
+    case 8:
+      evt.which = i32[f]; evt.ball = i32[f + 1]; evt.xrel = i32[f + 2]; evt.yrel = i32[f + 3];
+      break;
+    case 9:
+      evt.which = i32[f]; evt.hat = i32[f + 1]; evt.value = i32[f + 2];
+      break;
+    case 10: case 11:
+      evt.which = i32[f]; evt.button = i32[f + 1];
+      break;
+    case 12:
+      break;
+    case 24:
+      evt.code = i32[f];
+      break;
+    default:
+      evt.typeCode = type;
+  }
+  return evt;
+}
+
+// Calls fn(event) for every unread record and marks them consumed.  Returns
+// the number of events delivered.
+exports.read = function (memory, fn) {
+  var i32 = view(memory);
+  var mask = i32[CAPACITY] - 1;
+  var head = load(i32, HEAD), tail = i32[TAIL], count = 0;
+  while (tail !== head) {
+    fn(decode(i32, (HEADER_SIZE + (tail & mask) * RECORD_SIZE) >> 2));
+    tail = (tail + 1) | 0;
+    count++;
+  }
+  store(i32, TAIL, tail);
+  return count;
+};
+
+// Blocks until the producer publishes past the current tail or timeout (ms)
+// elapses.  Only possible on shared memory where Atomics.wait is allowed.
+exports.wait = function (memory, timeout) {
+  var i32 = view(memory);
+  var tail = i32[TAIL];
+  if (load(i32, HEAD) !== tail) return 'ok';
+  return Atomics.wait(i32, HEAD, tail, timeout === undefined ? Infinity : timeout);
+};
+
+// Wakes consumers blocked in wait(); the producer calls this after a pump.
+exports.notify = function (memory) {
+  var i32 = view(memory);
+  if (hasAtomics && isShared(i32)) Atomics.notify(i32, HEAD);
+};
+
+exports.dropped = function (memory) {
+  return load(view(memory), DROPPED) >>> 0;
+};
+
+exports.byteLength = function (capacity) {
+  return HEADER_SIZE + capacity * RECORD_SIZE;
+};
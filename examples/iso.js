@@ -0,0 +1,153 @@
+var SDL = require('../sdl'),
+    IMG = SDL.IMG;
+
+var TILE_WIDTH = 99,
+    TILE_HEIGHT = 82;
+
+SDL.init(SDL.INIT.VIDEO);
+var screen = SDL.setVideoMode(1024,768,32,SDL.SURFACE.HWACCEL);
+
+SDL.WM.setCaption("Node Explorer", "Node Exlorer");
+SDL.WM.setIcon(IMG.load(__dirname + "/rock.png"));
+
+process.on('exit', function () { SDL.quit(); });
+
+// The same map as img.js, drawn by SDL.ISO in one call a frame.
+var t = IMG.load(__dirname + "/tiles.png");
+var tiles = SDL.displayFormat(t);
+SDL.setColorKey(tiles, SDL.SURFACE.SRCCOLORKEY|SDL.SURFACE.RLEACCEL, SDL.mapRGB(tiles.format, 255, 255, 255));
+SDL.freeSurface(t);
+
+var spriteData = require('./spriteData');
+
+// One sprite per name, in the order of spriteData.
+var names = Object.keys(spriteData);
+var sprites = names.map(function (name) {
+  var offsets = spriteData[name];
+  return [offsets[0], offsets[1], 101, 171, offsets[2] || 0];
+});
+function sprite(name) {
+  var index = names.indexOf(name);
+  if (index < 0) throw new Error("Invalid image name");
+  return index;
+}
+
+
+SDL.events.on("QUIT", function (evt) { process.exit(0); }); // Window close
+SDL.events.on("KEYDOWN", function (evt) {
+  if (evt.sym === 99 && evt.mod === 64) process.exit(0); // Control+C
+  if (evt.sym === 27 && evt.mod === 0) process.exit(0);  // ESC
+});
+
+var map = [
+  [
+    ["grass-block","grass-block","grass-block","grass-block","grass-block","grass-block","grass-block","water-block","water-block","water-block","grass-block"],
+    ["grass-block","grass-block","grass-block","grass-block","grass-block","grass-block","grass-block","water-block","water-block","water-block","grass-block"],
+    ["grass-block","grass-block","grass-block","grass-block","grass-block","grass-block","grass-block","water-block","water-block","water-block","grass-block"],
+    ["grass-block","grass-block","grass-block","grass-block","grass-block","grass-block","grass-block","water-block","water-block","water-block","grass-block"],
+    ["grass-block","grass-block","grass-block","grass-block","grass-block","grass-block","dirt-block","dirt-block","water-block","dirt-block","dirt-block"],
+    ["grass-block","grass-block","grass-block","grass-block","grass-block","grass-block","dirt-block","water-block","water-block","water-block","water-block"],
+    ["grass-block","grass-block","grass-block","grass-block","grass-block","grass-block","dirt-block","grass-block","water-block","water-block","water-block"],
+    ["grass-block","grass-block","grass-block","grass-block","grass-block","grass-block","dirt-block","grass-block","grass-block","grass-block","grass-block"],
+    ["grass-block","grass-block","grass-block","dirt-block","grass-block","dirt-block","dirt-block","dirt-block","dirt-block","dirt-block","dirt-block"],
+    ["grass-block","grass-block","grass-block","dirt-block","dirt-block","dirt-block","grass-block","grass-block","grass-block","grass-block","grass-block"],
+  ],
+  [
+    [null, null, null, null, null, null],
+    [null, null, null, null, null, null],
+    [null, null, null, null, null, null],
+    [null, "wood-block", "wood-block", "wood-block", "wood-block", "wood-block"],
+    [null, "wood-block", null, null, null, "wood-block",null, "ramp-west","stone-block","ramp-east"],
+    [null, "wood-block", null, null, null, "wood-block"],
+    [null, "wood-block", null, null, null, "wood-block"],
+    [null, "wood-block", "wood-block", "door-tall-closed", "wood-block", "wood-block"],
+  ],
+  [
+    [null, null, null, null, null, null],
+    [null, null, null, null, null, null],
+    [null, null, null, null, null, null],
+    [null, "wood-block", "window-tall", "wood-block", "window-tall", "wood-block"],
+    [null, "wood-block", null, null, null, "wood-block", null, null, "selector"],
+    [null, "wood-block", null, null, null, "wood-block"],
+    [null, "wood-block", null, null, null, "wood-block"],
+    [null, "wood-block", "window-tall", null, "window-tall", "wood-block"],
+  ],
+  [
+    [null, null, null, null, null, null],
+    [null, null, null, null, null, null],
+    [null, null, null, null, null, null],
+    [null, "wood-block", null, "wood-block", null, "wood-block"],
+    [null, "wood-block", null, null, null, "wood-block"],
+    [null, "wood-block", null, null, null, "wood-block"],
+    [null, "wood-block", null, null, null, "wood-block"],
+    [null, "wood-block", null, "wood-block", null, "wood-block"],
+  ],
+  [
+    [null, null, null, null, null, null],
+    [null, null, null, null, null, null],
+    [null, null, null, null, null, null],
+    [null, "roof-north-west", "roof-north", "roof-north", "roof-north", "roof-north-east"],
+    [null, "roof-west", "wood-block", "wood-block", "wood-block", "roof-east"],
+    [null, "roof-west", "wood-block", null, "wood-block", "roof-east"],
+    [null, "roof-west", "wood-block", "wood-block", "wood-block", "roof-east"],
+    [null, "roof-south-west", "roof-south", "roof-south", "roof-south", "roof-south-east"],
+  ],
+  [
+    [null, null, null, null, null, null],
+    [null, null, null, null, null, null],
+    [null, null, null, null, null, null],
+    [null, null, null, null, null, null],
+    [null, null, "wood-block", "window-tall", "wood-block", null],
+    [null, null, "wood-block", null, "wood-block", null],
+    [null, null, "wood-block", "window-tall", "wood-block", null],
+    [null, null, null, null, null, null],
+  ],
+  [
+    [null, null, null, null, null, null],
+    [null, null, null, null, null, null],
+    [null, null, null, null, null, null],
+    [null, null, null, null, null, null],
+    [null, null, "wood-block", null, "wood-block", null],
+    [null, null, "wood-block", null, "wood-block", null],
+    [null, null, "wood-block", null, "wood-block", null],
+    [null, null, null, null, null, null],
+  ],
+  [
+    [null, null, null, null, null, null],
+    [null, null, null, null, null, null],
+    [null, null, null, null, null, null],
+    [null, null, null, null, null, null],
+    [null, null, "roof-north-west", "roof-north", "roof-north-east", null],
+    [null, null, "roof-west", null, "roof-east", null],
+    [null, null, "roof-south-west", "roof-south", "roof-south-east", null],
+    [null, null, null, null, null, null],
+  ]
+];
+
+var world = SDL.ISO.createMap({
+  sheet: tiles,
+  sprites: sprites,
+  tileWidth: TILE_WIDTH,
+  tileHeight: TILE_HEIGHT,
+  layerHeight: TILE_HEIGHT / 2,
+  layers: map.map(function (layer) {
+    return layer.map(function (row) {
+      return row.map(function (cell) { return cell ? sprite(cell) : null; });
+    });
+  })
+});
+
+// A boy walks the dirt path and a bug crawls round the house.
+var boy = SDL.ISO.addObject(world, sprite("character-boy"), 6, 8, 1);
+var bug = SDL.ISO.addObject(world, sprite("enemy-bug"), 0, 2, 1);
+
+setInterval(function () {
+  var t = Date.now() / 1000;
+  SDL.ISO.moveObject(world, boy, 6.5 + Math.sin(t) * 3.5, 8, 1);
+  SDL.ISO.moveObject(world, bug, 3 + Math.cos(t / 2) * 3, 5.5 + Math.sin(t / 2) * 3.5, 1);
+
+  SDL.fillRect(screen, null, 0);
+  SDL.ISO.draw(world, screen, 20, 70);
+  SDL.flip(screen);
+
+}, 10);
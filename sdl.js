@@ -23,3 +23,17 @@ Object.defineProperty(SDL, 'events', {
   }
 });
 
+
+// Event ring helpers.  The ring is filled by SDL.pumpEventRing() on the thread
+// that owns SDL and read with SDL.eventRing.read() wherever its memory is
+// visible.
+SDL.eventRing = require('./eventring');
+
+SDL.createEventRing = function (capacity) {
+  var length = SDL.eventRing.byteLength(capacity);
+  var ring = typeof SharedArrayBuffer !== 'undefined' && Buffer.from
+    ? Buffer.from(new SharedArrayBuffer(length))
+    : new Buffer(length);
+  SDL.initEventRing(ring, capacity);
+  return ring;
+};
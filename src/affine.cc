@@ -0,0 +1,305 @@
+#include <v8.h>
+#include <node.h>
+#include <SDL.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "helpers.h"
+#include "pixels.h"
+#include "affine.h"
+
+namespace sdl {
+
+bool OpenSampleSource(SDL_Surface* surface, const SDL_Rect* rect, SampleSource* source, Uint8** copy) {
+  SDL_PixelFormat* fmt = surface->format;
+  *copy = NULL;
+  source->w = rect->w;
+  source->h = rect->h;
+
+  if (ByteChannels(fmt, source->idx)) {
+    source->pixels = (const Uint8*)surface->pixels + rect->y * surface->pitch + rect->x * 4;
+    source->pitch = surface->pitch;
+  } else {
+    *copy = (Uint8*)malloc((size_t)rect->w * rect->h * 4 + 1);
+    if (!*copy) return false;
+    int bpp = fmt->BytesPerPixel;
+    for (int y = 0; y < rect->h; y++) {
+      DecodeRow(fmt, (const Uint8*)surface->pixels + (rect->y + y) * surface->pitch + rect->x * bpp,
+        rect->w, *copy + (size_t)y * rect->w * 4);
+    }
+    source->pixels = *copy;
+    source->pitch = rect->w * 4;
+    for (int c = 0; c < 4; c++) source->idx[c] = c;
+  }
+
+  source->keyed = (surface->flags & SDL_SRCCOLORKEY) != 0;
+  if (source->keyed) SDL_GetRGB(fmt->colorkey, fmt, &source->key[0], &source->key[1], &source->key[2]);
+  source->blend = (surface->flags & SDL_SRCALPHA) != 0;
+  source->alpha = source->blend && !fmt->Amask ? fmt->alpha : 255;
+  return true;
+}
+
+void CompositeSpan(SDL_Surface* dst, int x, int y, int count, const Uint8* rgba, bool blend, Uint8* scratch) {
+  int bpp = dst->format->BytesPerPixel;
+  Uint8* row = (Uint8*)dst->pixels + y * dst->pitch + x * bpp;
+  if (!blend) {
+    EncodeRow(dst->format, rgba, count, row);
+    return;
+  }
+
+  DecodeRow(dst->format, row, count, scratch);
+  for (int i = 0; i < count; i++) {
+    const Uint8* s = rgba + i * 4;
+    Uint8* d = scratch + i * 4;
+    int a = s[3];
+    if (a == 0) continue;
+    if (a == 255) {
+      d[0] = s[0];
+      d[1] = s[1];
+      d[2] = s[2];
+      continue;
+    }
+    for (int c = 0; c < 3; c++) d[c] = Div255(s[c] * a + d[c] * (255 - a));
+  }
+  EncodeRow(dst->format, scratch, count, row);
+}
+
+// Columns [*x0, *x1) of a row where lo <= f0 + k * (x + 0.5) < hi.
+static void SolveSpan(double f0, double k, double lo, double hi, int* x0, int* x1) {
+  if (fabs(k) < 1e-12) {
+    if (f0 + 0.5 * k < lo || f0 + 0.5 * k >= hi) *x1 = *x0;
+    return;
+  }
+  double a = (lo - f0) / k - 0.5, b = (hi - f0) / k - 0.5;
+  if (a > b) {
+    double t = a;
+    a = b;
+    b = t;
+  }
+  int s = (int)ceil(a), e = (int)ceil(b);
+  if (s > *x0) *x0 = s;
+  if (e < *x1) *x1 = e;
+}
+
+// Draws the source through the 2x3 matrix m = [a, b, c, d, e, f] mapping
+// source (u, v) to destination (a*u + c*v + e, b*u + d*v + f).  Both surfaces
+// must be locked.  `span` holds dst->w * 8 bytes.
+static void DrawAffine(const SampleSource* src, SDL_Surface* dst, const double* m, int filter, Uint8* span) {
+  double det = m[0] * m[3] - m[1] * m[2];
+  if (fabs(det) < 1e-12 || src->w <= 0 || src->h <= 0) return;
+  double ia = m[3] / det, ib = -m[1] / det, ic = -m[2] / det, id = m[0] / det;
+  double ie = (m[2] * m[5] - m[3] * m[4]) / det, iff = (m[1] * m[4] - m[0] * m[5]) / det;
+
+  // Destination bounds of the transformed source, clipped.
+  double cx[4] = { 0, (double)src->w, 0, (double)src->w };
+  double cy[4] = { 0, 0, (double)src->h, (double)src->h };
+  double minx = 1e30, miny = 1e30, maxx = -1e30, maxy = -1e30;
+  for (int i = 0; i < 4; i++) {
+    double x = m[0] * cx[i] + m[2] * cy[i] + m[4];
+    double y = m[1] * cx[i] + m[3] * cy[i] + m[5];
+    if (x < minx) minx = x;
+    if (x > maxx) maxx = x;
+    if (y < miny) miny = y;
+    if (y > maxy) maxy = y;
+  }
+  const SDL_Rect& clip = dst->clip_rect;
+  int bx0 = (int)floor(minx), bx1 = (int)ceil(maxx);
+  int by0 = (int)floor(miny), by1 = (int)ceil(maxy);
+  if (bx0 < clip.x) bx0 = clip.x;
+  if (by0 < clip.y) by0 = clip.y;
+  if (bx1 > clip.x + clip.w) bx1 = clip.x + clip.w;
+  if (by1 > clip.y + clip.h) by1 = clip.y + clip.h;
+  if (bx0 >= bx1 || by0 >= by1) return;
+
+  bool blend = src->blend || src->keyed;
+  Uint8* out = span;
+  Uint8* scratch = span + dst->w * 4;
+  const int wmax = src->w - 1, hmax = src->h - 1;
+  // 16.16 steps along a destination row.
+  const Sint32 du = (Sint32)(ia * 65536.0), dv = (Sint32)(ib * 65536.0);
+
+  for (int y = by0; y < by1; y++) {
+    double py = y + 0.5;
+    double u0 = ic * py + ie, v0 = id * py + iff;
+    int x0 = bx0, x1 = bx1;
+    SolveSpan(u0, ia, 0, src->w, &x0, &x1);
+    SolveSpan(v0, ib, 0, src->h, &x0, &x1);
+    if (x0 >= x1) continue;
+
+    Sint32 u = (Sint32)((ia * (x0 + 0.5) + u0) * 65536.0);
+    Sint32 v = (Sint32)((ib * (x0 + 0.5) + v0) * 65536.0);
+    int n = x1 - x0;
+
+    if (filter == FILTER_BILINEAR) {
+      for (int i = 0; i < n; i++, u += du, v += dv) {
+        Sint32 su = u - 0x8000, sv = v - 0x8000;
+        int xa = su >> 16, ya = sv >> 16;
+        int fx = (su >> 8) & 0xff, fy = (sv >> 8) & 0xff;
+        int xb = xa + 1, yb = ya + 1;
+        if (xa < 0) xa = 0;
+        if (ya < 0) ya = 0;
+        if (xb > wmax) xb = wmax;
+        if (yb > hmax) yb = hmax;
+        if (xa > wmax) xa = wmax;
+        if (ya > hmax) ya = hmax;
+        Uint8 p[4][4];
+        FetchSample(src, xa, ya, p[0]);
+        FetchSample(src, xb, ya, p[1]);
+        FetchSample(src, xa, yb, p[2]);
+        FetchSample(src, xb, yb, p[3]);
+        Uint8* o = out + i * 4;
+        BlendBilinear(p, fx, fy, o);
+        if (src->alpha != 255) o[3] = Div255(o[3] * src->alpha);
+      }
+    } else {
+      for (int i = 0; i < n; i++, u += du, v += dv) {
+        int su = u >> 16, sv = v >> 16;
+        if (su < 0) su = 0;
+        if (sv < 0) sv = 0;
+        if (su > wmax) su = wmax;
+        if (sv > hmax) sv = hmax;
+        Uint8* o = out + i * 4;
+        FetchSample(src, su, sv, o);
+        if (src->alpha != 255) o[3] = Div255(o[3] * src->alpha);
+      }
+    }
+
+    CompositeSpan(dst, x0, y, n, out, blend, scratch);
+  }
+}
+
+// Reads a 2x3 matrix from an array or typed array of six numbers.
+static bool ValueToMatrix(Handle<Value> value, double* m) {
+  if (!value->IsObject()) return false;
+  Handle<Object> obj = value->ToObject();
+  for (int i = 0; i < 6; i++) {
+    Local<Value> v = obj->Get(i);
+    if (!v->IsNumber()) return false;
+    m[i] = v->NumberValue();
+  }
+  return true;
+}
+
+static bool LockPair(SDL_Surface* src, SDL_Surface* dst) {
+  if (SDL_MUSTLOCK(src) && SDL_LockSurface(src) < 0) return false;
+  if (SDL_MUSTLOCK(dst) && SDL_LockSurface(dst) < 0) {
+    if (SDL_MUSTLOCK(src)) SDL_UnlockSurface(src);
+    return false;
+  }
+  return true;
+}
+
+static void UnlockPair(SDL_Surface* src, SDL_Surface* dst) {
+  if (SDL_MUSTLOCK(dst)) SDL_UnlockSurface(dst);
+  if (SDL_MUSTLOCK(src)) SDL_UnlockSurface(src);
+}
+
+// Blits srcRect of src into dst through an affine matrix [a, b, c, d, e, f],
+// clipped to the destination's clip rect.
+Handle<Value> BlitAffine(const Arguments& args) {
+  HandleScope scope;
+
+  double m[6];
+  if (!(args.Length() == 5
+      && args[0]->IsObject()
+      && (args[1]->IsObject() || args[1]->IsNull())
+      && args[2]->IsObject()
+      && ValueToMatrix(args[3], m)
+      && args[4]->IsNumber()
+  )) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected BlitAffine(Surface, Rect, Surface, Array, Number)")));
+  }
+
+  SDL_Surface* src = UnwrapSurface(args[0]->ToObject());
+  SDL_Surface* dst = UnwrapSurface(args[2]->ToObject());
+  int filter = args[4]->Int32Value();
+  SDL_Rect r, rect;
+  if (!ResolveSurfaceRect(src, ValueToRect(args[1], &r), &rect)) {
+    return ThrowException(Exception::RangeError(String::New("Rect is outside of the surface")));
+  }
+
+  Uint8* span = (Uint8*)malloc((size_t)dst->w * 8 + 1);
+  if (!span) return ThrowException(Exception::Error(String::New("BlitAffine: Out of memory")));
+  if (!LockPair(src, dst)) {
+    free(span);
+    return ThrowSDLException(__func__);
+  }
+
+  SampleSource source;
+  Uint8* copy;
+  bool ok = OpenSampleSource(src, &rect, &source, &copy);
+  if (ok) DrawAffine(&source, dst, m, filter, span);
+
+  UnlockPair(src, dst);
+  free(copy);
+  free(span);
+  if (!ok) return ThrowException(Exception::Error(String::New("BlitAffine: Out of memory")));
+
+  return Undefined();
+}
+
+// Batch form: params is a Float32Array of records
+// [sx, sy, sw, sh, a, b, c, d, e, f], all drawn from src into dst with a
+// single lock.  Returns the number of records drawn.
+Handle<Value> BlitAffineBatch(const Arguments& args) {
+  HandleScope scope;
+
+  int length = 0;
+  float* params = args.Length() == 4 ? (float*)TypedArrayData(args[2], kExternalFloatArray, &length) : NULL;
+  if (!(args.Length() == 4 && args[0]->IsObject() && args[1]->IsObject() && params && args[3]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected BlitAffineBatch(Surface, Surface, Float32Array, Number)")));
+  }
+
+  SDL_Surface* src = UnwrapSurface(args[0]->ToObject());
+  SDL_Surface* dst = UnwrapSurface(args[1]->ToObject());
+  int filter = args[3]->Int32Value();
+  int records = length / 10;
+
+  Uint8* span = (Uint8*)malloc((size_t)dst->w * 8 + 1);
+  if (!span) return ThrowException(Exception::Error(String::New("BlitAffineBatch: Out of memory")));
+  if (!LockPair(src, dst)) {
+    free(span);
+    return ThrowSDLException(__func__);
+  }
+
+  // Sample straight from the whole source; records index into it.
+  SDL_Rect all = { 0, 0, (Uint16)src->w, (Uint16)src->h };
+  SampleSource whole;
+  Uint8* copy;
+  bool ok = OpenSampleSource(src, &all, &whole, &copy);
+  int drawn = 0;
+  for (int i = 0; ok && i < records; i++) {
+    const float* p = params + i * 10;
+    int sx = (int)p[0], sy = (int)p[1], sw = (int)p[2], sh = (int)p[3];
+    if (sx < 0 || sy < 0 || sw <= 0 || sh <= 0 || sx + sw > src->w || sy + sh > src->h) continue;
+    SampleSource source = whole;
+    source.pixels = whole.pixels + sy * whole.pitch + sx * 4;
+    source.w = sw;
+    source.h = sh;
+    double m[6] = { p[4], p[5], p[6], p[7], p[8], p[9] };
+    DrawAffine(&source, dst, m, filter, span);
+    drawn++;
+  }
+
+  UnlockPair(src, dst);
+  free(copy);
+  free(span);
+  if (!ok) return ThrowException(Exception::Error(String::New("BlitAffineBatch: Out of memory")));
+
+  return Number::New(drawn);
+}
+
+void ExportAffine(Handle<Object> target) {
+  HandleScope scope;
+
+  NODE_SET_METHOD(target, "blitAffine", BlitAffine);
+  NODE_SET_METHOD(target, "blitAffineBatch", BlitAffineBatch);
+
+  Local<Object> FILTER = Object::New();
+  target->Set(String::New("FILTER"), FILTER);
+  FILTER->Set(String::New("NEAREST"), Number::New(FILTER_NEAREST));
+  FILTER->Set(String::New("BILINEAR"), Number::New(FILTER_BILINEAR));
+}
+
+} // sdl
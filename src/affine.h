@@ -0,0 +1,87 @@
+#ifndef NODE_SDL_AFFINE_H_
+#define NODE_SDL_AFFINE_H_
+
+#include <v8.h>
+#include <node.h>
+#include <SDL.h>
+
+using namespace v8;
+
+namespace sdl {
+
+  enum Filter {
+    FILTER_NEAREST = 0,
+    FILTER_BILINEAR = 1
+  };
+
+  // Pixel source for the software samplers: a locked surface (or a packed
+  // RGBA copy of one) read through the byte offsets of its channels.
+  struct SampleSource {
+    const Uint8* pixels;  // top left of the source rect
+    int pitch;
+    int w;
+    int h;
+    int idx[4];           // byte offsets of R, G, B, A; idx[3] < 0 means opaque
+    bool keyed;           // pixels matching key[] read as transparent
+    Uint8 key[3];
+    bool blend;           // SDL_SRCALPHA set: blend onto the destination
+    int alpha;            // per surface alpha, 255 when unused
+  };
+
+  // Points source at rect of a surface the caller has locked.  Formats that
+  // aren't 32 bit with byte sized channels are copied into *copy (malloc'd,
+  // caller frees).  Returns false on allocation failure.
+  bool OpenSampleSource(SDL_Surface* surface, const SDL_Rect* rect, SampleSource* source, Uint8** copy);
+
+  // Reads texel (x, y) of the source as RGBA.  Color keyed texels come back
+  // with alpha 0; when the source doesn't blend every other texel is opaque.
+  inline void FetchSample(const SampleSource* s, int x, int y, Uint8* out) {
+    const Uint8* p = s->pixels + y * s->pitch + x * 4;
+    out[0] = p[s->idx[0]];
+    out[1] = p[s->idx[1]];
+    out[2] = p[s->idx[2]];
+    out[3] = s->idx[3] < 0 ? 0xff : p[s->idx[3]];
+    if (s->keyed) {
+      if (out[0] == s->key[0] && out[1] == s->key[1] && out[2] == s->key[2]) out[3] = 0;
+      else if (!s->blend) out[3] = 0xff;
+    }
+  }
+
+  // x / 255 rounded, exact for 0 <= x <= 255 * 255.
+  inline int Div255(int x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+  }
+
+  // Filters texels (xa, ya), (xb, ya), (xa, yb) and (xb, yb) at fractions fx
+  // and fy (of 256) into out.  Colour is weighted by alpha, so transparent
+  // texels, colour keyed ones included, don't tint their neighbours.
+  inline void BlendBilinear(const Uint8 p[4][4], int fx, int fy, Uint8* out) {
+    Uint32 weight[4] = {
+      (Uint32)((256 - fx) * (256 - fy)), (Uint32)(fx * (256 - fy)),
+      (Uint32)((256 - fx) * fy), (Uint32)(fx * fy)
+    };
+    // The weights sum to 65536, so every sum below fits in 32 bits.
+    Uint32 alpha = 0, sum[3] = { 0, 0, 0 };
+    for (int k = 0; k < 4; k++) {
+      Uint32 wa = weight[k] * p[k][3];
+      alpha += wa;
+      for (int c = 0; c < 3; c++) sum[c] += wa * p[k][c];
+    }
+    for (int c = 0; c < 3; c++) out[c] = alpha ? (Uint8)((sum[c] + alpha / 2) / alpha) : 0;
+    out[3] = (Uint8)((alpha + 0x8000) >> 16);
+  }
+
+  // Blends (or copies) a span of RGBA8888 pixels into row y of a locked
+  // destination surface, starting at column x.  `scratch` holds count * 4
+  // bytes.
+  void CompositeSpan(SDL_Surface* dst, int x, int y, int count, const Uint8* rgba, bool blend, Uint8* scratch);
+
+  Handle<Value> BlitAffine(const Arguments& args);
+  Handle<Value> BlitAffineBatch(const Arguments& args);
+
+  void ExportAffine(Handle<Object> target);
+
+} // sdl
+
+#endif  // NODE_SDL_AFFINE_H_
@@ -0,0 +1,95 @@
+#include <v8.h>
+#include <node.h>
+#include <SDL.h>
+#include <string.h>
+
+#include "helpers.h"
+#include "alloctrack.h"
+
+namespace sdl {
+
+bool alloc_tracking = false;
+AllocCounter alloc_counters[ALLOC_SITES];
+
+// Names read() reports the sites under, in AllocSite order.
+static const char* site_names_[ALLOC_SITES] = {
+  "pollEvent",
+  "getRGB",
+  "getRGBA",
+  "wrapSurface",
+  "wrapRect",
+  "wrapPixelFormat",
+  "wrapJoystick",
+  "wrapFont",
+  "rectArray",
+  "getError",
+  "joystickName",
+  "sizeText"
+};
+
+Handle<Value> ALLOC::Enable(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 1 && args[0]->IsBoolean())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected ALLOC::Enable(Boolean)")));
+  }
+  alloc_tracking = args[0]->BooleanValue();
+  return Undefined();
+}
+
+Handle<Value> ALLOC::Reset(const Arguments& args) {
+  HandleScope scope;
+
+  memset(alloc_counters, 0, sizeof(alloc_counters));
+  return Undefined();
+}
+
+// Returns { site: { calls, objects, strings } } for every site that was
+// called since the last reset, plus a `total` entry.
+Handle<Value> ALLOC::Read(const Arguments& args) {
+  HandleScope scope;
+
+  Local<Object> result = Object::New();
+  AllocCounter total = { 0, 0, 0 };
+  for (int i = 0; i <= ALLOC_SITES; i++) {
+    const AllocCounter& counter = i < ALLOC_SITES ? alloc_counters[i] : total;
+    if (i < ALLOC_SITES) {
+      if (!counter.calls) continue;
+      total.calls += counter.calls;
+      total.objects += counter.objects;
+      total.strings += counter.strings;
+    }
+    Local<Object> entry = Object::New();
+    entry->Set(String::NewSymbol("calls"), Number::New(counter.calls));
+    entry->Set(String::NewSymbol("objects"), Number::New(counter.objects));
+    entry->Set(String::NewSymbol("strings"), Number::New(counter.strings));
+    result->Set(String::NewSymbol(i < ALLOC_SITES ? site_names_[i] : "total"), entry);
+  }
+  return scope.Close(result);
+}
+
+// Returns { count, bytes } for the surfaces JS holds; always counted.
+Handle<Value> ALLOC::Surfaces(const Arguments& args) {
+  HandleScope scope;
+
+  Uint32 count;
+  double bytes;
+  CountLiveSurfaces(&count, &bytes);
+  Local<Object> result = Object::New();
+  result->Set(String::NewSymbol("count"), Number::New(count));
+  result->Set(String::NewSymbol("bytes"), Number::New(bytes));
+  return scope.Close(result);
+}
+
+void ExportAllocTracking(Handle<Object> target) {
+  HandleScope scope;
+
+  Local<Object> ALLOC = Object::New();
+  target->Set(String::New("ALLOC"), ALLOC);
+  NODE_SET_METHOD(ALLOC, "enable", sdl::ALLOC::Enable);
+  NODE_SET_METHOD(ALLOC, "reset", sdl::ALLOC::Reset);
+  NODE_SET_METHOD(ALLOC, "read", sdl::ALLOC::Read);
+  NODE_SET_METHOD(ALLOC, "surfaces", sdl::ALLOC::Surfaces);
+}
+
+} // sdl
@@ -0,0 +1,58 @@
+#ifndef NODE_SDL_ALLOCTRACK_H_
+#define NODE_SDL_ALLOCTRACK_H_
+
+#include <v8.h>
+#include <node.h>
+#include <SDL.h>
+
+using namespace v8;
+
+namespace sdl {
+
+  // Binding call sites that create JS objects or strings on every call.
+  enum AllocSite {
+    ALLOC_POLL_EVENT = 0,
+    ALLOC_GET_RGB,
+    ALLOC_GET_RGBA,
+    ALLOC_WRAP_SURFACE,
+    ALLOC_WRAP_RECT,
+    ALLOC_WRAP_PIXEL_FORMAT,
+    ALLOC_WRAP_JOYSTICK,
+    ALLOC_WRAP_FONT,
+    ALLOC_RECT_ARRAY,       // index keys looked up to read [x, y, w, h]
+    ALLOC_GET_ERROR,
+    ALLOC_JOYSTICK_NAME,
+    ALLOC_SIZE_TEXT,
+    ALLOC_SITES
+  };
+
+  struct AllocCounter {
+    Uint32 calls;
+    Uint32 objects;
+    Uint32 strings;
+  };
+
+  // Off unless turned on from JS with ALLOC.enable(true).
+  extern bool alloc_tracking;
+  extern AllocCounter alloc_counters[ALLOC_SITES];
+
+  // Counts one call at a site and the JS values it created.
+  inline void TrackAlloc(AllocSite site, int objects, int strings) {
+    if (!alloc_tracking) return;
+    alloc_counters[site].calls++;
+    alloc_counters[site].objects += objects;
+    alloc_counters[site].strings += strings;
+  }
+
+  namespace ALLOC {
+    Handle<Value> Enable(const Arguments& args);
+    Handle<Value> Reset(const Arguments& args);
+    Handle<Value> Read(const Arguments& args);
+    Handle<Value> Surfaces(const Arguments& args);
+  }
+
+  void ExportAllocTracking(Handle<Object> target);
+
+} // sdl
+
+#endif  // NODE_SDL_ALLOCTRACK_H_
@@ -0,0 +1,360 @@
+#include <v8.h>
+#include <node.h>
+#include <SDL.h>
+#include <SDL_thread.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "helpers.h"
+#include "assets.h"
+
+namespace sdl {
+
+struct AssetJob;
+
+struct AssetRequest {
+  int id;
+  double priority;
+  std::string group;
+  Persistent<Function> fn;
+  AssetJob* job;
+};
+
+// One decode, shared by every request for the same file and conversion.
+struct AssetJob {
+  std::string path;
+  std::string key;
+  bool convert;
+  SDL_PixelFormat format;       // the screen's, when converting
+  double priority;              // highest of its requests'
+  Uint32 seq;                   // breaks ties first come, first served
+  bool running;
+  SDL_Surface* surface;
+  std::string error;
+  std::vector<AssetRequest*> requests;
+};
+
+// Decodes running at once; each takes one thread pool thread.
+static int concurrency_ = 2;
+static int slots_ = 0;
+static int next_id_ = 1;
+static Uint32 next_seq_ = 0;
+
+static std::map<int, AssetRequest*> requests_;
+static std::map<std::string, AssetJob*> jobs_;    // queued or running, by key
+
+// Jobs nobody has started.  Pool threads take from here, so the list and the
+// jobs' priorities are only touched under the lock.
+static std::vector<AssetJob*> queue_;
+static SDL_mutex* lock_ = NULL;
+
+// Removes and returns the job to run next, or NULL.
+static AssetJob* TakeNext() {
+  SDL_LockMutex(lock_);
+  int best = -1;
+  for (int i = 0; i < (int)queue_.size(); i++) {
+    AssetJob* job = queue_[i];
+    if (best < 0 || job->priority > queue_[best]->priority
+        || (job->priority == queue_[best]->priority && job->seq < queue_[best]->seq)) {
+      best = i;
+    }
+  }
+  AssetJob* job = NULL;
+  if (best >= 0) {
+    job = queue_[best];
+    queue_.erase(queue_.begin() + best);
+    job->running = true;
+  }
+  SDL_UnlockMutex(lock_);
+  return job;
+}
+
+static void EIO_DecodeAsset(eio_req *req) {
+  AssetJob* job = TakeNext();
+  req->data = job;
+  if (!job) return;
+
+  job->surface = LoadImage(job->path.c_str(), job->convert ? &job->format : NULL);
+  if (!job->surface) job->error = SDL_GetError();
+}
+
+static int EIO_OnAssetDecoded(eio_req *req);
+
+// Starts pool slots while there is queued work and room for them.
+static void FillSlots() {
+  SDL_LockMutex(lock_);
+  int queued = (int)queue_.size();
+  SDL_UnlockMutex(lock_);
+  while (slots_ < concurrency_ && slots_ < queued) {
+    slots_++;
+    eio_custom(EIO_DecodeAsset, EIO_PRI_DEFAULT, EIO_OnAssetDecoded, NULL);
+    ev_ref(EV_DEFAULT_UC);
+  }
+}
+
+static void UpdatePriority(AssetJob* job) {
+  double priority = job->requests.empty() ? 0 : job->requests[0]->priority;
+  for (size_t i = 1; i < job->requests.size(); i++) {
+    if (job->requests[i]->priority > priority) priority = job->requests[i]->priority;
+  }
+  SDL_LockMutex(lock_);
+  job->priority = priority;
+  SDL_UnlockMutex(lock_);
+}
+
+static void FreeRequest(AssetRequest* request) {
+  requests_.erase(request->id);
+  request->fn.Dispose();
+  delete request;
+}
+
+// Drops a request without calling it back.  A queued job left without
+// requests is dropped too; a running one is freed when it finishes.
+static void CancelRequest(AssetRequest* request) {
+  AssetJob* job = request->job;
+  for (size_t i = 0; i < job->requests.size(); i++) {
+    if (job->requests[i] == request) {
+      job->requests.erase(job->requests.begin() + i);
+      break;
+    }
+  }
+  FreeRequest(request);
+
+  if (!job->requests.empty()) {
+    UpdatePriority(job);
+    return;
+  }
+  SDL_LockMutex(lock_);
+  bool queued = !job->running;
+  if (queued) {
+    for (size_t i = 0; i < queue_.size(); i++) {
+      if (queue_[i] == job) {
+        queue_.erase(queue_.begin() + i);
+        break;
+      }
+    }
+  }
+  SDL_UnlockMutex(lock_);
+  if (queued) {
+    jobs_.erase(job->key);
+    delete job;
+  }
+}
+
+static bool HigherPriority(const AssetRequest* a, const AssetRequest* b) {
+  return a->priority > b->priority;
+}
+
+static int EIO_OnAssetDecoded(eio_req *req) {
+  HandleScope scope;
+
+  AssetJob* job = (AssetJob*)req->data;
+  ev_unref(EV_DEFAULT_UC);
+  slots_--;
+
+  if (job) {
+    jobs_.erase(job->key);
+
+    // The requests are settled before any callback runs, so callbacks may
+    // cancel or load freely.  Every request owns a reference to the surface.
+    std::vector<AssetRequest*> requests = job->requests;
+    job->requests.clear();
+    for (size_t i = 0; i < requests.size(); i++) requests_.erase(requests[i]->id);
+    std::stable_sort(requests.begin(), requests.end(), HigherPriority);
+    if (job->surface && requests.empty()) ReleaseSurface(job->surface);
+    else if (job->surface) job->surface->refcount += (int)requests.size() - 1;
+
+    for (size_t i = 0; i < requests.size(); i++) {
+      AssetRequest* request = requests[i];
+      Handle<Value> argv[2];
+      if (job->surface) {
+        argv[0] = Undefined();
+        argv[1] = WrapSurface(job->surface);
+      } else {
+        argv[0] = Exception::Error(String::New(("ASSETS::Load: " + job->path + ": " + job->error).c_str()));
+        argv[1] = Undefined();
+      }
+      request->fn->Call(Context::GetCurrent()->Global(), 2, argv);
+      request->fn.Dispose();
+      delete request;
+    }
+    delete job;
+  }
+
+  FillSlots();
+  return 0;
+}
+
+// Queues a decode: (path, { priority, group, displayFormat }, callback).
+// Calls back with (err, Surface); returns the request's id.
+Handle<Value> ASSETS::Load(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 3 && args[0]->IsString() && args[1]->IsObject() && args[2]->IsFunction())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected ASSETS::Load(String, Object, Function)")));
+  }
+
+  String::Utf8Value path(args[0]);
+  Local<Object> options = args[1]->ToObject();
+  Local<Value> priority = options->Get(String::New("priority"));
+  Local<Value> group = options->Get(String::New("group"));
+  bool convert = options->Get(String::New("displayFormat"))->BooleanValue();
+
+  SDL_Surface* screen = SDL_GetVideoSurface();
+  if (convert && !screen) {
+    return ThrowException(Exception::Error(String::New("ASSETS::Load: No video mode set for displayFormat")));
+  }
+  if (!lock_) lock_ = SDL_CreateMutex();
+
+  AssetRequest* request = new AssetRequest();
+  request->id = next_id_++;
+  request->priority = priority->IsNumber() ? priority->NumberValue() : 0;
+  if (group->IsString()) request->group = *String::Utf8Value(group);
+  request->fn = Persistent<Function>::New(Handle<Function>::Cast(args[2]));
+  requests_[request->id] = request;
+
+  std::string key = std::string(convert ? "display:" : "file:") + *path;
+  std::map<std::string, AssetJob*>::iterator it = jobs_.find(key);
+  AssetJob* job;
+  if (it != jobs_.end()) {
+    job = it->second;
+  } else {
+    job = new AssetJob();
+    job->path = *path;
+    job->key = key;
+    job->convert = convert;
+    if (convert) job->format = *screen->format;
+    job->priority = request->priority;
+    job->seq = next_seq_++;
+    job->running = false;
+    job->surface = NULL;
+    jobs_[key] = job;
+    SDL_LockMutex(lock_);
+    queue_.push_back(job);
+    SDL_UnlockMutex(lock_);
+  }
+  request->job = job;
+  job->requests.push_back(request);
+  UpdatePriority(job);
+
+  FillSlots();
+  return scope.Close(Number::New(request->id));
+}
+
+// Cancels a request; returns false if it was already delivered.
+Handle<Value> ASSETS::Cancel(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 1 && args[0]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected ASSETS::Cancel(Number)")));
+  }
+
+  std::map<int, AssetRequest*>::iterator it = requests_.find(args[0]->Int32Value());
+  if (it == requests_.end()) return scope.Close(Boolean::New(false));
+  CancelRequest(it->second);
+  return scope.Close(Boolean::New(true));
+}
+
+// Cancels every pending request in a group; returns how many there were.
+Handle<Value> ASSETS::CancelGroup(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 1 && args[0]->IsString())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected ASSETS::CancelGroup(String)")));
+  }
+
+  std::string group = *String::Utf8Value(args[0]);
+  std::vector<AssetRequest*> matched;
+  for (std::map<int, AssetRequest*>::iterator it = requests_.begin(); it != requests_.end(); ++it) {
+    if (it->second->group == group) matched.push_back(it->second);
+  }
+  for (size_t i = 0; i < matched.size(); i++) CancelRequest(matched[i]);
+  return scope.Close(Number::New(matched.size()));
+}
+
+Handle<Value> ASSETS::SetPriority(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 2 && args[0]->IsNumber() && args[1]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected ASSETS::SetPriority(Number, Number)")));
+  }
+
+  std::map<int, AssetRequest*>::iterator it = requests_.find(args[0]->Int32Value());
+  if (it == requests_.end()) return scope.Close(Boolean::New(false));
+  it->second->priority = args[1]->NumberValue();
+  UpdatePriority(it->second->job);
+  return scope.Close(Boolean::New(true));
+}
+
+// Gives every pending request in a group the same priority; returns how many
+// there were.
+Handle<Value> ASSETS::SetGroupPriority(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 2 && args[0]->IsString() && args[1]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected ASSETS::SetGroupPriority(String, Number)")));
+  }
+
+  std::string group = *String::Utf8Value(args[0]);
+  double priority = args[1]->NumberValue();
+  int count = 0;
+  for (std::map<int, AssetRequest*>::iterator it = requests_.begin(); it != requests_.end(); ++it) {
+    if (it->second->group != group) continue;
+    it->second->priority = priority;
+    UpdatePriority(it->second->job);
+    count++;
+  }
+  return scope.Close(Number::New(count));
+}
+
+Handle<Value> ASSETS::SetConcurrency(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 1 && args[0]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected ASSETS::SetConcurrency(Number)")));
+  }
+
+  int concurrency = args[0]->Int32Value();
+  if (concurrency < 1) {
+    return ThrowException(Exception::RangeError(String::New("ASSETS::SetConcurrency: Must be at least 1")));
+  }
+  concurrency_ = concurrency;
+  if (lock_) FillSlots();
+  return Undefined();
+}
+
+// Returns { requests, queued, running }: requests not yet called back,
+// decodes waiting for a slot and decodes under way.
+Handle<Value> ASSETS::Stats(const Arguments& args) {
+  HandleScope scope;
+
+  int queued = 0;
+  if (lock_) {
+    SDL_LockMutex(lock_);
+    queued = (int)queue_.size();
+    SDL_UnlockMutex(lock_);
+  }
+  Local<Object> result = Object::New();
+  result->Set(String::NewSymbol("requests"), Number::New(requests_.size()));
+  result->Set(String::NewSymbol("queued"), Number::New(queued));
+  result->Set(String::NewSymbol("running"), Number::New(jobs_.size() - queued));
+  return scope.Close(result);
+}
+
+void ExportAssets(Handle<Object> target) {
+  HandleScope scope;
+
+  Local<Object> ASSETS = Object::New();
+  target->Set(String::New("ASSETS"), ASSETS);
+  NODE_SET_METHOD(ASSETS, "load", sdl::ASSETS::Load);
+  NODE_SET_METHOD(ASSETS, "cancel", sdl::ASSETS::Cancel);
+  NODE_SET_METHOD(ASSETS, "cancelGroup", sdl::ASSETS::CancelGroup);
+  NODE_SET_METHOD(ASSETS, "setPriority", sdl::ASSETS::SetPriority);
+  NODE_SET_METHOD(ASSETS, "setGroupPriority", sdl::ASSETS::SetGroupPriority);
+  NODE_SET_METHOD(ASSETS, "setConcurrency", sdl::ASSETS::SetConcurrency);
+  NODE_SET_METHOD(ASSETS, "stats", sdl::ASSETS::Stats);
+}
+
+} // sdl
@@ -0,0 +1,29 @@
+#ifndef NODE_SDL_ASSETS_H_
+#define NODE_SDL_ASSETS_H_
+
+#include <v8.h>
+#include <node.h>
+
+using namespace v8;
+
+namespace sdl {
+
+  // Prioritized image loading for prefetching.  Requests wait in a queue
+  // until a thread pool slot takes the highest priority one, so requests for
+  // a screen the user already left can be cancelled or pushed back before
+  // they are decoded.  Requests for the same file share one decode.
+  namespace ASSETS {
+    Handle<Value> Load(const Arguments& args);
+    Handle<Value> Cancel(const Arguments& args);
+    Handle<Value> CancelGroup(const Arguments& args);
+    Handle<Value> SetPriority(const Arguments& args);
+    Handle<Value> SetGroupPriority(const Arguments& args);
+    Handle<Value> SetConcurrency(const Arguments& args);
+    Handle<Value> Stats(const Arguments& args);
+  }
+
+  void ExportAssets(Handle<Object> target);
+
+} // sdl
+
+#endif  // NODE_SDL_ASSETS_H_
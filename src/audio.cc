@@ -0,0 +1,1052 @@
+#include <v8.h>
+#include <node.h>
+#include <SDL.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <map>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "helpers.h"
+#include "dsp.h"
+#include "audio.h"
+#include "vorbis.h"
+
+namespace sdl {
+
+// Everything the audio thread touches is changed only through commands, which
+// the JS thread pushes onto a single producer, single consumer ring and the
+// callback drains before mixing.  Memory is never freed on the audio thread:
+// retired sounds and effects come back on a second ring and are freed by the
+// JS thread on its next call.
+enum AudioCommandType {
+  CMD_PLAY,
+  CMD_PLAY_STREAM,
+  CMD_STOP,
+  CMD_VOICE_GAIN,
+  CMD_BUS_GAIN,
+  CMD_SET_EFFECT,
+  CMD_EFFECT_PARAM,
+  CMD_RELEASE_SOUND,
+  CMD_AUTOTUNE      // param: enabled, value: min ms, when: max ms
+};
+
+struct AudioCommand {
+  int type;
+  int id;       // voice
+  int bus;
+  int slot;     // effect slot; loop flag for CMD_PLAY
+  int param;
+  float value;
+  void* ptr;    // Sound, Stream or Effect
+  double when;  // ClockMillis() a played voice should be heard at; 0 for now
+};
+
+enum GarbageType {
+  GARBAGE_SOUND,
+  GARBAGE_EFFECT
+};
+
+struct Garbage {
+  int type;
+  void* ptr;
+};
+
+// Indices only grow; slots are index & (size - 1).
+template <class T, Uint32 SIZE>
+struct SpscRing {
+  T items[SIZE];
+  volatile Uint32 head;   // written by the producer
+  volatile Uint32 tail;   // written by the consumer
+
+  bool Push(const T& item) {
+    Uint32 h = head;
+    if (h - tail >= SIZE) return false;
+    __sync_synchronize();
+    items[h & (SIZE - 1)] = item;
+    __sync_synchronize();
+    head = h + 1;
+    return true;
+  }
+
+  bool Pop(T* item) {
+    Uint32 t = tail;
+    if (t == head) return false;
+    __sync_synchronize();
+    *item = items[t & (SIZE - 1)];
+    __sync_synchronize();
+    tail = t + 1;
+    return true;
+  }
+};
+
+static SpscRing<AudioCommand, 1024> commands_;
+static SpscRing<Garbage, 1024> garbage_;
+
+struct Voice {
+  int id;       // 0 when the slot is free
+  Sound* sound;
+  Stream* stream;   // instead of sound
+  int position; // next frame to play
+  int bus;
+  float gain;
+  bool loop;
+  Uint64 start; // device frame to start at; silent until then
+};
+
+struct Bus {
+  float gain;
+  Effect* effects[MAX_BUS_EFFECTS];
+};
+
+// Audio thread state.
+static Voice voices_[MAX_VOICES];
+static Bus buses_[AUDIO_BUSES];
+static float* bus_buffers_;    // AUDIO_BUSES * MIX_CHUNK * channels
+
+// The device clock: frames mixed so far, and where on ClockMillis() the
+// callbacks put them.  The mapping follows the callbacks through a slow
+// filter, so scheduled voices land on exact frames despite callback jitter.
+static const double CLOCK_SMOOTHING = 0.05;
+static Uint64 mixed_;
+static Uint64 anchor_frame_;
+static double anchor_ms_;
+static bool anchored_;
+static double jitter_ms_;
+static volatile float latency_ms_;   // read by the JS thread
+
+// Telemetry and stream read-ahead tuning, all on the audio thread except for
+// telemetry_, which the JS thread copies out.  In auto mode the read-ahead
+// doubles each time streams start running dry and shrinks back by a quarter after
+// TUNE_QUIET_MS without trouble, never below what the callback jitter needs.
+static const double TUNE_QUIET_MS = 10000;
+static const double TELEMETRY_SMOOTHING = 0.05;
+static volatile float telemetry_[TELEMETRY_SIZE];
+static Uint32 callbacks_;
+static Uint32 underruns_;
+static Uint32 starved_;
+static double last_callback_ms_;
+static double period_ms_;
+static double mix_ms_;
+static double mix_peak_ms_;
+static float stream_fill_;        // lowest in the current callback
+static bool stream_starved_;      // in the current callback
+static bool was_starved_;         // in the previous one
+static Uint32 stream_target_;     // frames
+static bool autotune_;
+static double tune_min_ms_;
+static double tune_max_ms_;
+static double quiet_ms_;
+
+// JS thread mirror of the largest read-ahead auto mode may ask for, so new
+// streams get rings that big.
+static double stream_buffer_ms_;
+
+// JS thread state.
+static bool audio_open_;
+static int generation_;     // counts opens, so late async loads can tell
+static SDL_AudioSpec device_;
+static std::map<int, Sound*> sounds_;
+static int next_sound_id_ = 1;
+static int next_voice_id_ = 1;
+static int effect_types_[AUDIO_BUSES][MAX_BUS_EFFECTS];  // -1 for free slots
+
+static void Retire(int type, void* ptr) {
+  Garbage item = { type, ptr };
+  // The rings are the same size and every command retires at most one thing,
+  // so this only fails if the JS thread stops calling in; then we leak.
+  garbage_.Push(item);
+}
+
+// Frees a voice slot, handing its stream back to the decoder.
+static void EndVoice(Voice* v) {
+  if (v->stream) v->stream->released = 1;
+  v->stream = NULL;
+  v->id = 0;
+}
+
+// Device frame heard at the given time, or 0 if that's already past.
+static Uint64 FrameAt(double when) {
+  double frame = anchor_frame_ + (when - latency_ms_ - anchor_ms_) * device_.freq / 1000.0;
+  return frame > (double)mixed_ ? (Uint64)(frame + 0.5) : 0;
+}
+
+// Moves the clock mapping towards the time this callback actually ran.
+// Callbacks that come far off schedule (an underrun, a stalled device)
+// restart the mapping.
+static void UpdateClock(double now, int frames) {
+  double buffer_ms = frames * 1000.0 / device_.freq;
+  if (anchored_) {
+    double predicted = anchor_ms_ + (double)(mixed_ - anchor_frame_) * 1000.0 / device_.freq;
+    double error = now - predicted;
+    if (error > buffer_ms) underruns_++;
+    if (fabs(error) > 4 * buffer_ms) {
+      anchored_ = false;
+    } else {
+      anchor_ms_ = predicted + error * CLOCK_SMOOTHING;
+      anchor_frame_ = mixed_;
+      jitter_ms_ = fabs(error) > jitter_ms_ * 0.995 ? fabs(error) : jitter_ms_ * 0.995;
+    }
+  }
+  if (!anchored_) {
+    anchor_ms_ = now;
+    anchor_frame_ = mixed_;
+    anchored_ = true;
+  }
+  // A buffer filled now is heard once the one ahead of it has played out,
+  // and the device has to queue enough extra to ride out the jitter.
+  latency_ms_ = (float)(buffer_ms + jitter_ms_);
+}
+
+static void ApplyCommand(const AudioCommand& cmd) {
+  switch (cmd.type) {
+    case CMD_PLAY:
+    case CMD_PLAY_STREAM:
+      for (int i = 0; i <= MAX_VOICES; i++) {
+        if (i == MAX_VOICES) {
+          if (cmd.type == CMD_PLAY_STREAM) ((Stream*)cmd.ptr)->released = 1;
+          break;
+        }
+        if (voices_[i].id) continue;
+        Voice& v = voices_[i];
+        v.sound = cmd.type == CMD_PLAY ? (Sound*)cmd.ptr : NULL;
+        v.stream = cmd.type == CMD_PLAY_STREAM ? (Stream*)cmd.ptr : NULL;
+        v.position = 0;
+        v.bus = cmd.bus;
+        v.gain = cmd.value;
+        v.loop = cmd.slot != 0;
+        v.start = cmd.when > 0 ? FrameAt(cmd.when) : 0;
+        v.id = cmd.id;
+        break;
+      }
+      break;
+    case CMD_STOP:
+    case CMD_VOICE_GAIN:
+      for (int i = 0; i < MAX_VOICES; i++) {
+        if (voices_[i].id != cmd.id) continue;
+        if (cmd.type == CMD_STOP) EndVoice(&voices_[i]);
+        else voices_[i].gain = cmd.value;
+      }
+      break;
+    case CMD_BUS_GAIN:
+      buses_[cmd.bus].gain = cmd.value;
+      break;
+    case CMD_SET_EFFECT:
+      if (buses_[cmd.bus].effects[cmd.slot]) Retire(GARBAGE_EFFECT, buses_[cmd.bus].effects[cmd.slot]);
+      buses_[cmd.bus].effects[cmd.slot] = (Effect*)cmd.ptr;
+      break;
+    case CMD_EFFECT_PARAM:
+      if (buses_[cmd.bus].effects[cmd.slot]) SetEffectParam(buses_[cmd.bus].effects[cmd.slot], cmd.param, cmd.value);
+      break;
+    case CMD_AUTOTUNE:
+      autotune_ = cmd.param != 0;
+      tune_min_ms_ = cmd.value;
+      tune_max_ms_ = cmd.when;
+      if (!autotune_) stream_target_ = device_.freq / 4;
+      break;
+    case CMD_RELEASE_SOUND:
+      for (int i = 0; i < MAX_VOICES; i++) {
+        if (voices_[i].id && voices_[i].sound == cmd.ptr) EndVoice(&voices_[i]);
+      }
+      Retire(GARBAGE_SOUND, cmd.ptr);
+      break;
+  }
+}
+
+static void FreeSoundData(Sound* sound) {
+  free(sound->samples);
+  delete sound;
+}
+
+static void CollectGarbage() {
+  Garbage item;
+  while (garbage_.Pop(&item)) {
+    if (item.type == GARBAGE_SOUND) FreeSoundData((Sound*)item.ptr);
+    else DestroyEffect((Effect*)item.ptr);
+  }
+}
+
+static bool Submit(const AudioCommand& cmd) {
+  CollectGarbage();
+  return commands_.Push(cmd);
+}
+
+// Adds whatever a streaming voice's ring holds, up to frames.  When the
+// decoder falls behind the rest of the chunk stays silent.
+static void MixStream(Voice* v, float* out, int frames, int channels) {
+  Stream* s = v->stream;
+  int eof = s->eof;
+  __sync_synchronize();
+  Uint32 tail = s->tail;
+  Uint32 available = s->head - tail;
+  __sync_synchronize();
+  if (available == 0 && eof) {
+    EndVoice(v);
+    return;
+  }
+  s->target = stream_target_;
+  float fill = (float)available / (stream_target_ < s->capacity ? stream_target_ : s->capacity);
+  if (fill < stream_fill_) stream_fill_ = fill;
+  int n = available < (Uint32)frames ? (int)available : frames;
+  // Running short before the decoder got going doesn't count.
+  if (n < frames && !eof && v->position > 0) stream_starved_ = true;
+  v->position += n;
+  Uint32 at = tail & (s->capacity - 1);
+  int first = (int)(s->capacity - at) < n ? (int)(s->capacity - at) : n;
+  MixSamples(out, s->ring + at * channels, first * channels, v->gain);
+  MixSamples(out + first * channels, s->ring, (n - first) * channels, v->gain);
+  __sync_synchronize();
+  s->tail = tail + n;
+}
+
+// Adds what's left of a voice to its bus.  Voices that end free their slot.
+static void MixVoice(Voice* v, float* out, int frames, int channels) {
+  if (v->stream) {
+    MixStream(v, out, frames, channels);
+    return;
+  }
+  const Sound* sound = v->sound;
+  int done = 0;
+  while (done < frames) {
+    int n = sound->frames - v->position;
+    if (n > frames - done) n = frames - done;
+    if (n > 0) {
+      MixSamples(out + done * channels, sound->samples + v->position * channels, n * channels, v->gain);
+      v->position += n;
+      done += n;
+    }
+    if (v->position >= sound->frames) {
+      if (!v->loop || sound->frames == 0) {
+        EndVoice(v);
+        return;
+      }
+      v->position = 0;
+    }
+  }
+}
+
+static void MixChunk(int frames, int channels) {
+  const Uint64 first = mixed_;
+  const int count = frames * channels;
+  bool active[AUDIO_BUSES];
+  for (int b = 0; b < AUDIO_BUSES; b++) {
+    // Buses with effects keep running so reverb tails ring out.
+    active[b] = b == 0 || buses_[b].effects[0] != NULL;
+    for (int s = 1; !active[b] && s < MAX_BUS_EFFECTS; s++) active[b] = buses_[b].effects[s] != NULL;
+    memset(bus_buffers_ + b * MIX_CHUNK * channels, 0, count * sizeof(float));
+  }
+
+  for (int i = 0; i < MAX_VOICES; i++) {
+    Voice* v = &voices_[i];
+    if (!v->id) continue;
+    int offset = v->start > first ? (v->start - first < (Uint64)frames ? (int)(v->start - first) : frames) : 0;
+    if (offset == frames) continue;
+    active[v->bus] = true;
+    MixVoice(v, bus_buffers_ + (v->bus * MIX_CHUNK + offset) * channels, frames - offset, channels);
+  }
+
+  float* master = bus_buffers_;
+  for (int b = AUDIO_BUSES - 1; b >= 0; b--) {
+    if (!active[b]) continue;
+    float* buffer = bus_buffers_ + b * MIX_CHUNK * channels;
+    for (int s = 0; s < MAX_BUS_EFFECTS; s++) {
+      if (buses_[b].effects[s]) ProcessEffect(buses_[b].effects[s], buffer, frames);
+    }
+    if (b > 0) MixSamples(master, buffer, count, buses_[b].gain);
+    else if (buses_[0].gain != 1.0f) ScaleSamples(master, count, buses_[0].gain);
+  }
+  mixed_ += frames;
+}
+
+// Adjusts the stream read-ahead and publishes telemetry after a callback.
+static void UpdateTelemetry(double start, int frames) {
+  const double rate = device_.freq;
+  double now = ClockMillis();
+  double buffer_ms = frames * 1000.0 / rate;
+  double mix = now - start;
+
+  if (callbacks_ == 0) {
+    period_ms_ = buffer_ms;
+    mix_ms_ = mix;
+  } else {
+    period_ms_ += (start - last_callback_ms_ - period_ms_) * TELEMETRY_SMOOTHING;
+    mix_ms_ += (mix - mix_ms_) * TELEMETRY_SMOOTHING;
+  }
+  mix_peak_ms_ = mix > mix_peak_ms_ * 0.995 ? mix : mix_peak_ms_ * 0.995;
+  last_callback_ms_ = start;
+  callbacks_++;
+
+  if (stream_starved_) {
+    starved_++;
+    quiet_ms_ = 0;
+    if (autotune_ && !was_starved_) {
+      double ms = stream_target_ * 2000.0 / rate;
+      stream_target_ = (Uint32)((ms < tune_max_ms_ ? ms : tune_max_ms_) * rate / 1000);
+    }
+  } else if ((quiet_ms_ += buffer_ms) > TUNE_QUIET_MS) {
+    quiet_ms_ = 0;
+    if (autotune_) {
+      // The decoder wakes every 10ms and has to cover the mixer's jitter.
+      double floor = 4 * (jitter_ms_ + buffer_ms) + 10;
+      double ms = stream_target_ * 750.0 / rate;
+      if (ms < floor) ms = floor;
+      if (ms < tune_min_ms_) ms = tune_min_ms_;
+      if (ms < stream_target_ * 1000.0 / rate) stream_target_ = (Uint32)(ms * rate / 1000);
+    }
+  }
+  was_starved_ = stream_starved_;
+  if (autotune_) {
+    Uint32 lo = (Uint32)(tune_min_ms_ * rate / 1000), hi = (Uint32)(tune_max_ms_ * rate / 1000);
+    if (lo < (Uint32)MIX_CHUNK) lo = MIX_CHUNK;
+    if (hi < lo) hi = lo;
+    if (stream_target_ < lo) stream_target_ = lo;
+    if (stream_target_ > hi) stream_target_ = hi;
+  }
+
+  // Enough buffer to absorb twice the worst recent lateness plus mixing time.
+  int suggested = 256;
+  while (suggested < 8192 && suggested * 1000.0 / rate < 2 * (jitter_ms_ + mix_peak_ms_)) suggested <<= 1;
+
+  telemetry_[TELEMETRY_CALLBACKS] = (float)callbacks_;
+  telemetry_[TELEMETRY_UNDERRUNS] = (float)underruns_;
+  telemetry_[TELEMETRY_STARVED] = (float)starved_;
+  telemetry_[TELEMETRY_PERIOD] = (float)period_ms_;
+  telemetry_[TELEMETRY_JITTER] = (float)jitter_ms_;
+  telemetry_[TELEMETRY_MIX_TIME] = (float)mix_ms_;
+  telemetry_[TELEMETRY_MIX_PEAK] = (float)mix_peak_ms_;
+  telemetry_[TELEMETRY_LOAD] = (float)(mix_ms_ / buffer_ms);
+  telemetry_[TELEMETRY_LATENCY] = latency_ms_;
+  telemetry_[TELEMETRY_STREAM_FILL] = stream_fill_ > 1.0f ? 1.0f : stream_fill_;
+  telemetry_[TELEMETRY_STREAM_TARGET] = (float)(stream_target_ * 1000.0 / rate);
+  telemetry_[TELEMETRY_SAMPLES] = (float)frames;
+  telemetry_[TELEMETRY_SUGGESTED_SAMPLES] = (float)suggested;
+}
+
+static void AudioCallback(void* userdata, Uint8* stream, int len) {
+#ifdef __SSE2__
+  // Flush denormals to zero: filter and reverb state decays into them.
+  _mm_setcsr(_mm_getcsr() | 0x8040);
+#endif
+  const int channels = device_.channels;
+  Sint16* out = (Sint16*)stream;
+  int frames = len / (int)(sizeof(Sint16) * channels);
+
+  double start = ClockMillis();
+  UpdateClock(start, frames);
+  AudioCommand cmd;
+  while (commands_.Pop(&cmd)) ApplyCommand(cmd);
+  stream_fill_ = 1.0f;   // until a stream says otherwise
+  stream_starved_ = false;
+
+  while (frames > 0) {
+    int n = frames < MIX_CHUNK ? frames : MIX_CHUNK;
+    MixChunk(n, channels);
+    FloatToS16(bus_buffers_, out, n * channels);
+    out += n * channels;
+    frames -= n;
+  }
+  UpdateTelemetry(start, len / (int)(sizeof(Sint16) * channels));
+}
+
+static Handle<Value> ThrowNotOpen(const char* name) {
+  return ThrowException(Exception::Error(String::Concat(String::New(name),
+    String::New(": Audio device is not open"))));
+}
+
+static Handle<Value> ThrowQueueFull(const char* name) {
+  return ThrowException(Exception::Error(String::Concat(String::New(name),
+    String::New(": Audio command queue is full"))));
+}
+
+static Sound* LookupSound(Handle<Value> value) {
+  std::map<int, Sound*>::iterator it = sounds_.find(value->Int32Value());
+  return it == sounds_.end() ? NULL : it->second;
+}
+
+static int AddSound(Sound* sound) {
+  int id = next_sound_id_++;
+  sounds_[id] = sound;
+  return id;
+}
+
+// Opens the audio device for signed 16 bit output and starts the mixer.
+// Returns the format in use as { frequency, channels, samples }.
+Handle<Value> AUDIO::Open(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 3 && args[0]->IsNumber() && args[1]->IsNumber() && args[2]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected AUDIO::Open(Number, Number, Number)")));
+  }
+  if (audio_open_) {
+    return ThrowException(Exception::Error(String::New("AUDIO::Open: Audio device is already open")));
+  }
+  int channels = args[1]->Int32Value();
+  if (channels < 1 || channels > MAX_AUDIO_CHANNELS) {
+    return ThrowException(Exception::RangeError(String::New("AUDIO::Open: Unsupported channel count")));
+  }
+
+  memset(&device_, 0, sizeof(device_));
+  device_.freq = args[0]->Int32Value();
+  device_.format = AUDIO_S16SYS;
+  device_.channels = channels;
+  device_.samples = args[2]->Int32Value();
+  device_.callback = AudioCallback;
+
+  bus_buffers_ = (float*)calloc(AUDIO_BUSES * MIX_CHUNK * channels, sizeof(float));
+  if (!bus_buffers_) {
+    return ThrowException(Exception::Error(String::New("AUDIO::Open: Out of memory")));
+  }
+  memset(voices_, 0, sizeof(voices_));
+  memset(buses_, 0, sizeof(buses_));
+  for (int b = 0; b < AUDIO_BUSES; b++) {
+    buses_[b].gain = 1.0f;
+    for (int s = 0; s < MAX_BUS_EFFECTS; s++) effect_types_[b][s] = -1;
+  }
+
+  // No obtained spec: SDL converts to whatever the hardware wants.
+  if (SDL_OpenAudio(&device_, NULL) < 0) {
+    free(bus_buffers_);
+    bus_buffers_ = NULL;
+    return ThrowSDLException("AUDIO::Open");
+  }
+  audio_open_ = true;
+  generation_++;
+  // The device starts paused, so nothing reads these yet.
+  mixed_ = 0;
+  anchored_ = false;
+  jitter_ms_ = 0;
+  latency_ms_ = (float)(device_.samples * 1000.0 / device_.freq);
+  callbacks_ = underruns_ = starved_ = 0;
+  was_starved_ = false;
+  mix_peak_ms_ = quiet_ms_ = 0;
+  stream_target_ = device_.freq / 4;
+  autotune_ = false;
+  stream_buffer_ms_ = 250;
+  memset((void*)telemetry_, 0, sizeof(telemetry_));
+  SDL_PauseAudio(0);
+
+  Local<Object> spec = Object::New();
+  spec->Set(String::New("frequency"), Number::New(device_.freq));
+  spec->Set(String::New("channels"), Number::New(device_.channels));
+  spec->Set(String::New("samples"), Number::New(device_.samples));
+  return scope.Close(spec);
+}
+
+// Stops the device and frees every sound and effect.
+Handle<Value> AUDIO::Close(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 0)) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected AUDIO::Close()")));
+  }
+  if (!audio_open_) return Undefined();
+
+  // Once the device is closed the audio thread is gone and its state is ours.
+  SDL_CloseAudio();
+  audio_open_ = false;
+  AudioCommand cmd;
+  while (commands_.Pop(&cmd)) ApplyCommand(cmd);
+  CollectGarbage();
+  StopDecoder();
+
+  for (int b = 0; b < AUDIO_BUSES; b++) {
+    for (int s = 0; s < MAX_BUS_EFFECTS; s++) DestroyEffect(buses_[b].effects[s]);
+  }
+  memset(buses_, 0, sizeof(buses_));
+  memset(voices_, 0, sizeof(voices_));
+  for (std::map<int, Sound*>::iterator it = sounds_.begin(); it != sounds_.end(); ++it) {
+    FreeSoundData(it->second);
+  }
+  sounds_.clear();
+  free(bus_buffers_);
+  bus_buffers_ = NULL;
+
+  return Undefined();
+}
+
+// Loads a WAV file converted to the device format.  Returns a sound id.
+Handle<Value> AUDIO::LoadWAV(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 1 && args[0]->IsString())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected AUDIO::LoadWAV(String)")));
+  }
+  if (!audio_open_) return ThrowNotOpen("AUDIO::LoadWAV");
+
+  String::Utf8Value file(args[0]);
+  SDL_AudioSpec spec;
+  Uint8* data;
+  Uint32 length;
+  if (!SDL_LoadWAV(*file, &spec, &data, &length)) return ThrowSDLException("AUDIO::LoadWAV");
+
+  SDL_AudioCVT cvt;
+  if (SDL_BuildAudioCVT(&cvt, spec.format, spec.channels, spec.freq,
+      AUDIO_S16SYS, device_.channels, device_.freq) < 0) {
+    SDL_FreeWAV(data);
+    return ThrowSDLException("AUDIO::LoadWAV");
+  }
+  cvt.len = length;
+  cvt.buf = (Uint8*)malloc(length * cvt.len_mult + 1);
+  if (!cvt.buf) {
+    SDL_FreeWAV(data);
+    return ThrowException(Exception::Error(String::New("AUDIO::LoadWAV: Out of memory")));
+  }
+  memcpy(cvt.buf, data, length);
+  SDL_FreeWAV(data);
+  if (SDL_ConvertAudio(&cvt) < 0) {
+    free(cvt.buf);
+    return ThrowSDLException("AUDIO::LoadWAV");
+  }
+
+  int samples = cvt.len_cvt / sizeof(Sint16);
+  Sound* sound = new Sound();
+  sound->channels = device_.channels;
+  sound->frames = samples / device_.channels;
+  sound->samples = (float*)malloc(samples * sizeof(float) + 1);
+  if (!sound->samples) {
+    free(cvt.buf);
+    delete sound;
+    return ThrowException(Exception::Error(String::New("AUDIO::LoadWAV: Out of memory")));
+  }
+  S16ToFloat((const Sint16*)cvt.buf, sound->samples, samples);
+  free(cvt.buf);
+
+  return scope.Close(Number::New(AddSound(sound)));
+}
+
+// Makes a sound from a Float32Array of interleaved samples already in the
+// device's rate and channel count.  Returns a sound id.
+Handle<Value> AUDIO::CreateSound(const Arguments& args) {
+  HandleScope scope;
+
+  int length = 0;
+  float* pcm = args.Length() == 1 ? (float*)TypedArrayData(args[0], kExternalFloatArray, &length) : NULL;
+  if (!pcm) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected AUDIO::CreateSound(Float32Array)")));
+  }
+  if (!audio_open_) return ThrowNotOpen("AUDIO::CreateSound");
+
+  Sound* sound = new Sound();
+  sound->channels = device_.channels;
+  sound->frames = length / device_.channels;
+  sound->samples = (float*)malloc((size_t)sound->frames * sound->channels * sizeof(float) + 1);
+  if (!sound->samples) {
+    delete sound;
+    return ThrowException(Exception::Error(String::New("AUDIO::CreateSound: Out of memory")));
+  }
+  memcpy(sound->samples, pcm, (size_t)sound->frames * sound->channels * sizeof(float));
+
+  return scope.Close(Number::New(AddSound(sound)));
+}
+
+// Stops every voice playing the sound and frees it.
+Handle<Value> AUDIO::FreeSound(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 1 && args[0]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected AUDIO::FreeSound(Number)")));
+  }
+  Sound* sound = LookupSound(args[0]);
+  if (!sound) return Undefined();
+
+  AudioCommand cmd = { CMD_RELEASE_SOUND, 0, 0, 0, 0, 0, sound };
+  if (!Submit(cmd)) return ThrowQueueFull("AUDIO::FreeSound");
+  sounds_.erase(args[0]->Int32Value());
+
+  return Undefined();
+}
+
+typedef struct {
+  Persistent<Function> fn;
+  char* file;
+  int generation;
+  int rate;
+  int channels;
+  Sound* sound;
+  const char* error;
+} ogg_closure_t;
+
+static void EIO_DecodeOgg(eio_req *req) {
+  ogg_closure_t *closure = (ogg_closure_t *) req->data;
+  closure->sound = DecodeOgg(closure->file, closure->rate, closure->channels, &closure->error);
+}
+
+static int EIO_OnOgg(eio_req *req) {
+  HandleScope scope;
+
+  ogg_closure_t *closure = (ogg_closure_t *) req->data;
+  ev_unref(EV_DEFAULT_UC);
+
+  // The device may have been reopened in another format meanwhile.
+  if (closure->sound && !(audio_open_ && generation_ == closure->generation)) {
+    FreeSoundData(closure->sound);
+    closure->sound = NULL;
+    closure->error = "Audio device was closed";
+  }
+
+  Handle<Value> argv[2];
+  if (!closure->sound) {
+    argv[0] = Exception::Error(String::Concat(String::New("AUDIO::LoadOgg: "), String::New(closure->error)));
+    argv[1] = Undefined();
+  } else {
+    argv[0] = Undefined();
+    argv[1] = Number::New(AddSound(closure->sound));
+  }
+
+  closure->fn->Call(Context::GetCurrent()->Global(), 2, argv);
+
+  free(closure->file);
+  closure->fn.Dispose();
+  delete closure;
+  return 0;
+}
+
+// Decodes a whole Ogg Vorbis file on the thread pool, converted to the device
+// format.  Calls back with (err, sound id).  Meant for short effects; use
+// StreamOgg for music.
+Handle<Value> AUDIO::LoadOgg(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 2 && args[0]->IsString() && args[1]->IsFunction())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected AUDIO::LoadOgg(String, Function)")));
+  }
+  if (!audio_open_) return ThrowNotOpen("AUDIO::LoadOgg");
+
+  String::Utf8Value file(args[0]);
+  ogg_closure_t *closure = new ogg_closure_t();
+  closure->file = strdup(*file);
+  closure->generation = generation_;
+  closure->rate = device_.freq;
+  closure->channels = device_.channels;
+  closure->sound = NULL;
+  closure->error = NULL;
+
+  closure->fn = Persistent<Function>::New(Handle<Function>::Cast(args[1]));
+  eio_custom(EIO_DecodeOgg, EIO_PRI_DEFAULT, EIO_OnOgg, closure);
+  ev_ref(EV_DEFAULT_UC);
+  return Undefined();
+}
+
+// Starts a sound on a bus, optionally at a given AUDIO.now() time: the mixer
+// then starts it on the frame that will be heard at that moment.  Returns a
+// voice id for Stop and SetVoiceGain.
+Handle<Value> AUDIO::Play(const Arguments& args) {
+  HandleScope scope;
+
+  if (!((args.Length() == 4 || (args.Length() == 5 && args[4]->IsNumber())) && args[0]->IsNumber() && args[1]->IsNumber() && args[2]->IsNumber() && args[3]->IsBoolean())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected AUDIO::Play(Number, Number, Number, Boolean, [Number])")));
+  }
+  Sound* sound = LookupSound(args[0]);
+  int bus = args[1]->Int32Value();
+  if (!sound) return ThrowException(Exception::Error(String::New("AUDIO::Play: No such sound")));
+  if (bus < 0 || bus >= AUDIO_BUSES) return ThrowException(Exception::RangeError(String::New("AUDIO::Play: No such bus")));
+
+  int id = next_voice_id_++;
+  if (next_voice_id_ <= 0) next_voice_id_ = 1;
+  double when = args.Length() == 5 ? args[4]->NumberValue() : 0;
+  AudioCommand cmd = { CMD_PLAY, id, bus, args[3]->BooleanValue() ? 1 : 0, 0, (float)args[2]->NumberValue(), sound, when };
+  if (!Submit(cmd)) return ThrowQueueFull("AUDIO::Play");
+
+  return scope.Close(Number::New(id));
+}
+
+// Plays an Ogg Vorbis file on a bus while a background thread decodes it.
+// Takes the same optional start time and returns a voice id like Play.  A file that turns out not to be Ogg Vorbis
+// plays as silence and ends at once.
+Handle<Value> AUDIO::StreamOgg(const Arguments& args) {
+  HandleScope scope;
+
+  if (!((args.Length() == 4 || (args.Length() == 5 && args[4]->IsNumber())) && args[0]->IsString() && args[1]->IsNumber() && args[2]->IsNumber() && args[3]->IsBoolean())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected AUDIO::StreamOgg(String, Number, Number, Boolean, [Number])")));
+  }
+  if (!audio_open_) return ThrowNotOpen("AUDIO::StreamOgg");
+  int bus = args[1]->Int32Value();
+  if (bus < 0 || bus >= AUDIO_BUSES) return ThrowException(Exception::RangeError(String::New("AUDIO::StreamOgg: No such bus")));
+
+  String::Utf8Value name(args[0]);
+  FILE* file = fopen(*name, "rb");
+  if (!file) {
+    return ThrowException(Exception::Error(String::Concat(String::New("AUDIO::StreamOgg: Couldn't open "), args[0]->ToString())));
+  }
+  if (!StartDecoder()) {
+    fclose(file);
+    return ThrowSDLException("AUDIO::StreamOgg");
+  }
+  int frames = (int)(stream_buffer_ms_ * device_.freq / 1000);
+  Stream* stream = OpenOggStream(file, device_.freq, device_.channels, frames, args[3]->BooleanValue());
+  if (!stream) return ThrowException(Exception::Error(String::New("AUDIO::StreamOgg: Out of memory")));
+
+  int id = next_voice_id_++;
+  if (next_voice_id_ <= 0) next_voice_id_ = 1;
+  double when = args.Length() == 5 ? args[4]->NumberValue() : 0;
+  AudioCommand cmd = { CMD_PLAY_STREAM, id, bus, 0, 0, (float)args[2]->NumberValue(), stream, when };
+  if (!Submit(cmd)) {
+    stream->released = 1;
+    return ThrowQueueFull("AUDIO::StreamOgg");
+  }
+
+  return scope.Close(Number::New(id));
+}
+
+Handle<Value> AUDIO::Stop(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 1 && args[0]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected AUDIO::Stop(Number)")));
+  }
+  if (!audio_open_) return ThrowNotOpen("AUDIO::Stop");
+
+  AudioCommand cmd = { CMD_STOP, args[0]->Int32Value(), 0, 0, 0, 0, NULL };
+  if (!Submit(cmd)) return ThrowQueueFull("AUDIO::Stop");
+
+  return Undefined();
+}
+
+Handle<Value> AUDIO::SetVoiceGain(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 2 && args[0]->IsNumber() && args[1]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected AUDIO::SetVoiceGain(Number, Number)")));
+  }
+  if (!audio_open_) return ThrowNotOpen("AUDIO::SetVoiceGain");
+
+  AudioCommand cmd = { CMD_VOICE_GAIN, args[0]->Int32Value(), 0, 0, 0, (float)args[1]->NumberValue(), NULL };
+  if (!Submit(cmd)) return ThrowQueueFull("AUDIO::SetVoiceGain");
+
+  return Undefined();
+}
+
+Handle<Value> AUDIO::SetBusGain(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 2 && args[0]->IsNumber() && args[1]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected AUDIO::SetBusGain(Number, Number)")));
+  }
+  if (!audio_open_) return ThrowNotOpen("AUDIO::SetBusGain");
+  int bus = args[0]->Int32Value();
+  if (bus < 0 || bus >= AUDIO_BUSES) return ThrowException(Exception::RangeError(String::New("AUDIO::SetBusGain: No such bus")));
+
+  AudioCommand cmd = { CMD_BUS_GAIN, 0, bus, 0, 0, (float)args[1]->NumberValue(), NULL };
+  if (!Submit(cmd)) return ThrowQueueFull("AUDIO::SetBusGain");
+
+  return Undefined();
+}
+
+// Reads { name: value } effect parameters into indices and values.  Returns
+// the number read, or -1 if a name doesn't belong to the effect type.
+static int ReadEffectParams(int type, Handle<Value> value, int* indices, float* values) {
+  if (!value->IsObject()) return 0;
+  Handle<Object> params = value->ToObject();
+  Local<Array> names = params->GetPropertyNames();
+  int count = 0;
+  for (unsigned i = 0; i < names->Length() && count < MAX_EFFECT_PARAMS; i++) {
+    Local<Value> name = names->Get(i);
+    String::Utf8Value utf8(name);
+    int index = EffectParamIndex(type, *utf8);
+    if (index < 0) return -1;
+    indices[count] = index;
+    values[count++] = (float)params->Get(name)->NumberValue();
+  }
+  return count;
+}
+
+static bool ValidSlot(int bus, int slot) {
+  return bus >= 0 && bus < AUDIO_BUSES && slot >= 0 && slot < MAX_BUS_EFFECTS && effect_types_[bus][slot] >= 0;
+}
+
+// Appends an effect of the given type to a bus's chain, with optional
+// { name: value } parameters.  Returns its slot.
+Handle<Value> AUDIO::AddEffect(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 3 && args[0]->IsNumber() && args[1]->IsNumber() && (args[2]->IsObject() || args[2]->IsUndefined()))) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected AUDIO::AddEffect(Number, Number, Object)")));
+  }
+  if (!audio_open_) return ThrowNotOpen("AUDIO::AddEffect");
+  int bus = args[0]->Int32Value(), type = args[1]->Int32Value();
+  if (bus < 0 || bus >= AUDIO_BUSES) return ThrowException(Exception::RangeError(String::New("AUDIO::AddEffect: No such bus")));
+  if (type < 0 || type >= EFFECT_TYPES) return ThrowException(Exception::RangeError(String::New("AUDIO::AddEffect: No such effect")));
+
+  int slot = 0;
+  while (slot < MAX_BUS_EFFECTS && effect_types_[bus][slot] >= 0) slot++;
+  if (slot == MAX_BUS_EFFECTS) return ThrowException(Exception::Error(String::New("AUDIO::AddEffect: Effect chain is full")));
+
+  int indices[MAX_EFFECT_PARAMS];
+  float values[MAX_EFFECT_PARAMS];
+  int count = ReadEffectParams(type, args[2], indices, values);
+  if (count < 0) return ThrowException(Exception::TypeError(String::New("AUDIO::AddEffect: Unknown effect parameter")));
+
+  // Not shared with the audio thread yet, so set up in place.
+  Effect* effect = CreateEffect(type, device_.freq, device_.channels);
+  if (!effect) return ThrowException(Exception::Error(String::New("AUDIO::AddEffect: Out of memory")));
+  for (int i = 0; i < count; i++) SetEffectParam(effect, indices[i], values[i]);
+
+  AudioCommand cmd = { CMD_SET_EFFECT, 0, bus, slot, 0, 0, effect };
+  if (!Submit(cmd)) {
+    DestroyEffect(effect);
+    return ThrowQueueFull("AUDIO::AddEffect");
+  }
+  effect_types_[bus][slot] = type;
+
+  return scope.Close(Number::New(slot));
+}
+
+// Changes parameters of an effect in place, e.g. SetEffect(bus, slot,
+// { frequency: 800 }).
+Handle<Value> AUDIO::SetEffect(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 3 && args[0]->IsNumber() && args[1]->IsNumber() && args[2]->IsObject())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected AUDIO::SetEffect(Number, Number, Object)")));
+  }
+  if (!audio_open_) return ThrowNotOpen("AUDIO::SetEffect");
+  int bus = args[0]->Int32Value(), slot = args[1]->Int32Value();
+  if (!ValidSlot(bus, slot)) return ThrowException(Exception::RangeError(String::New("AUDIO::SetEffect: No such effect")));
+
+  int indices[MAX_EFFECT_PARAMS];
+  float values[MAX_EFFECT_PARAMS];
+  int count = ReadEffectParams(effect_types_[bus][slot], args[2], indices, values);
+  if (count < 0) return ThrowException(Exception::TypeError(String::New("AUDIO::SetEffect: Unknown effect parameter")));
+
+  for (int i = 0; i < count; i++) {
+    AudioCommand cmd = { CMD_EFFECT_PARAM, 0, bus, slot, indices[i], values[i], NULL };
+    if (!Submit(cmd)) return ThrowQueueFull("AUDIO::SetEffect");
+  }
+
+  return Undefined();
+}
+
+Handle<Value> AUDIO::RemoveEffect(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 2 && args[0]->IsNumber() && args[1]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected AUDIO::RemoveEffect(Number, Number)")));
+  }
+  if (!audio_open_) return ThrowNotOpen("AUDIO::RemoveEffect");
+  int bus = args[0]->Int32Value(), slot = args[1]->Int32Value();
+  if (!ValidSlot(bus, slot)) return ThrowException(Exception::RangeError(String::New("AUDIO::RemoveEffect: No such effect")));
+
+  AudioCommand cmd = { CMD_SET_EFFECT, 0, bus, slot, 0, 0, NULL };
+  if (!Submit(cmd)) return ThrowQueueFull("AUDIO::RemoveEffect");
+  effect_types_[bus][slot] = -1;
+
+  return Undefined();
+}
+
+// The clock that Play's start times are given on, in milliseconds.  Read it
+// once per rendered frame to schedule sounds against that frame.
+Handle<Value> AUDIO::Now(const Arguments& args) {
+  HandleScope scope;
+
+  return scope.Close(Number::New(ClockMillis()));
+}
+
+// Estimated milliseconds from mixing a frame to hearing it: one device buffer
+// plus the callback jitter seen lately.  Scheduled sounds already allow for
+// it; a frame scheduler can use it to line pictures up with sound.
+Handle<Value> AUDIO::Latency(const Arguments& args) {
+  HandleScope scope;
+
+  if (!audio_open_) return ThrowNotOpen("AUDIO::Latency");
+  return scope.Close(Number::New(latency_ms_));
+}
+
+// Copies the mixer telemetry (see AUDIO.TELEMETRY) into a Float32Array of at
+// least AUDIO.TELEMETRY.SIZE elements.  Cheap enough to call every frame.
+Handle<Value> AUDIO::ReadTelemetry(const Arguments& args) {
+  HandleScope scope;
+
+  int length = 0;
+  float* out = args.Length() == 1 ? (float*)TypedArrayData(args[0], kExternalFloatArray, &length) : NULL;
+  if (!out || length < TELEMETRY_SIZE) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected AUDIO::ReadTelemetry(Float32Array)")));
+  }
+  if (!audio_open_) return ThrowNotOpen("AUDIO::ReadTelemetry");
+
+  for (int i = 0; i < TELEMETRY_SIZE; i++) out[i] = telemetry_[i];
+  return Undefined();
+}
+
+// Turns automatic tuning of the stream read-ahead on or off.  When on, the
+// mixer keeps decoded audio between minMs and maxMs ahead, growing the lead
+// when a stream runs dry and shrinking it again while things go smoothly.
+// Affects streams started afterwards, whose rings are sized for maxMs.
+Handle<Value> AUDIO::SetAutoTune(const Arguments& args) {
+  HandleScope scope;
+
+  if (!((args.Length() == 1 || (args.Length() == 3 && args[1]->IsNumber() && args[2]->IsNumber())) && args[0]->IsBoolean())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected AUDIO::SetAutoTune(Boolean, [Number, Number])")));
+  }
+  if (!audio_open_) return ThrowNotOpen("AUDIO::SetAutoTune");
+  bool enabled = args[0]->BooleanValue();
+  double min_ms = args.Length() == 3 ? args[1]->NumberValue() : 50;
+  double max_ms = args.Length() == 3 ? args[2]->NumberValue() : 1000;
+  if (!(min_ms > 0 && max_ms >= min_ms && max_ms <= 10000)) {
+    return ThrowException(Exception::RangeError(String::New("AUDIO::SetAutoTune: Expected 0 < minMs <= maxMs <= 10000")));
+  }
+
+  AudioCommand cmd = { CMD_AUTOTUNE, 0, 0, 0, enabled ? 1 : 0, (float)min_ms, NULL, max_ms };
+  if (!Submit(cmd)) return ThrowQueueFull("AUDIO::SetAutoTune");
+  stream_buffer_ms_ = enabled && max_ms > 250 ? max_ms : 250;
+
+  return Undefined();
+}
+
+void ExportAudio(Handle<Object> target) {
+  HandleScope scope;
+
+  Local<Object> AUDIO = Object::New();
+  target->Set(String::New("AUDIO"), AUDIO);
+  NODE_SET_METHOD(AUDIO, "open", sdl::AUDIO::Open);
+  NODE_SET_METHOD(AUDIO, "close", sdl::AUDIO::Close);
+  NODE_SET_METHOD(AUDIO, "loadWAV", sdl::AUDIO::LoadWAV);
+  NODE_SET_METHOD(AUDIO, "createSound", sdl::AUDIO::CreateSound);
+  NODE_SET_METHOD(AUDIO, "freeSound", sdl::AUDIO::FreeSound);
+  NODE_SET_METHOD(AUDIO, "loadOgg", sdl::AUDIO::LoadOgg);
+  NODE_SET_METHOD(AUDIO, "play", sdl::AUDIO::Play);
+  NODE_SET_METHOD(AUDIO, "streamOgg", sdl::AUDIO::StreamOgg);
+  NODE_SET_METHOD(AUDIO, "stop", sdl::AUDIO::Stop);
+  NODE_SET_METHOD(AUDIO, "now", sdl::AUDIO::Now);
+  NODE_SET_METHOD(AUDIO, "latency", sdl::AUDIO::Latency);
+  NODE_SET_METHOD(AUDIO, "readTelemetry", sdl::AUDIO::ReadTelemetry);
+  NODE_SET_METHOD(AUDIO, "setAutoTune", sdl::AUDIO::SetAutoTune);
+  NODE_SET_METHOD(AUDIO, "setVoiceGain", sdl::AUDIO::SetVoiceGain);
+  NODE_SET_METHOD(AUDIO, "setBusGain", sdl::AUDIO::SetBusGain);
+  NODE_SET_METHOD(AUDIO, "addEffect", sdl::AUDIO::AddEffect);
+  NODE_SET_METHOD(AUDIO, "setEffect", sdl::AUDIO::SetEffect);
+  NODE_SET_METHOD(AUDIO, "removeEffect", sdl::AUDIO::RemoveEffect);
+
+  AUDIO->Set(String::New("BUSES"), Number::New(AUDIO_BUSES));
+  AUDIO->Set(String::New("MASTER"), Number::New(0));
+  AUDIO->Set(String::New("MAX_VOICES"), Number::New(MAX_VOICES));
+
+  Local<Object> EFFECT = Object::New();
+  AUDIO->Set(String::New("EFFECT"), EFFECT);
+  EFFECT->Set(String::New("LOWPASS"), Number::New(EFFECT_LOWPASS));
+  EFFECT->Set(String::New("HIGHPASS"), Number::New(EFFECT_HIGHPASS));
+  EFFECT->Set(String::New("REVERB"), Number::New(EFFECT_REVERB));
+  EFFECT->Set(String::New("COMPRESSOR"), Number::New(EFFECT_COMPRESSOR));
+  EFFECT->Set(String::New("LIMITER"), Number::New(EFFECT_LIMITER));
+
+  Local<Object> TELEMETRY = Object::New();
+  AUDIO->Set(String::New("TELEMETRY"), TELEMETRY);
+  TELEMETRY->Set(String::New("CALLBACKS"), Number::New(TELEMETRY_CALLBACKS));
+  TELEMETRY->Set(String::New("UNDERRUNS"), Number::New(TELEMETRY_UNDERRUNS));
+  TELEMETRY->Set(String::New("STARVED"), Number::New(TELEMETRY_STARVED));
+  TELEMETRY->Set(String::New("PERIOD"), Number::New(TELEMETRY_PERIOD));
+  TELEMETRY->Set(String::New("JITTER"), Number::New(TELEMETRY_JITTER));
+  TELEMETRY->Set(String::New("MIX_TIME"), Number::New(TELEMETRY_MIX_TIME));
+  TELEMETRY->Set(String::New("MIX_PEAK"), Number::New(TELEMETRY_MIX_PEAK));
+  TELEMETRY->Set(String::New("LOAD"), Number::New(TELEMETRY_LOAD));
+  TELEMETRY->Set(String::New("LATENCY"), Number::New(TELEMETRY_LATENCY));
+  TELEMETRY->Set(String::New("STREAM_FILL"), Number::New(TELEMETRY_STREAM_FILL));
+  TELEMETRY->Set(String::New("STREAM_TARGET"), Number::New(TELEMETRY_STREAM_TARGET));
+  TELEMETRY->Set(String::New("SAMPLES"), Number::New(TELEMETRY_SAMPLES));
+  TELEMETRY->Set(String::New("SUGGESTED_SAMPLES"), Number::New(TELEMETRY_SUGGESTED_SAMPLES));
+  TELEMETRY->Set(String::New("SIZE"), Number::New(TELEMETRY_SIZE));
+}
+
+} // sdl
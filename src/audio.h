@@ -0,0 +1,88 @@
+#ifndef NODE_SDL_AUDIO_H_
+#define NODE_SDL_AUDIO_H_
+
+#include <v8.h>
+#include <node.h>
+#include <SDL.h>
+
+using namespace v8;
+
+namespace sdl {
+
+  // The mixer plays sounds on buses.  Bus 0 is the master: buses 1 and up
+  // run their own effect chains and are summed into it, then the master's
+  // chain runs and the result goes to the device.
+  const int AUDIO_BUSES = 8;
+  const int MAX_BUS_EFFECTS = 8;
+  const int MAX_VOICES = 64;
+
+  // Frames mixed per pass; callback buffers are mixed in chunks of this size.
+  const int MIX_CHUNK = 256;
+
+  // PCM in the device's channel layout and rate, as interleaved floats.
+  struct Sound {
+    float* samples;
+    int frames;
+    int channels;
+  };
+
+  // PCM produced by a decoder thread while it plays: a single producer,
+  // single consumer ring of interleaved frames in the device's format.  The
+  // decoder sets eof after its last frame; the mixer sets released once no
+  // voice uses the stream any more, and the decoder then frees it.
+  struct Stream {
+    float* ring;
+    Uint32 capacity;        // frames, a power of two
+    int channels;
+    volatile Uint32 head;   // frames written
+    volatile Uint32 tail;   // frames read
+    volatile Uint32 target; // frames the decoder keeps buffered; set by the mixer
+    volatile int eof;
+    volatile int released;
+  };
+
+  // Mixer telemetry, copied into a Float32Array by AUDIO.readTelemetry.
+  // Times are in milliseconds.
+  enum TelemetryField {
+    TELEMETRY_CALLBACKS = 0,    // audio callbacks since the device opened
+    TELEMETRY_UNDERRUNS,        // callbacks that came over a buffer late
+    TELEMETRY_STARVED,          // callbacks where a stream ran dry
+    TELEMETRY_PERIOD,           // average time between callbacks
+    TELEMETRY_JITTER,           // recent peak callback timing error
+    TELEMETRY_MIX_TIME,         // average time spent mixing a callback
+    TELEMETRY_MIX_PEAK,         // recent peak time spent mixing
+    TELEMETRY_LOAD,             // average mixing time over buffer duration
+    TELEMETRY_LATENCY,          // as AUDIO.latency()
+    TELEMETRY_STREAM_FILL,      // lowest stream ring fill in the last callback, 0..1
+    TELEMETRY_STREAM_TARGET,    // decoded audio streams are kept ahead by
+    TELEMETRY_SAMPLES,          // device buffer size in frames
+    TELEMETRY_SUGGESTED_SAMPLES,  // buffer size the observed timing calls for
+    TELEMETRY_SIZE
+  };
+
+  namespace AUDIO {
+    Handle<Value> Open(const Arguments& args);
+    Handle<Value> Close(const Arguments& args);
+    Handle<Value> LoadWAV(const Arguments& args);
+    Handle<Value> CreateSound(const Arguments& args);
+    Handle<Value> FreeSound(const Arguments& args);
+    Handle<Value> LoadOgg(const Arguments& args);
+    Handle<Value> Play(const Arguments& args);
+    Handle<Value> StreamOgg(const Arguments& args);
+    Handle<Value> Stop(const Arguments& args);
+    Handle<Value> SetVoiceGain(const Arguments& args);
+    Handle<Value> SetBusGain(const Arguments& args);
+    Handle<Value> AddEffect(const Arguments& args);
+    Handle<Value> SetEffect(const Arguments& args);
+    Handle<Value> RemoveEffect(const Arguments& args);
+    Handle<Value> Now(const Arguments& args);
+    Handle<Value> Latency(const Arguments& args);
+    Handle<Value> ReadTelemetry(const Arguments& args);
+    Handle<Value> SetAutoTune(const Arguments& args);
+  }
+
+  void ExportAudio(Handle<Object> target);
+
+} // sdl
+
+#endif  // NODE_SDL_AUDIO_H_
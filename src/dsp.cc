@@ -0,0 +1,335 @@
+#include <SDL.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "dsp.h"
+
+namespace sdl {
+
+static const char* effect_params_[EFFECT_TYPES][MAX_EFFECT_PARAMS] = {
+  { "frequency", "q" },
+  { "frequency", "q" },
+  { "room", "damping", "wet" },
+  { "threshold", "ratio", "attack", "release", "makeup" },
+  { "threshold", "release" }
+};
+
+static const float effect_defaults_[EFFECT_TYPES][MAX_EFFECT_PARAMS] = {
+  { 1000.0f, 0.7071f },
+  { 200.0f, 0.7071f },
+  { 0.5f, 0.5f, 0.25f },
+  { -12.0f, 4.0f, 5.0f, 100.0f, 0.0f },
+  { -1.0f, 50.0f }
+};
+
+// Freeverb's tunings at 44.1kHz; odd channels get slightly longer lines.
+static const int COMBS = 4;
+static const int ALLPASSES = 2;
+static const int comb_tuning_[COMBS] = { 1116, 1188, 1277, 1356 };
+static const int allpass_tuning_[ALLPASSES] = { 556, 441 };
+static const int STEREO_SPREAD = 23;
+
+struct DelayLine {
+  float* buffer;
+  int length;
+  int pos;
+  float store;    // comb low pass state
+};
+
+struct Effect {
+  int type;
+  int rate;
+  int channels;
+  float params[MAX_EFFECT_PARAMS];
+
+  // Biquad filters, direct form I, state per channel.
+  float b0, b1, b2, a1, a2;
+  float x1[MAX_AUDIO_CHANNELS], x2[MAX_AUDIO_CHANNELS];
+  float y1[MAX_AUDIO_CHANNELS], y2[MAX_AUDIO_CHANNELS];
+
+  // Reverb.
+  DelayLine comb[MAX_AUDIO_CHANNELS][COMBS];
+  DelayLine allpass[MAX_AUDIO_CHANNELS][ALLPASSES];
+  float feedback, damp, wet;
+  float* memory;
+
+  // Compressor and limiter.
+  float threshold;  // linear
+  float slope;      // 1 / ratio - 1
+  float attack;     // envelope coefficients per frame
+  float release;
+  float makeup;     // linear
+  float envelope;
+};
+
+int EffectParamIndex(int type, const char* name) {
+  if (type < 0 || type >= EFFECT_TYPES) return -1;
+  for (int i = 0; i < MAX_EFFECT_PARAMS; i++) {
+    if (effect_params_[type][i] && !strcmp(effect_params_[type][i], name)) return i;
+  }
+  return -1;
+}
+
+static float DecibelsToGain(float db) {
+  return powf(10.0f, db / 20.0f);
+}
+
+static float TimeConstant(float ms, int rate) {
+  return ms > 0 ? expf(-1.0f / (ms * 0.001f * rate)) : 0.0f;
+}
+
+// Recomputes the derived coefficients from params.
+static void UpdateEffect(Effect* e) {
+  const float* p = e->params;
+  switch (e->type) {
+    case EFFECT_LOWPASS:
+    case EFFECT_HIGHPASS: {
+      float frequency = p[0] < 10.0f ? 10.0f : p[0] > e->rate * 0.49f ? e->rate * 0.49f : p[0];
+      float q = p[1] < 0.1f ? 0.1f : p[1];
+      float w0 = 2.0f * (float)M_PI * frequency / e->rate;
+      float cosw = cosf(w0), alpha = sinf(w0) / (2.0f * q);
+      float a0 = 1.0f + alpha;
+      if (e->type == EFFECT_LOWPASS) {
+        e->b0 = (1.0f - cosw) / 2.0f / a0;
+        e->b1 = (1.0f - cosw) / a0;
+      } else {
+        e->b0 = (1.0f + cosw) / 2.0f / a0;
+        e->b1 = -(1.0f + cosw) / a0;
+      }
+      e->b2 = e->b0;
+      e->a1 = -2.0f * cosw / a0;
+      e->a2 = (1.0f - alpha) / a0;
+      break;
+    }
+    case EFFECT_REVERB:
+      e->feedback = 0.7f + 0.28f * (p[0] < 0 ? 0 : p[0] > 1 ? 1 : p[0]);
+      e->damp = 0.4f * (p[1] < 0 ? 0 : p[1] > 1 ? 1 : p[1]);
+      e->wet = p[2] < 0 ? 0 : p[2] > 1 ? 1 : p[2];
+      break;
+    case EFFECT_COMPRESSOR:
+      e->threshold = DecibelsToGain(p[0]);
+      e->slope = p[1] >= 1.0f ? 1.0f / p[1] - 1.0f : 0.0f;
+      e->attack = TimeConstant(p[2], e->rate);
+      e->release = TimeConstant(p[3], e->rate);
+      e->makeup = DecibelsToGain(p[4]);
+      break;
+    case EFFECT_LIMITER:
+      e->threshold = DecibelsToGain(p[0]);
+      e->slope = -1.0f;
+      e->attack = 0.0f;
+      e->release = TimeConstant(p[1], e->rate);
+      e->makeup = 1.0f;
+      break;
+  }
+}
+
+Effect* CreateEffect(int type, int rate, int channels) {
+  if (type < 0 || type >= EFFECT_TYPES || channels < 1 || channels > MAX_AUDIO_CHANNELS) return NULL;
+  Effect* e = (Effect*)calloc(1, sizeof(Effect));
+  if (!e) return NULL;
+  e->type = type;
+  e->rate = rate;
+  e->channels = channels;
+  memcpy(e->params, effect_defaults_[type], sizeof(e->params));
+
+  if (type == EFFECT_REVERB) {
+    // One block for every delay line of every channel.
+    size_t total = 0;
+    int lengths[MAX_AUDIO_CHANNELS][COMBS + ALLPASSES];
+    for (int c = 0; c < channels; c++) {
+      int spread = (c & 1) ? STEREO_SPREAD : 0;
+      for (int i = 0; i < COMBS + ALLPASSES; i++) {
+        int tuning = i < COMBS ? comb_tuning_[i] : allpass_tuning_[i - COMBS];
+        lengths[c][i] = (int)((Sint64)(tuning + spread) * rate / 44100);
+        if (lengths[c][i] < 1) lengths[c][i] = 1;
+        total += lengths[c][i];
+      }
+    }
+    e->memory = (float*)calloc(total, sizeof(float));
+    if (!e->memory) {
+      free(e);
+      return NULL;
+    }
+    float* next = e->memory;
+    for (int c = 0; c < channels; c++) {
+      for (int i = 0; i < COMBS + ALLPASSES; i++) {
+        DelayLine* line = i < COMBS ? &e->comb[c][i] : &e->allpass[c][i - COMBS];
+        line->buffer = next;
+        line->length = lengths[c][i];
+        next += lengths[c][i];
+      }
+    }
+  }
+
+  UpdateEffect(e);
+  return e;
+}
+
+void DestroyEffect(Effect* effect) {
+  if (!effect) return;
+  free(effect->memory);
+  free(effect);
+}
+
+void SetEffectParam(Effect* effect, int index, float value) {
+  if (index < 0 || index >= MAX_EFFECT_PARAMS || !effect_params_[effect->type][index]) return;
+  effect->params[index] = value;
+  UpdateEffect(effect);
+}
+
+static void ProcessBiquad(Effect* e, float* samples, int frames) {
+  const int channels = e->channels;
+#ifdef __SSE2__
+  if (channels <= 4) {
+    // All channels of a frame go through the filter as one vector.
+    const __m128 b0 = _mm_set1_ps(e->b0), b1 = _mm_set1_ps(e->b1), b2 = _mm_set1_ps(e->b2);
+    const __m128 a1 = _mm_set1_ps(e->a1), a2 = _mm_set1_ps(e->a2);
+    __m128 x1 = _mm_loadu_ps(e->x1), x2 = _mm_loadu_ps(e->x2);
+    __m128 y1 = _mm_loadu_ps(e->y1), y2 = _mm_loadu_ps(e->y2);
+    float frame[4] = { 0, 0, 0, 0 };
+    for (int f = 0; f < frames; f++, samples += channels) {
+      memcpy(frame, samples, channels * sizeof(float));
+      __m128 x = _mm_loadu_ps(frame);
+      __m128 y = _mm_add_ps(_mm_mul_ps(b0, x), _mm_add_ps(_mm_mul_ps(b1, x1), _mm_mul_ps(b2, x2)));
+      y = _mm_sub_ps(y, _mm_add_ps(_mm_mul_ps(a1, y1), _mm_mul_ps(a2, y2)));
+      x2 = x1;
+      x1 = x;
+      y2 = y1;
+      y1 = y;
+      _mm_storeu_ps(frame, y);
+      memcpy(samples, frame, channels * sizeof(float));
+    }
+    _mm_storeu_ps(e->x1, x1);
+    _mm_storeu_ps(e->x2, x2);
+    _mm_storeu_ps(e->y1, y1);
+    _mm_storeu_ps(e->y2, y2);
+    return;
+  }
+#endif
+  for (int f = 0; f < frames; f++, samples += channels) {
+    for (int c = 0; c < channels; c++) {
+      float x = samples[c];
+      float y = e->b0 * x + e->b1 * e->x1[c] + e->b2 * e->x2[c] - e->a1 * e->y1[c] - e->a2 * e->y2[c];
+      e->x2[c] = e->x1[c];
+      e->x1[c] = x;
+      e->y2[c] = e->y1[c];
+      e->y1[c] = y;
+      samples[c] = y;
+    }
+  }
+}
+
+static void ProcessReverb(Effect* e, float* samples, int frames) {
+  const int channels = e->channels;
+  const float dry = 1.0f - e->wet, wet = e->wet * 3.0f;
+  for (int f = 0; f < frames; f++, samples += channels) {
+    for (int c = 0; c < channels; c++) {
+      float in = samples[c] * 0.015f, out = 0;
+      for (int i = 0; i < COMBS; i++) {
+        DelayLine* d = &e->comb[c][i];
+        float y = d->buffer[d->pos];
+        d->store = y * (1.0f - e->damp) + d->store * e->damp;
+        d->buffer[d->pos] = in + d->store * e->feedback;
+        if (++d->pos >= d->length) d->pos = 0;
+        out += y;
+      }
+      for (int i = 0; i < ALLPASSES; i++) {
+        DelayLine* d = &e->allpass[c][i];
+        float delayed = d->buffer[d->pos];
+        d->buffer[d->pos] = out + delayed * 0.5f;
+        if (++d->pos >= d->length) d->pos = 0;
+        out = delayed - out;
+      }
+      samples[c] = samples[c] * dry + out * wet;
+    }
+  }
+}
+
+// Peak detecting compressor; the limiter is the same with an infinite ratio
+// and instant attack, so its output never exceeds the threshold.
+static void ProcessDynamics(Effect* e, float* samples, int frames) {
+  const int channels = e->channels;
+  float envelope = e->envelope;
+  for (int f = 0; f < frames; f++, samples += channels) {
+    float peak = 0;
+    for (int c = 0; c < channels; c++) {
+      float a = fabsf(samples[c]);
+      if (a > peak) peak = a;
+    }
+    envelope = peak + (peak > envelope ? e->attack : e->release) * (envelope - peak);
+
+    float gain = e->makeup;
+    if (envelope > e->threshold) {
+      gain *= e->slope == -1.0f ? e->threshold / envelope : powf(envelope / e->threshold, e->slope);
+    }
+    for (int c = 0; c < channels; c++) samples[c] *= gain;
+  }
+  // Keep denormals out of the envelope during silence.
+  e->envelope = envelope < 1e-9f ? 0 : envelope;
+}
+
+void ProcessEffect(Effect* effect, float* samples, int frames) {
+  switch (effect->type) {
+    case EFFECT_LOWPASS:
+    case EFFECT_HIGHPASS:
+      ProcessBiquad(effect, samples, frames);
+      break;
+    case EFFECT_REVERB:
+      ProcessReverb(effect, samples, frames);
+      break;
+    case EFFECT_COMPRESSOR:
+    case EFFECT_LIMITER:
+      ProcessDynamics(effect, samples, frames);
+      break;
+  }
+}
+
+void MixSamples(float* out, const float* in, int count, float gain) {
+  int i = 0;
+#ifdef __SSE2__
+  const __m128 g = _mm_set1_ps(gain);
+  for (; i + 4 <= count; i += 4) {
+    _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), g)));
+  }
+#endif
+  for (; i < count; i++) out[i] += in[i] * gain;
+}
+
+void ScaleSamples(float* samples, int count, float gain) {
+  int i = 0;
+#ifdef __SSE2__
+  const __m128 g = _mm_set1_ps(gain);
+  for (; i + 4 <= count; i += 4) {
+    _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), g));
+  }
+#endif
+  for (; i < count; i++) samples[i] *= gain;
+}
+
+void FloatToS16(const float* in, Sint16* out, int count) {
+  int i = 0;
+#ifdef __SSE2__
+  const __m128 scale = _mm_set1_ps(32767.0f), lo = _mm_set1_ps(-1.0f), hi = _mm_set1_ps(1.0f);
+  for (; i + 8 <= count; i += 8) {
+    __m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i), lo), hi);
+    __m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i + 4), lo), hi);
+    __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(a, scale)), _mm_cvtps_epi32(_mm_mul_ps(b, scale)));
+    _mm_storeu_si128((__m128i*)(out + i), packed);
+  }
+#endif
+  for (; i < count; i++) {
+    float v = in[i] < -1.0f ? -1.0f : in[i] > 1.0f ? 1.0f : in[i];
+    out[i] = (Sint16)lrintf(v * 32767.0f);
+  }
+}
+
+void S16ToFloat(const Sint16* in, float* out, int count) {
+  for (int i = 0; i < count; i++) out[i] = in[i] * (1.0f / 32768.0f);
+}
+
+} // sdl
@@ -0,0 +1,53 @@
+#ifndef NODE_SDL_DSP_H_
+#define NODE_SDL_DSP_H_
+
+#include <SDL.h>
+
+namespace sdl {
+
+  // Effects run on the audio thread over interleaved float frames.  They are
+  // created and destroyed on the JS thread (that's where memory is allocated)
+  // and only processed and retuned on the audio thread.
+  enum EffectType {
+    EFFECT_LOWPASS = 0,     // params: frequency (Hz), q
+    EFFECT_HIGHPASS = 1,    // params: frequency (Hz), q
+    EFFECT_REVERB = 2,      // params: room (0..1), damping (0..1), wet (0..1)
+    EFFECT_COMPRESSOR = 3,  // params: threshold (dB), ratio, attack (ms), release (ms), makeup (dB)
+    EFFECT_LIMITER = 4,     // params: threshold (dB), release (ms)
+    EFFECT_TYPES = 5
+  };
+
+  const int MAX_EFFECT_PARAMS = 5;
+  const int MAX_AUDIO_CHANNELS = 8;
+
+  struct Effect;
+
+  // Parameter index of a named parameter for an effect type, or -1.
+  int EffectParamIndex(int type, const char* name);
+
+  // Allocates an effect with default parameters for the given output format.
+  // Returns NULL when out of memory.
+  Effect* CreateEffect(int type, int rate, int channels);
+  void DestroyEffect(Effect* effect);
+
+  // Changes one parameter; safe to call on the audio thread.
+  void SetEffectParam(Effect* effect, int index, float value);
+
+  // Processes frames of interleaved samples in place.
+  void ProcessEffect(Effect* effect, float* samples, int frames);
+
+  // out[i] += in[i] * gain over count samples.
+  void MixSamples(float* out, const float* in, int count, float gain);
+
+  // out[i] *= gain over count samples.
+  void ScaleSamples(float* samples, int count, float gain);
+
+  // Converts to signed 16 bit with saturation.
+  void FloatToS16(const float* in, Sint16* out, int count);
+
+  // Converts signed 16 bit samples to floats in [-1, 1).
+  void S16ToFloat(const Sint16* in, float* out, int count);
+
+} // sdl
+
+#endif  // NODE_SDL_DSP_H_
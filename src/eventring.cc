@@ -0,0 +1,210 @@
+#include <v8.h>
+#include <node.h>
+#include <node_buffer.h>
+#include <SDL.h>
+#include <string.h>
+
+#include "helpers.h"
+#include "eventring.h"
+#include "probes.h"
+
+namespace sdl {
+
+static inline Uint32* RingWord(char* ring, int offset) {
+  return reinterpret_cast<Uint32*>(ring + offset);
+}
+
+static inline Uint32 LoadAcquire(volatile Uint32* word) {
+  Uint32 value = *word;
+  __sync_synchronize();
+  return value;
+}
+
+static inline void StoreRelease(volatile Uint32* word, Uint32 value) {
+  __sync_synchronize();
+  *word = value;
+}
+
+// Validates the header of a ring created by InitEventRing.  Returns NULL and
+// leaves the exception in `error` when the buffer isn't a usable ring.
+static char* UnwrapEventRing(Handle<Value> value, Handle<Value>* error) {
+  if (!Buffer::HasInstance(value)) {
+    *error = ThrowException(Exception::TypeError(String::New("Event ring must be a Buffer")));
+    return NULL;
+  }
+  Local<Object> buf = value->ToObject();
+  char* ring = BufferData(buf);
+  size_t length = BufferLength(buf);
+  if (length < (size_t)EVENTRING_HEADER_SIZE
+      || *RingWord(ring, 0) != EVENTRING_MAGIC
+      || *RingWord(ring, 4) != EVENTRING_VERSION
+      || length < EVENTRING_HEADER_SIZE + (size_t)*RingWord(ring, EVENTRING_CAPACITY_OFFSET) * EVENTRING_RECORD_SIZE) {
+    *error = ThrowException(Exception::Error(String::New("Buffer is not an initialized event ring")));
+    return NULL;
+  }
+  return ring;
+}
+
+static void EncodeEvent(const SDL_Event& event, Sint32* record) {
+  memset(record, 0, EVENTRING_RECORD_SIZE);
+  record[0] = event.type;
+  record[1] = SDL_GetTicks();
+  Sint32* f = record + 2;
+
+  switch (event.type) {
+    case SDL_ACTIVEEVENT:
+      f[0] = event.active.gain;
+      f[1] = event.active.state;
+      break;
+    case SDL_KEYDOWN:
+    case SDL_KEYUP:
+      f[0] = event.key.keysym.scancode;
+      f[1] = event.key.keysym.sym;
+      f[2] = event.key.keysym.mod;
+      f[3] = event.key.keysym.unicode;
+      break;
+    case SDL_MOUSEMOTION:
+      f[0] = event.motion.which;
+      f[1] = event.motion.state;
+      f[2] = event.motion.x;
+      f[3] = event.motion.y;
+      f[4] = event.motion.xrel;
+      f[5] = event.motion.yrel;
+      break;
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP:
+      f[0] = event.button.which;
+      f[1] = event.button.button;
+      f[2] = event.button.x;
+      f[3] = event.button.y;
+      break;
+    case SDL_JOYAXISMOTION:
+      f[0] = event.jaxis.which;
+      f[1] = event.jaxis.axis;
+      f[2] = event.jaxis.value;
+      break;
+    case SDL_JOYBALLMOTION:
+      f[0] = event.jball.which;
+      f[1] = event.jball.ball;
+      f[2] = event.jball.xrel;
+      f[3] = event.jball.yrel;
+      break;
+    case SDL_JOYHATMOTION:
+      f[0] = event.jhat.which;
+      f[1] = event.jhat.hat;
+      f[2] = event.jhat.value;
+      break;
+    case SDL_JOYBUTTONDOWN:
+    case SDL_JOYBUTTONUP:
+      f[0] = event.jbutton.which;
+      f[1] = event.jbutton.button;
+      break;
+    case SDL_USEREVENT:
+      f[0] = event.user.code;
+      break;
+  }
+}
+
+Handle<Value> InitEventRing(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 2 && Buffer::HasInstance(args[0]) && args[1]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected InitEventRing(Buffer, Number)")));
+  }
+
+  Local<Object> buf = args[0]->ToObject();
+  Uint32 capacity = args[1]->Uint32Value();
+  if (capacity == 0 || (capacity & (capacity - 1))) {
+    return ThrowException(Exception::RangeError(String::New("Event ring capacity must be a power of two")));
+  }
+  if (BufferLength(buf) < EVENTRING_HEADER_SIZE + (size_t)capacity * EVENTRING_RECORD_SIZE) {
+    return ThrowException(Exception::RangeError(String::New("Buffer too small for event ring")));
+  }
+
+  char* ring = BufferData(buf);
+  memset(ring, 0, EVENTRING_HEADER_SIZE);
+  *RingWord(ring, 4) = EVENTRING_VERSION;
+  *RingWord(ring, EVENTRING_CAPACITY_OFFSET) = capacity;
+  *RingWord(ring, 12) = EVENTRING_RECORD_SIZE;
+  // Publish the magic last so a reader never sees a half written header.
+  StoreRelease(RingWord(ring, 0), EVENTRING_MAGIC);
+
+  return Undefined();
+}
+
+// Drains SDL's queue into the ring without creating any JS objects.  Returns
+// the number of events written; events that don't fit bump the dropped count.
+Handle<Value> PumpEventRing(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 1 && args[0]->IsObject())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected PumpEventRing(Buffer)")));
+  }
+
+  Handle<Value> error;
+  char* ring = UnwrapEventRing(args[0], &error);
+  if (!ring) return error;
+
+  Uint32 capacity = *RingWord(ring, EVENTRING_CAPACITY_OFFSET);
+  Uint32 head = *RingWord(ring, EVENTRING_HEAD_OFFSET);
+  Uint32 tail = LoadAcquire(RingWord(ring, EVENTRING_TAIL_OFFSET));
+  Uint32 written = 0;
+
+  PROBE0(pump__start);
+  PROBE_TIMER(timer, pump__done);
+  SDL_Event event;
+  while (SDL_PollEvent(&event)) {
+    if (head - tail >= capacity) {
+      // Re-check in case the consumer caught up since the last load.
+      tail = LoadAcquire(RingWord(ring, EVENTRING_TAIL_OFFSET));
+      if (head - tail >= capacity) {
+        __sync_fetch_and_add(RingWord(ring, EVENTRING_DROPPED_OFFSET), 1);
+        continue;
+      }
+    }
+    Sint32* record = reinterpret_cast<Sint32*>(
+      ring + EVENTRING_HEADER_SIZE + (head & (capacity - 1)) * EVENTRING_RECORD_SIZE);
+    EncodeEvent(event, record);
+    head++;
+    written++;
+    // Publish per record so consumers can start before the pump finishes.
+    StoreRelease(RingWord(ring, EVENTRING_HEAD_OFFSET), head);
+  }
+
+  PROBE_DONE1(pump__done, timer, written);
+  return Number::New(written);
+}
+
+void ExportEventRing(Handle<Object> target) {
+  HandleScope scope;
+
+  NODE_SET_METHOD(target, "initEventRing", InitEventRing);
+  NODE_SET_METHOD(target, "pumpEventRing", PumpEventRing);
+
+  Local<Object> EVENTRING = Object::New();
+  target->Set(String::New("EVENTRING"), EVENTRING);
+  EVENTRING->Set(String::New("HEADER_SIZE"), Number::New(EVENTRING_HEADER_SIZE));
+  EVENTRING->Set(String::New("RECORD_SIZE"), Number::New(EVENTRING_RECORD_SIZE));
+  EVENTRING->Set(String::New("CAPACITY_OFFSET"), Number::New(EVENTRING_CAPACITY_OFFSET));
+  EVENTRING->Set(String::New("DROPPED_OFFSET"), Number::New(EVENTRING_DROPPED_OFFSET));
+  EVENTRING->Set(String::New("HEAD_OFFSET"), Number::New(EVENTRING_HEAD_OFFSET));
+  EVENTRING->Set(String::New("TAIL_OFFSET"), Number::New(EVENTRING_TAIL_OFFSET));
+
+  Local<Object> EVENT = Object::New();
+  target->Set(String::New("EVENT"), EVENT);
+  EVENT->Set(String::New("ACTIVEEVENT"), Number::New(SDL_ACTIVEEVENT));
+  EVENT->Set(String::New("KEYDOWN"), Number::New(SDL_KEYDOWN));
+  EVENT->Set(String::New("KEYUP"), Number::New(SDL_KEYUP));
+  EVENT->Set(String::New("MOUSEMOTION"), Number::New(SDL_MOUSEMOTION));
+  EVENT->Set(String::New("MOUSEBUTTONDOWN"), Number::New(SDL_MOUSEBUTTONDOWN));
+  EVENT->Set(String::New("MOUSEBUTTONUP"), Number::New(SDL_MOUSEBUTTONUP));
+  EVENT->Set(String::New("JOYAXISMOTION"), Number::New(SDL_JOYAXISMOTION));
+  EVENT->Set(String::New("JOYBALLMOTION"), Number::New(SDL_JOYBALLMOTION));
+  EVENT->Set(String::New("JOYHATMOTION"), Number::New(SDL_JOYHATMOTION));
+  EVENT->Set(String::New("JOYBUTTONDOWN"), Number::New(SDL_JOYBUTTONDOWN));
+  EVENT->Set(String::New("JOYBUTTONUP"), Number::New(SDL_JOYBUTTONUP));
+  EVENT->Set(String::New("QUIT"), Number::New(SDL_QUIT));
+  EVENT->Set(String::New("USEREVENT"), Number::New(SDL_USEREVENT));
+}
+
+} // sdl
@@ -0,0 +1,63 @@
+#ifndef NODE_SDL_EVENTRING_H_
+#define NODE_SDL_EVENTRING_H_
+
+#include <v8.h>
+#include <node.h>
+#include <SDL.h>
+
+using namespace v8;
+
+// Single producer / single consumer ring of input events laid out in a plain
+// Buffer, so the bytes can live in memory shared with other threads (a Buffer
+// over a SharedArrayBuffer on runtimes that have one).
+//
+// All fields are little endian 32 bit integers.
+//
+//   offset   0  magic        'SDLR' (0x524c4453)
+//   offset   4  version      1
+//   offset   8  capacity     number of records, a power of two
+//   offset  12  record size  32
+//   offset  16  dropped      events discarded because the ring was full
+//   offset  64  head         records ever written, stored by the producer
+//   offset 128  tail         records ever read, stored by the consumer
+//   offset 192  records      capacity * 32 bytes
+//
+// head and tail sit on their own cache lines and only ever grow; record i
+// lives in slot (i & (capacity - 1)).  The producer fills the slot before it
+// publishes the new head, so a consumer that loads head may read every record
+// below it.  Waiters block on the head word (Int32 index 16).
+//
+// Record layout:
+//
+//   offset 0  type       SDL event type (SDL.EVENT.*)
+//   offset 4  timestamp  SDL_GetTicks() when the event was pumped
+//   offset 8  six Int32 fields, depending on type:
+//     ACTIVEEVENT              gain, state
+//     KEYDOWN/KEYUP            scancode, sym, mod, unicode
+//     MOUSEMOTION              which, state, x, y, xrel, yrel
+//     MOUSEBUTTONDOWN/UP       which, button, x, y
+//     JOYAXISMOTION            which, axis, value
+//     JOYBALLMOTION            which, ball, xrel, yrel
+//     JOYHATMOTION             which, hat, value
+//     JOYBUTTONDOWN/UP         which, button
+//     USEREVENT                code
+
+namespace sdl {
+
+  const Uint32 EVENTRING_MAGIC = 0x524c4453;
+  const Uint32 EVENTRING_VERSION = 1;
+  const int EVENTRING_RECORD_SIZE = 32;
+  const int EVENTRING_CAPACITY_OFFSET = 8;
+  const int EVENTRING_DROPPED_OFFSET = 16;
+  const int EVENTRING_HEAD_OFFSET = 64;
+  const int EVENTRING_TAIL_OFFSET = 128;
+  const int EVENTRING_HEADER_SIZE = 192;
+
+  Handle<Value> InitEventRing(const Arguments& args);
+  Handle<Value> PumpEventRing(const Arguments& args);
+
+  void ExportEventRing(Handle<Object> target);
+
+} // sdl
+
+#endif  // NODE_SDL_EVENTRING_H_
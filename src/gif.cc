@@ -0,0 +1,309 @@
+#include <v8.h>
+#include <node.h>
+#include <node_buffer.h>
+#include <SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "helpers.h"
+#include "pixels.h"
+#include "quantize.h"
+#include "gif.h"
+
+namespace sdl {
+
+// Growable byte buffer for the encoded file.
+struct ByteWriter {
+  Uint8* data;
+  size_t length;
+  size_t capacity;
+  bool failed;
+};
+
+static void Put(ByteWriter* w, const void* bytes, size_t n) {
+  if (w->failed) return;
+  if (w->length + n > w->capacity) {
+    size_t capacity = w->capacity ? w->capacity * 2 : 4096;
+    while (capacity < w->length + n) capacity *= 2;
+    Uint8* data = (Uint8*)realloc(w->data, capacity);
+    if (!data) {
+      w->failed = true;
+      return;
+    }
+    w->data = data;
+    w->capacity = capacity;
+  }
+  memcpy(w->data + w->length, bytes, n);
+  w->length += n;
+}
+
+static void PutByte(ByteWriter* w, int b) {
+  Uint8 byte = b;
+  Put(w, &byte, 1);
+}
+
+static void PutShort(ByteWriter* w, int v) {
+  PutByte(w, v & 0xff);
+  PutByte(w, (v >> 8) & 0xff);
+}
+
+// LSB first bit packer that emits 255 byte data sub-blocks.
+struct CodeWriter {
+  ByteWriter* out;
+  Uint32 bits;
+  int nbits;
+  Uint8 block[255];
+  int blocklen;
+};
+
+static void FlushBlock(CodeWriter* cw) {
+  if (!cw->blocklen) return;
+  PutByte(cw->out, cw->blocklen);
+  Put(cw->out, cw->block, cw->blocklen);
+  cw->blocklen = 0;
+}
+
+static void WriteCode(CodeWriter* cw, int code, int size) {
+  cw->bits |= (Uint32)code << cw->nbits;
+  cw->nbits += size;
+  while (cw->nbits >= 8) {
+    cw->block[cw->blocklen++] = cw->bits & 0xff;
+    cw->bits >>= 8;
+    cw->nbits -= 8;
+    if (cw->blocklen == 255) FlushBlock(cw);
+  }
+}
+
+// LZW compresses one frame of palette indices.  `next` is a scratch trie of
+// 4096 * (1 << depth) entries.
+static void WriteImageData(ByteWriter* out, const Uint8* indices, size_t count, int depth, Uint16* next) {
+  const int min_code_size = depth;
+  const int clear = 1 << depth;
+  const size_t trie_size = (size_t)4096 << depth;
+
+  PutByte(out, min_code_size);
+
+  CodeWriter cw;
+  memset(&cw, 0, sizeof(cw));
+  cw.out = out;
+
+  memset(next, 0, trie_size * sizeof(Uint16));
+  int code_size = min_code_size + 1;
+  int max_code = clear + 1;
+  int cur = -1;
+
+  WriteCode(&cw, clear, code_size);
+  for (size_t i = 0; i < count; i++) {
+    int value = indices[i];
+    if (cur < 0) {
+      cur = value;
+    } else if (next[((size_t)cur << depth) + value]) {
+      cur = next[((size_t)cur << depth) + value];
+    } else {
+      WriteCode(&cw, cur, code_size);
+      next[((size_t)cur << depth) + value] = ++max_code;
+      if (max_code >= (1 << code_size)) code_size++;
+      if (max_code == 4095) {
+        WriteCode(&cw, clear, code_size);
+        memset(next, 0, trie_size * sizeof(Uint16));
+        code_size = min_code_size + 1;
+        max_code = clear + 1;
+      }
+      cur = value;
+    }
+  }
+  if (cur >= 0) WriteCode(&cw, cur, code_size);
+  WriteCode(&cw, clear, code_size);
+  WriteCode(&cw, clear + 1, min_code_size + 1);
+  if (cw.nbits) WriteCode(&cw, 0, 8 - cw.nbits);
+  FlushBlock(&cw);
+  PutByte(out, 0);
+}
+
+typedef struct {
+  Persistent<Function> fn;
+  Uint8** frames;     // RGBA8888 snapshots, owned
+  int nframes;
+  int width;
+  int height;
+  int delay;          // hundredths of a second
+  int loop;           // -1 for no looping extension
+  int colors;
+  bool dither;
+  ByteWriter out;
+  const char* error;
+} gif_closure_t;
+
+static void EncodeFrames(gif_closure_t* closure) {
+  int width = closure->width, height = closure->height;
+  size_t count = (size_t)width * height;
+  ByteWriter* out = &closure->out;
+
+  int depth = 1;
+  while ((1 << depth) < closure->colors) depth++;
+  if (depth < 2) depth = 2;
+
+  Uint8* indices = (Uint8*)malloc(count + 1);
+  Uint16* trie = (Uint16*)malloc(((size_t)4096 << depth) * sizeof(Uint16));
+  if (!indices || !trie) {
+    free(indices);
+    free(trie);
+    closure->error = "Out of memory";
+    return;
+  }
+
+  Put(out, "GIF89a", 6);
+  PutShort(out, width);
+  PutShort(out, height);
+  PutByte(out, 0);  // no global color table
+  PutByte(out, 0);
+  PutByte(out, 0);
+
+  if (closure->loop >= 0) {
+    Put(out, "\x21\xff\x0bNETSCAPE2.0\x03\x01", 16);
+    PutShort(out, closure->loop);
+    PutByte(out, 0);
+  }
+
+  for (int f = 0; f < closure->nframes; f++) {
+    Palette palette;
+    if (!QuantizeRGBA(closure->frames[f], width, height, closure->colors, closure->dither, indices, &palette)) {
+      closure->error = "Out of memory";
+      break;
+    }
+
+    // Graphic control: frames with holes are cleared before the next frame.
+    bool transparent = palette.transparent >= 0;
+    Put(out, "\x21\xf9\x04", 3);
+    PutByte(out, (transparent ? 2 << 2 : 1 << 2) | (transparent ? 1 : 0));
+    PutShort(out, closure->delay);
+    PutByte(out, transparent ? palette.transparent : 0);
+    PutByte(out, 0);
+
+    PutByte(out, 0x2c);
+    PutShort(out, 0);
+    PutShort(out, 0);
+    PutShort(out, width);
+    PutShort(out, height);
+    PutByte(out, 0x80 | (depth - 1));  // local color table of 2^depth entries
+    for (int i = 0; i < (1 << depth); i++) {
+      if (i < palette.count) {
+        PutByte(out, palette.colors[i].r);
+        PutByte(out, palette.colors[i].g);
+        PutByte(out, palette.colors[i].b);
+      } else {
+        Put(out, "\0\0\0", 3);
+      }
+    }
+
+    WriteImageData(out, indices, count, depth, trie);
+  }
+  PutByte(out, 0x3b);
+
+  free(indices);
+  free(trie);
+  if (out->failed && !closure->error) closure->error = "Out of memory";
+}
+
+static void EIO_EncodeGIF(eio_req *req) {
+  EncodeFrames((gif_closure_t *) req->data);
+}
+
+static int EIO_OnGIF(eio_req *req) {
+  HandleScope scope;
+
+  gif_closure_t *closure = (gif_closure_t *) req->data;
+  ev_unref(EV_DEFAULT_UC);
+
+  Handle<Value> argv[2];
+  if (closure->error) {
+    argv[0] = Exception::Error(String::Concat(String::New("GIF::Encode: "), String::New(closure->error)));
+    argv[1] = Undefined();
+  } else {
+    Buffer* buf = Buffer::New((char*)closure->out.data, closure->out.length);
+    argv[0] = Undefined();
+    argv[1] = buf->handle_;
+  }
+
+  closure->fn->Call(Context::GetCurrent()->Global(), 2, argv);
+
+  for (int i = 0; i < closure->nframes; i++) free(closure->frames[i]);
+  free(closure->frames);
+  free(closure->out.data);
+  closure->fn.Dispose();
+  delete closure;
+  return 0;
+}
+
+// Encodes an array of equally sized surfaces as an animated GIF on the thread
+// pool.  The surfaces are copied up front, so they may be reused or freed as
+// soon as this returns.  Calls back with (err, Buffer).
+Handle<Value> GIF::Encode(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 3 && args[0]->IsArray() && args[1]->IsObject() && args[2]->IsFunction())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected GIF::Encode(Array, Object, Function)")));
+  }
+
+  Handle<Array> surfaces = Handle<Array>::Cast(args[0]);
+  Handle<Object> options = args[1]->ToObject();
+  int nframes = surfaces->Length();
+  if (nframes == 0) {
+    return ThrowException(Exception::RangeError(String::New("GIF::Encode: No frames")));
+  }
+
+  gif_closure_t *closure = new gif_closure_t();
+  closure->frames = (Uint8**)calloc(nframes, sizeof(Uint8*));
+  closure->nframes = 0;
+
+  Local<Value> delay = options->Get(String::New("delay"));
+  Local<Value> loop = options->Get(String::New("loop"));
+  Local<Value> colors = options->Get(String::New("colors"));
+  closure->delay = delay->IsNumber() ? (delay->Int32Value() + 5) / 10 : 10;
+  closure->loop = loop->IsNumber() ? loop->Int32Value() : (loop->IsFalse() ? -1 : 0);
+  closure->colors = colors->IsNumber() ? colors->Int32Value() : 256;
+  if (closure->colors < 2) closure->colors = 2;
+  if (closure->colors > 256) closure->colors = 256;
+  closure->dither = options->Get(String::New("dither"))->BooleanValue();
+
+  Handle<Value> error;
+  for (int i = 0; i < nframes && closure->frames; i++) {
+    SDL_Surface* surface = UnwrapSurface(surfaces->Get(i)->ToObject());
+    if (i == 0) {
+      closure->width = surface->w;
+      closure->height = surface->h;
+    } else if (surface->w != closure->width || surface->h != closure->height) {
+      error = ThrowException(Exception::RangeError(String::New("GIF::Encode: Frames differ in size")));
+      break;
+    }
+    closure->frames[i] = CopySurfaceRGBA(surface);
+    if (!closure->frames[i]) {
+      error = ThrowSDLException("GIF::Encode");
+      break;
+    }
+    closure->nframes++;
+  }
+
+  if (!closure->frames || closure->nframes != nframes) {
+    for (int i = 0; i < closure->nframes; i++) free(closure->frames[i]);
+    free(closure->frames);
+    delete closure;
+    if (error.IsEmpty()) return ThrowException(Exception::Error(String::New("GIF::Encode: Out of memory")));
+    return error;
+  }
+
+  closure->fn = Persistent<Function>::New(Handle<Function>::Cast(args[2]));
+  eio_custom(EIO_EncodeGIF, EIO_PRI_DEFAULT, EIO_OnGIF, closure);
+  ev_ref(EV_DEFAULT_UC);
+  return Undefined();
+}
+
+void ExportGIF(Handle<Object> target) {
+  HandleScope scope;
+
+  Local<Object> GIF = Object::New();
+  target->Set(String::New("GIF"), GIF);
+  NODE_SET_METHOD(GIF, "encode", sdl::GIF::Encode);
+}
+
+} // sdl
@@ -0,0 +1,19 @@
+#ifndef NODE_SDL_GIF_H_
+#define NODE_SDL_GIF_H_
+
+#include <v8.h>
+#include <node.h>
+
+using namespace v8;
+
+namespace sdl {
+
+  namespace GIF {
+    Handle<Value> Encode(const Arguments& args);
+  }
+
+  void ExportGIF(Handle<Object> target);
+
+} // sdl
+
+#endif  // NODE_SDL_GIF_H_
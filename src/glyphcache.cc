@@ -0,0 +1,282 @@
+#include <v8.h>
+#include <node.h>
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <map>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "helpers.h"
+#include "text.h"
+#include "glyphcache.h"
+
+namespace sdl {
+
+struct FontFile {
+  std::string path;
+  int ptsize;
+  bool hashed;
+  Uint64 hash;      // 0 if the file couldn't be read
+};
+
+static std::map<TTF_Font*, FontFile> font_files_;
+static std::string cache_dir_;
+
+static const Uint64 FNV64_OFFSET = 0xcbf29ce484222325ULL;
+static const Uint64 FNV64_PRIME = 0x100000001b3ULL;
+
+static Uint32 Fnv32(Uint32 hash, const Uint8* data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static Uint64 HashFile(const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (!file) return 0;
+  Uint64 hash = FNV64_OFFSET;
+  Uint8 buffer[65536];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      hash ^= buffer[i];
+      hash *= FNV64_PRIME;
+    }
+  }
+  fclose(file);
+  return hash ? hash : 1;
+}
+
+void RegisterFontFile(TTF_Font* font, const char* file, int ptsize) {
+  FontFile& entry = font_files_[font];
+  entry.path = file;
+  entry.ptsize = ptsize;
+  entry.hashed = false;
+  entry.hash = 0;
+}
+
+bool GlyphCacheEnabled() {
+  return !cache_dir_.empty();
+}
+
+// Cache file path for a registered font, hashing the font file on first use.
+// Returns false when caching is off or the font can't be identified.
+static bool CachePath(TTF_Font* font, std::string* path, Uint64* hash, int* ptsize) {
+  if (cache_dir_.empty()) return false;
+  std::map<TTF_Font*, FontFile>::iterator it = font_files_.find(font);
+  if (it == font_files_.end()) return false;
+  FontFile& entry = it->second;
+  if (!entry.hashed) {
+    entry.hash = HashFile(entry.path.c_str());
+    entry.hashed = true;
+  }
+  if (!entry.hash) return false;
+
+  char name[64];
+  sprintf(name, "/%08x%08x-%d-%d.glyphs", (unsigned)(entry.hash >> 32), (unsigned)entry.hash,
+    entry.ptsize, TTF_GetFontStyle(font));
+  *path = cache_dir_ + name;
+  *hash = entry.hash;
+  *ptsize = entry.ptsize;
+  return true;
+}
+
+// Maps a file read only for the life of the process.
+static const Uint8* MapFile(const char* path, size_t* length) {
+#ifdef _WIN32
+  FILE* file = fopen(path, "rb");
+  if (!file) return NULL;
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  Uint8* data = size > 0 ? (Uint8*)malloc(size) : NULL;
+  if (data && fread(data, 1, size, file) != (size_t)size) {
+    free(data);
+    data = NULL;
+  }
+  fclose(file);
+  *length = data ? size : 0;
+  return data;
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat st;
+  void* data = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (data == MAP_FAILED) return NULL;
+  *length = st.st_size;
+  return (const Uint8*)data;
+#endif
+}
+
+static void UnmapFile(const Uint8* data, size_t length) {
+#ifdef _WIN32
+  free((void*)data);
+#else
+  munmap((void*)data, length);
+#endif
+}
+
+// Checks everything a cache file claims before any glyph points into it.
+static bool ValidCache(const Uint8* data, size_t length, Uint64 hash, int ptsize, int style) {
+  if (length < sizeof(GlyphCacheHeader)) return false;
+  const GlyphCacheHeader* header = (const GlyphCacheHeader*)data;
+  if (header->magic != GLYPH_CACHE_MAGIC || header->version != GLYPH_CACHE_VERSION) return false;
+  if (header->hash_lo != (Uint32)hash || header->hash_hi != (Uint32)(hash >> 32)) return false;
+  if (header->ptsize != ptsize || header->style != style || header->count > 65536) return false;
+
+  size_t records = (size_t)header->count * sizeof(GlyphCacheRecord);
+  if (length != sizeof(GlyphCacheHeader) + records + header->data_length) return false;
+  const Uint8* body = data + sizeof(GlyphCacheHeader);
+  if (Fnv32(2166136261u, body, records + header->data_length) != header->checksum) return false;
+
+  const GlyphCacheRecord* record = (const GlyphCacheRecord*)body;
+  for (Uint32 i = 0; i < header->count; i++, record++) {
+    if ((Uint64)record->offset + (Uint64)record->w * record->h > header->data_length) return false;
+  }
+  return true;
+}
+
+void LoadGlyphCache(TTF_Font* font) {
+  std::string path;
+  Uint64 hash;
+  int ptsize;
+  if (!CachePath(font, &path, &hash, &ptsize)) return;
+
+  size_t length;
+  const Uint8* data = MapFile(path.c_str(), &length);
+  if (!data) return;
+  if (!ValidCache(data, length, hash, ptsize, TTF_GetFontStyle(font))) {
+    UnmapFile(data, length);
+    return;
+  }
+
+  const GlyphCacheHeader* header = (const GlyphCacheHeader*)data;
+  const GlyphCacheRecord* records = (const GlyphCacheRecord*)(data + sizeof(GlyphCacheHeader));
+  const Uint8* bitmaps = (const Uint8*)(records + header->count);
+  for (Uint32 i = 0; i < header->count; i++) {
+    Glyph* glyph = GlyphSlot(font, records[i].ch);
+    if (!glyph) break;
+    glyph->ox = records[i].ox;
+    glyph->advance = records[i].advance;
+    glyph->w = records[i].w;
+    glyph->h = records[i].h;
+    glyph->alpha = glyph->w && glyph->h ? (Uint8*)bitmaps + records[i].offset : NULL;
+    glyph->loaded = true;
+  }
+}
+
+// Writes the cached glyphs of one font, through a temporary file so readers
+// never see half a cache.
+static bool SaveFont(TTF_Font* font) {
+  std::string path;
+  Uint64 hash;
+  int ptsize;
+  if (!CachePath(font, &path, &hash, &ptsize)) return false;
+
+  std::vector<Uint16> chars;
+  CachedGlyphs(font, &chars);
+  if (chars.empty()) return false;
+
+  std::vector<GlyphCacheRecord> records(chars.size());
+  Uint32 data_length = 0;
+  for (size_t i = 0; i < chars.size(); i++) {
+    const Glyph* glyph = GlyphSlot(font, chars[i]);
+    GlyphCacheRecord& record = records[i];
+    memset(&record, 0, sizeof(record));
+    record.ch = chars[i];
+    record.ox = glyph->ox;
+    record.advance = glyph->advance;
+    record.w = glyph->alpha ? glyph->w : 0;
+    record.h = glyph->alpha ? glyph->h : 0;
+    record.offset = data_length;
+    data_length += record.w * record.h;
+  }
+
+  GlyphCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = GLYPH_CACHE_MAGIC;
+  header.version = GLYPH_CACHE_VERSION;
+  header.hash_lo = (Uint32)hash;
+  header.hash_hi = (Uint32)(hash >> 32);
+  header.ptsize = ptsize;
+  header.style = TTF_GetFontStyle(font);
+  header.count = records.size();
+  header.data_length = data_length;
+  header.checksum = Fnv32(2166136261u, (const Uint8*)&records[0], records.size() * sizeof(GlyphCacheRecord));
+  for (size_t i = 0; i < chars.size(); i++) {
+    const Glyph* glyph = GlyphSlot(font, chars[i]);
+    if (records[i].w) header.checksum = Fnv32(header.checksum, glyph->alpha, records[i].w * records[i].h);
+  }
+
+  std::string temp = path + ".tmp";
+  FILE* file = fopen(temp.c_str(), "wb");
+  if (!file) return false;
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+    && fwrite(&records[0], sizeof(GlyphCacheRecord), records.size(), file) == records.size();
+  for (size_t i = 0; ok && i < chars.size(); i++) {
+    const Glyph* glyph = GlyphSlot(font, chars[i]);
+    size_t n = records[i].w * records[i].h;
+    if (n) ok = fwrite(glyph->alpha, 1, n, file) == n;
+  }
+  ok = fclose(file) == 0 && ok;
+  if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+    remove(temp.c_str());
+    return false;
+  }
+  return true;
+}
+
+// Turns on the on disk glyph cache.  Call it before rendering any text: a
+// font's cache file is only read the first time one of its glyphs is needed.
+Handle<Value> TTF::SetGlyphCacheDir(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 1 && args[0]->IsString())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected TTF::SetGlyphCacheDir(String)")));
+  }
+
+  String::Utf8Value dir(args[0]);
+  cache_dir_ = *dir;
+  while (cache_dir_.size() > 1 && cache_dir_[cache_dir_.size() - 1] == '/') {
+    cache_dir_.erase(cache_dir_.size() - 1);
+  }
+
+  return Undefined();
+}
+
+// Writes a cache file for every font with rendered glyphs.  Returns the
+// number of files written.
+Handle<Value> TTF::SaveGlyphCache(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 0)) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected TTF::SaveGlyphCache()")));
+  }
+  if (cache_dir_.empty()) {
+    return ThrowException(Exception::Error(String::New("TTF::SaveGlyphCache: No cache directory set")));
+  }
+
+  int written = 0;
+  for (std::map<TTF_Font*, FontFile>::iterator it = font_files_.begin(); it != font_files_.end(); ++it) {
+    if (SaveFont(it->first)) written++;
+  }
+
+  return scope.Close(Number::New(written));
+}
+
+} // sdl
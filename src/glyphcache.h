@@ -0,0 +1,66 @@
+#ifndef NODE_SDL_GLYPHCACHE_H_
+#define NODE_SDL_GLYPHCACHE_H_
+
+#include <v8.h>
+#include <node.h>
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+using namespace v8;
+
+namespace sdl {
+
+  // On disk glyph caches hold the rendered glyphs of one font at one size and
+  // style, so later runs can skip FreeType.  A cache file is
+  //
+  //   header   64 bytes, see below
+  //   records  count * 16 bytes: Uint16 ch, Uint16 reserved, Sint16 ox,
+  //            Sint16 advance, Uint16 w, Uint16 h, Uint32 offset into data
+  //   data     the glyphs' coverage bitmaps, w * h bytes each
+  //
+  // in host byte order, named <font hash>-<ptsize>-<style>.glyphs.  Files are
+  // mapped read only and glyphs point straight into the mapping.
+  const Uint32 GLYPH_CACHE_MAGIC = 0x474c4453;  // "SDLG" read as little endian
+  const Uint32 GLYPH_CACHE_VERSION = 1;
+
+  struct GlyphCacheHeader {
+    Uint32 magic;
+    Uint32 version;
+    Uint32 hash_lo;       // 64 bit FNV-1a of the font file
+    Uint32 hash_hi;
+    Sint32 ptsize;
+    Sint32 style;
+    Uint32 count;         // number of records
+    Uint32 data_length;   // bytes of bitmap data
+    Uint32 checksum;      // FNV-1a of records and data
+    Uint32 reserved[7];
+  };
+
+  struct GlyphCacheRecord {
+    Uint16 ch;
+    Uint16 reserved;
+    Sint16 ox;
+    Sint16 advance;
+    Uint16 w;
+    Uint16 h;
+    Uint32 offset;
+  };
+
+  // Remembers where a font came from so its cache file can be found.
+  void RegisterFontFile(TTF_Font* font, const char* file, int ptsize);
+
+  // Fills the font's glyph slots from its cache file, if caching is on and a
+  // valid file exists.  Called by GlyphSlot the first time it sees a font.
+  void LoadGlyphCache(TTF_Font* font);
+
+  // Whether setGlyphCacheDir() has turned the on disk cache on.
+  bool GlyphCacheEnabled();
+
+  namespace TTF {
+    Handle<Value> SetGlyphCacheDir(const Arguments& args);
+    Handle<Value> SaveGlyphCache(const Arguments& args);
+  }
+
+} // sdl
+
+#endif  // NODE_SDL_GLYPHCACHE_H_
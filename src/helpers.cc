@@ -3,8 +3,17 @@
 #include <node_buffer.h>
 #include <SDL.h>
 #include <SDL_ttf.h>
+#include <SDL_image.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#ifndef _WIN32
+#include <time.h>
+#endif
 
 #include "helpers.h"
+#include "alloctrack.h"
+#include "probes.h"
 
 namespace sdl {
 
@@ -22,6 +31,15 @@ Local<Value> MakeSDLException(const char* name) {
 
 // Wrap/Unwrap Surface
 
+// Every surface WrapSurface has handed out, with the number of wrappers JS
+// hasn't freed yet (a shared surface gets one per reference) and the bytes
+// of its pixels.
+struct LiveSurface {
+  int refs;
+  size_t bytes;
+};
+static std::map<SDL_Surface*, LiveSurface> live_surfaces_;
+
 static Persistent<ObjectTemplate> surface_template_;
 
 Handle<Value> GetSurfaceFlags(Local<String> name, const AccessorInfo& info) {
@@ -80,6 +98,12 @@ Handle<Object> WrapSurface(SDL_Surface* surface) {
     surface_template_ = Persistent<ObjectTemplate>::New(raw_template);
   }
   Handle<ObjectTemplate> templ = surface_template_;
+  TrackAlloc(ALLOC_WRAP_SURFACE, 1, 0);
+  if (surface && surface != SDL_GetVideoSurface()) {
+    LiveSurface& live = live_surfaces_[surface];
+    live.refs++;
+    live.bytes = (size_t)surface->pitch * surface->h;
+  }
 
   // Create an empty http request wrapper.
   Handle<Object> result = templ->NewInstance();
@@ -152,6 +176,7 @@ Handle<Object> WrapRect(SDL_Rect* rect) {
     rect_template_ = Persistent<ObjectTemplate>::New(raw_template);
   }
   Handle<ObjectTemplate> templ = rect_template_;
+  TrackAlloc(ALLOC_WRAP_RECT, 1, 0);
 
   // Create an empty http request wrapper.
   Handle<Object> result = templ->NewInstance();
@@ -176,6 +201,18 @@ SDL_Rect* UnwrapRect(Handle<Object> obj) {
   return static_cast<SDL_Rect*>(ptr);
 }
 
+SDL_Rect* ValueToRect(Handle<Value> value, SDL_Rect* storage) {
+  if (value->IsNull() || value->IsUndefined()) return NULL;
+  Handle<Object> obj = value->ToObject();
+  if (!value->IsArray()) return UnwrapRect(obj);
+  TrackAlloc(ALLOC_RECT_ARRAY, 0, 4);
+  storage->x = obj->Get(String::New("0"))->Int32Value();
+  storage->y = obj->Get(String::New("1"))->Int32Value();
+  storage->w = obj->Get(String::New("2"))->Int32Value();
+  storage->h = obj->Get(String::New("3"))->Int32Value();
+  return storage;
+}
+
 // Wrap/Unwrap PixelFormat
 
 static Persistent<ObjectTemplate> pixelformat_template_;
@@ -224,6 +261,7 @@ Handle<Object> WrapPixelFormat(SDL_PixelFormat* pixelformat) {
     pixelformat_template_ = Persistent<ObjectTemplate>::New(raw_template);
   }
   Handle<ObjectTemplate> templ = pixelformat_template_;
+  TrackAlloc(ALLOC_WRAP_PIXEL_FORMAT, 1, 0);
 
   // Create an empty http request wrapper.
   Handle<Object> result = templ->NewInstance();
@@ -308,6 +346,7 @@ Handle<Object> WrapJoystick(SDL_Joystick* joystick) {
     joystick_template_ = Persistent<ObjectTemplate>::New(raw_template);
   }
   Handle<ObjectTemplate> templ = joystick_template_;
+  TrackAlloc(ALLOC_WRAP_JOYSTICK, 1, 0);
 
   // Create an empty http request wrapper.
   Handle<Object> result = templ->NewInstance();
@@ -392,6 +431,7 @@ Handle<Object> WrapFont(TTF_Font* font) {
     font_template_ = Persistent<ObjectTemplate>::New(raw_template);
   }
   Handle<ObjectTemplate> templ = font_template_;
+  TrackAlloc(ALLOC_WRAP_FONT, 1, 0);
 
   // Create an empty http request wrapper.
   Handle<Object> result = templ->NewInstance();
@@ -416,6 +456,195 @@ TTF_Font* UnwrapFont(Handle<Object> obj) {
   return static_cast<TTF_Font*>(ptr);
 }
 
+// Aligned surfaces
+
+// Pixel buffers we allocated for SDL_PREALLOC surfaces, keyed by surface.
+// Surfaces may be created and freed off the JS thread, hence the lock.
+static std::map<SDL_Surface*, void*> aligned_pixels_;
+static SDL_mutex* volatile aligned_lock_ = NULL;
+
+static SDL_mutex* AlignedLock() {
+  if (!aligned_lock_) {
+    SDL_mutex* lock = SDL_CreateMutex();
+    if (!__sync_bool_compare_and_swap(&aligned_lock_, (SDL_mutex*)NULL, lock)) SDL_DestroyMutex(lock);
+  }
+  return aligned_lock_;
+}
+
+static void* AlignedAlloc(size_t size) {
+#ifdef _WIN32
+  return _aligned_malloc(size, SURFACE_ALIGNMENT);
+#else
+  void* ptr;
+  if (posix_memalign(&ptr, SURFACE_ALIGNMENT, size)) return NULL;
+  return ptr;
+#endif
+}
+
+static void AlignedFree(void* ptr) {
+#ifdef _WIN32
+  _aligned_free(ptr);
+#else
+  free(ptr);
+#endif
+}
+
+SDL_Surface* CreateAlignedSurface(Uint32 flags, int width, int height, int depth,
+    Uint32 Rmask, Uint32 Gmask, Uint32 Bmask, Uint32 Amask) {
+  // Video memory is allocated by the driver, nothing for us to align.
+  if (flags & SDL_HWSURFACE || width <= 0 || height <= 0) {
+    return SDL_CreateRGBSurface(flags, width, height, depth, Rmask, Gmask, Bmask, Amask);
+  }
+
+  int bytes = (depth + 7) / 8;
+  int pitch = (width * bytes + SURFACE_ALIGNMENT - 1) & ~(SURFACE_ALIGNMENT - 1);
+  size_t size = (size_t)pitch * height;
+  void* pixels = AlignedAlloc(size);
+  if (!pixels) {
+    SDL_OutOfMemory();
+    return NULL;
+  }
+  memset(pixels, 0, size);
+
+  // Like SDL_CreateRGBSurface, this sets SDL_SRCALPHA when there's an alpha
+  // mask and nothing else; the other flags only choose video memory.
+  SDL_Surface* surface = SDL_CreateRGBSurfaceFrom(pixels, width, height, depth, pitch,
+    Rmask, Gmask, Bmask, Amask);
+  if (!surface) {
+    AlignedFree(pixels);
+    return NULL;
+  }
+  SDL_mutex* lock = AlignedLock();
+  SDL_LockMutex(lock);
+  aligned_pixels_[surface] = pixels;
+  SDL_UnlockMutex(lock);
+  return surface;
+}
+
+// The same steps as SDL_ConvertSurface, onto an aligned surface.  The
+// source's color key and alpha are lifted for the copy and put back.
+SDL_Surface* ConvertAlignedSurface(SDL_Surface* src, SDL_PixelFormat* fmt, Uint32 flags) {
+  if (flags & SDL_HWSURFACE) return SDL_ConvertSurface(src, fmt, flags);
+
+  SDL_Surface* dst = CreateAlignedSurface(SDL_SWSURFACE, src->w, src->h, fmt->BitsPerPixel,
+    fmt->Rmask, fmt->Gmask, fmt->Bmask, fmt->Amask);
+  if (!dst) return NULL;
+  if (fmt->palette && dst->format->palette) {
+    SDL_SetColors(dst, fmt->palette->colors, 0, fmt->palette->ncolors);
+  }
+
+  Uint32 key_flags = src->flags & (SDL_SRCCOLORKEY | SDL_RLEACCELOK);
+  Uint32 alpha_flags = src->flags & (SDL_SRCALPHA | SDL_RLEACCELOK);
+  Uint32 colorkey = src->format->colorkey;
+  Uint8 alpha = src->format->alpha;
+  // Converting to a format with alpha turns the key into transparent
+  // pixels, unless a key is asked for.
+  bool keep_key = (key_flags & SDL_SRCCOLORKEY) && ((flags & SDL_SRCCOLORKEY) || !fmt->Amask);
+  bool has_alpha = alpha_flags & SDL_SRCALPHA;
+  if (keep_key) SDL_SetColorKey(src, 0, 0);
+  if (has_alpha) {
+    if (fmt->Amask) src->flags &= ~SDL_SRCALPHA;
+    else SDL_SetAlpha(src, 0, 0);
+  }
+
+  SDL_Rect bounds = { 0, 0, (Uint16)src->w, (Uint16)src->h };
+  int result = SDL_LowerBlit(src, &bounds, dst, &bounds);
+  SDL_SetClipRect(dst, &src->clip_rect);
+
+  if (keep_key) {
+    Uint8 r, g, b;
+    SDL_GetRGB(colorkey, src->format, &r, &g, &b);
+    SDL_SetColorKey(dst, key_flags | (flags & SDL_RLEACCELOK), SDL_MapRGB(dst->format, r, g, b));
+    SDL_SetColorKey(src, key_flags, colorkey);
+  }
+  if (has_alpha) {
+    SDL_SetAlpha(dst, alpha_flags | (flags & SDL_RLEACCELOK), alpha);
+    if (fmt->Amask) src->flags |= SDL_SRCALPHA;
+    else SDL_SetAlpha(src, alpha_flags, alpha);
+  }
+
+  if (result < 0) {
+    ReleaseSurface(dst);
+    return NULL;
+  }
+  return dst;
+}
+
+SDL_Surface* AlignSurface(SDL_Surface* surface, SDL_PixelFormat* format) {
+  if (!surface) return NULL;
+  Uint32 flags = SDL_SWSURFACE | (surface->flags & (SDL_SRCCOLORKEY | SDL_SRCALPHA | SDL_RLEACCELOK));
+  SDL_Surface* aligned = ConvertAlignedSurface(surface, format ? format : surface->format, flags);
+  SDL_FreeSurface(surface);
+  return aligned;
+}
+
+SDL_Surface* DecodeImage(const char* path) {
+  PROBE1(decode__start, path);
+  PROBE_TIMER(timer, decode__done);
+  SDL_Surface* image = IMG_Load(path);
+  PROBE_DONE2(decode__done, timer, image ? image->w : 0, image ? image->h : 0);
+  return image;
+}
+
+SDL_Surface* LoadImage(const char* path, SDL_PixelFormat* format) {
+  return AlignSurface(DecodeImage(path), format);
+}
+
+void ReleaseSurface(SDL_Surface* surface) {
+  if (!surface) return;
+  // Other references keep the pixels; the last one to go frees them.
+  if (surface->refcount > 1) {
+    SDL_FreeSurface(surface);
+    return;
+  }
+  void* pixels = NULL;
+  SDL_mutex* lock = AlignedLock();
+  SDL_LockMutex(lock);
+  std::map<SDL_Surface*, void*>::iterator it = aligned_pixels_.find(surface);
+  if (it != aligned_pixels_.end()) {
+    pixels = it->second;
+    aligned_pixels_.erase(it);
+  }
+  SDL_UnlockMutex(lock);
+  SDL_FreeSurface(surface);
+  if (pixels) AlignedFree(pixels);
+}
+
+void ForgetSurface(SDL_Surface* surface) {
+  std::map<SDL_Surface*, LiveSurface>::iterator it = live_surfaces_.find(surface);
+  if (it != live_surfaces_.end() && --it->second.refs <= 0) live_surfaces_.erase(it);
+}
+
+void CountLiveSurfaces(Uint32* count, double* bytes) {
+  *count = (Uint32)live_surfaces_.size();
+  *bytes = 0;
+  for (std::map<SDL_Surface*, LiveSurface>::const_iterator it = live_surfaces_.begin();
+       it != live_surfaces_.end(); ++it) {
+    *bytes += it->second.bytes;
+  }
+}
+
+
+void* TypedArrayData(Handle<Value> value, ExternalArrayType type, int* length) {
+  if (!value->IsObject()) return NULL;
+  Local<Object> obj = value->ToObject();
+  if (!obj->HasIndexedPropertiesInExternalArrayData()
+      || obj->GetIndexedPropertiesExternalArrayDataType() != type) {
+    return NULL;
+  }
+  *length = obj->GetIndexedPropertiesExternalArrayDataLength();
+  return obj->GetIndexedPropertiesExternalArrayData();
+}
+
+double ClockMillis() {
+#ifdef _WIN32
+  return SDL_GetTicks();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+#endif
+}
 
 char* BufferData(Buffer *b) {
   return Buffer::Data(b->handle_);
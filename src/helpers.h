@@ -4,6 +4,8 @@
 #include <v8.h>
 #include <node.h>
 #include <node_buffer.h>
+#include <SDL.h>
+#include <SDL_ttf.h>
 
 using namespace node;
 using namespace v8;
@@ -31,6 +33,44 @@ namespace sdl {
   TTF_Font* UnwrapFont(Handle<Object> obj);
 
   
+  // Reads a rect argument given as null, [x, y, w, h] or a wrapped Rect.
+  // Arrays are copied into `storage`; returns NULL for null.
+  SDL_Rect* ValueToRect(Handle<Value> value, SDL_Rect* storage);
+
+  // Surfaces whose pixel rows start on a cache line.  The pixels are owned by
+  // the binding, so every reference to such a surface must be dropped with
+  // ReleaseSurface, which is safe for any surface.  ConvertAlignedSurface is
+  // SDL_ConvertSurface onto aligned rows; AlignSurface replaces a surface
+  // from elsewhere (IMG_Load, SDL_ttf) with an aligned copy, converted to
+  // `format` unless that's NULL, and frees the original.
+  const int SURFACE_ALIGNMENT = 64;
+  SDL_Surface* CreateAlignedSurface(Uint32 flags, int width, int height, int depth,
+    Uint32 Rmask, Uint32 Gmask, Uint32 Bmask, Uint32 Amask);
+  SDL_Surface* ConvertAlignedSurface(SDL_Surface* src, SDL_PixelFormat* fmt, Uint32 flags);
+  SDL_Surface* AlignSurface(SDL_Surface* surface, SDL_PixelFormat* format);
+  void ReleaseSurface(SDL_Surface* surface);
+
+  // IMG_Load between the decode probes, on any thread.  LoadImage also
+  // aligns the result as AlignSurface does.  Both return NULL with the
+  // reason in SDL_GetError().
+  SDL_Surface* DecodeImage(const char* path);
+  SDL_Surface* LoadImage(const char* path, SDL_PixelFormat* format);
+
+  // Surfaces handed to JS that haven't been freed yet, not counting the
+  // screen, and the bytes their pixels take.  WrapSurface adds a reference;
+  // ForgetSurface, called on the JS thread when JS frees one, drops it, and
+  // a surface stops counting when its last reference is gone.
+  void ForgetSurface(SDL_Surface* surface);
+  void CountLiveSurfaces(Uint32* count, double* bytes);
+
+  // Backing store of a typed array of the given element type, or NULL when the
+  // value isn't one.  Stores the element count in `length`.
+  void* TypedArrayData(Handle<Value> value, ExternalArrayType type, int* length);
+
+  // Milliseconds on a monotonic clock, with sub-millisecond resolution where
+  // the platform has it.  Audio scheduling and frame timing share this clock.
+  double ClockMillis();
+
   // Helpers to work with buffers
   char* BufferData(Buffer *b);
   size_t BufferLength(Buffer *b);
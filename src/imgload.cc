@@ -0,0 +1,233 @@
+#include <v8.h>
+#include <node.h>
+#include <SDL.h>
+#include <SDL_thread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <list>
+#include <vector>
+
+#include "helpers.h"
+#include "imgload.h"
+
+namespace sdl {
+
+// More threads than this buys nothing but memory.
+static const int MAX_LOAD_THREADS = 64;
+
+typedef struct {
+  std::vector<char*> paths;
+  std::vector<SDL_Surface*> surfaces;
+  int threads;
+  bool convert;
+  SDL_PixelFormat format;       // the screen's, when converting
+  volatile int next;            // next path to claim
+  char* volatile error;         // first failure, "path: reason"
+  bool batch;                   // call back with an array
+  int helpers_wanted;           // pool threads still to join, under pool_lock_
+  int helpers_running;          // pool threads working on it, under pool_lock_
+  Persistent<Function> fn;
+} img_closure_t;
+
+// Helper threads for batches, started as they are first needed and kept
+// for later batches.  A batch takes up to threads - 1 of them; the pool
+// thread running it is the other one.
+static SDL_mutex* pool_lock_ = NULL;
+static SDL_cond* pool_wake_ = NULL;
+static SDL_cond* pool_done_ = NULL;
+static std::list<img_closure_t*> pool_jobs_;
+static int pool_threads_ = 0;
+
+static void Fail(img_closure_t* closure, const char* path, const char* reason) {
+  char* message = (char*)malloc(strlen(path) + strlen(reason) + 3);
+  if (!message) return;
+  sprintf(message, "%s: %s", path, reason);
+  if (!__sync_bool_compare_and_swap(&closure->error, (char*)NULL, message)) free(message);
+}
+
+static int LoadWorker(void* data) {
+  img_closure_t* closure = (img_closure_t*)data;
+  const int count = (int)closure->paths.size();
+
+  for (;;) {
+    int i = __sync_fetch_and_add(&closure->next, 1);
+    if (i >= count || closure->error) break;
+    const char* path = closure->paths[i];
+
+    SDL_Surface* image = LoadImage(path, closure->convert ? &closure->format : NULL);
+    if (!image) {
+      Fail(closure, path, SDL_GetError());
+      break;
+    }
+    closure->surfaces[i] = image;
+  }
+  return 0;
+}
+
+static int HelperMain(void* data) {
+  SDL_LockMutex(pool_lock_);
+  for (;;) {
+    while (pool_jobs_.empty()) SDL_CondWait(pool_wake_, pool_lock_);
+    img_closure_t* closure = pool_jobs_.front();
+    if (--closure->helpers_wanted == 0) pool_jobs_.pop_front();
+    closure->helpers_running++;
+    SDL_UnlockMutex(pool_lock_);
+
+    LoadWorker(closure);
+
+    SDL_LockMutex(pool_lock_);
+    if (--closure->helpers_running == 0) SDL_CondBroadcast(pool_done_);
+  }
+  return 0;
+}
+
+// Runs on the thread pool; the pool thread is one of the workers.
+static void EIO_LoadImages(eio_req *req) {
+  img_closure_t* closure = (img_closure_t*)req->data;
+  int extra = closure->threads - 1;
+  if (extra > (int)closure->paths.size() - 1) extra = (int)closure->paths.size() - 1;
+
+  if (extra > 0) {
+    SDL_LockMutex(pool_lock_);
+    while (pool_threads_ < extra && SDL_CreateThread(HelperMain, NULL)) pool_threads_++;
+    closure->helpers_wanted = extra;
+    closure->helpers_running = 0;
+    pool_jobs_.push_back(closure);
+    SDL_CondBroadcast(pool_wake_);
+    SDL_UnlockMutex(pool_lock_);
+  }
+
+  LoadWorker(closure);
+
+  if (extra > 0) {
+    // Helpers that haven't joined yet would find nothing left to do.
+    SDL_LockMutex(pool_lock_);
+    if (closure->helpers_wanted > 0) pool_jobs_.remove(closure);
+    while (closure->helpers_running > 0) SDL_CondWait(pool_done_, pool_lock_);
+    SDL_UnlockMutex(pool_lock_);
+  }
+}
+
+static void FreeClosure(img_closure_t* closure) {
+  for (size_t i = 0; i < closure->paths.size(); i++) free(closure->paths[i]);
+  free(closure->error);
+  closure->fn.Dispose();
+  delete closure;
+}
+
+static int EIO_OnImagesLoaded(eio_req *req) {
+  HandleScope scope;
+
+  img_closure_t* closure = (img_closure_t*)req->data;
+  ev_unref(EV_DEFAULT_UC);
+
+  Handle<Value> argv[2];
+  if (closure->error) {
+    for (size_t i = 0; i < closure->surfaces.size(); i++) {
+      ReleaseSurface(closure->surfaces[i]);
+    }
+    const char* name = closure->batch ? "IMG::LoadBatch: " : "IMG::LoadAsync: ";
+    argv[0] = Exception::Error(String::Concat(String::New(name), String::New(closure->error)));
+    argv[1] = Undefined();
+  } else if (closure->batch) {
+    Local<Array> surfaces = Array::New(closure->surfaces.size());
+    for (size_t i = 0; i < closure->surfaces.size(); i++) {
+      surfaces->Set(i, WrapSurface(closure->surfaces[i]));
+    }
+    argv[0] = Undefined();
+    argv[1] = surfaces;
+  } else {
+    argv[0] = Undefined();
+    argv[1] = WrapSurface(closure->surfaces[0]);
+  }
+
+  closure->fn->Call(Context::GetCurrent()->Global(), 2, argv);
+
+  FreeClosure(closure);
+  return 0;
+}
+
+// Reads { threads, displayFormat } and queues the work.  Returns an empty
+// handle on success, or the exception it threw.
+static Handle<Value> StartLoad(img_closure_t* closure, Handle<Value> options,
+    Handle<Value> fn, const char* name) {
+  closure->threads = 1;
+  closure->convert = false;
+  if (options->IsObject()) {
+    Local<Value> threads = options->ToObject()->Get(String::New("threads"));
+    if (threads->IsNumber()) closure->threads = threads->Int32Value();
+    closure->convert = options->ToObject()->Get(String::New("displayFormat"))->BooleanValue();
+  }
+  if (closure->threads < 1) closure->threads = 1;
+  if (closure->threads > MAX_LOAD_THREADS) closure->threads = MAX_LOAD_THREADS;
+
+  if (closure->convert) {
+    SDL_Surface* screen = SDL_GetVideoSurface();
+    if (!screen) {
+      FreeClosure(closure);
+      return ThrowException(Exception::Error(String::Concat(
+        String::New(name), String::New(": No video mode set for displayFormat"))));
+    }
+    closure->format = *screen->format;
+  }
+
+  if (!pool_lock_) {
+    pool_lock_ = SDL_CreateMutex();
+    pool_wake_ = SDL_CreateCond();
+    pool_done_ = SDL_CreateCond();
+  }
+
+  closure->surfaces.assign(closure->paths.size(), (SDL_Surface*)NULL);
+  closure->next = 0;
+  closure->error = NULL;
+  closure->fn = Persistent<Function>::New(Handle<Function>::Cast(fn));
+  eio_custom(EIO_LoadImages, EIO_PRI_DEFAULT, EIO_OnImagesLoaded, closure);
+  ev_ref(EV_DEFAULT_UC);
+  return Handle<Value>();
+}
+
+// Decodes one image on the thread pool and calls back with (err, Surface).
+Handle<Value> IMG::LoadAsync(const Arguments& args) {
+  HandleScope scope;
+
+  if (!((args.Length() == 2 && args[0]->IsString() && args[1]->IsFunction())
+        || (args.Length() == 3 && args[0]->IsString() && args[1]->IsObject() && args[2]->IsFunction()))) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected IMG::LoadAsync(String, [Object], Function)")));
+  }
+
+  img_closure_t* closure = new img_closure_t();
+  closure->batch = false;
+  closure->paths.push_back(strdup(*String::Utf8Value(args[0])));
+  Handle<Value> error = StartLoad(closure, args.Length() == 3 ? args[1] : Handle<Value>(Undefined()),
+    args[args.Length() - 1], "IMG::LoadAsync");
+  if (!error.IsEmpty()) return error;
+  return Undefined();
+}
+
+// Decodes a list of images on `threads` threads and calls back with
+// (err, [Surface]) in the order of the paths.  If any image fails the others
+// are freed and only the first error is reported.
+Handle<Value> IMG::LoadBatch(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 3 && args[0]->IsArray() && args[1]->IsObject() && args[2]->IsFunction())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected IMG::LoadBatch(Array, Object, Function)")));
+  }
+
+  Handle<Array> paths = Handle<Array>::Cast(args[0]);
+  if (paths->Length() == 0) {
+    return ThrowException(Exception::RangeError(String::New("IMG::LoadBatch: No paths")));
+  }
+
+  img_closure_t* closure = new img_closure_t();
+  closure->batch = true;
+  for (unsigned i = 0; i < paths->Length(); i++) {
+    closure->paths.push_back(strdup(*String::Utf8Value(paths->Get(i))));
+  }
+  Handle<Value> error = StartLoad(closure, args[1], args[2], "IMG::LoadBatch");
+  if (!error.IsEmpty()) return error;
+  return Undefined();
+}
+
+} // sdl
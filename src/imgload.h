@@ -0,0 +1,20 @@
+#ifndef NODE_SDL_IMGLOAD_H_
+#define NODE_SDL_IMGLOAD_H_
+
+#include <v8.h>
+#include <node.h>
+
+using namespace v8;
+
+namespace sdl {
+
+  // Image decoding off the JS thread.  Both convert to the screen's format
+  // on the worker when asked to, the way displayFormat() would.
+  namespace IMG {
+    Handle<Value> LoadAsync(const Arguments& args);
+    Handle<Value> LoadBatch(const Arguments& args);
+  }
+
+} // sdl
+
+#endif  // NODE_SDL_IMGLOAD_H_
@@ -0,0 +1,133 @@
+#include <v8.h>
+#include <node.h>
+#include <SDL.h>
+#include <SDL_thread.h>
+#include <string.h>
+#include <vector>
+
+#include "helpers.h"
+#include "inject.h"
+
+namespace sdl {
+
+// Upper bound on events per run, to keep the send times within reason.
+static const int MAX_INJECTED = 1 << 22;
+
+static SDL_Thread* thread_ = NULL;
+static volatile int running_ = 0;
+static double rate_ = 0;
+static int count_ = 0;
+static volatile int sent_ = 0;
+static volatile int failed_ = 0;   // SDL_PushEvent refused, the queue was full
+static volatile int done_ = 0;
+
+// ClockMillis() when each event was pushed, -1 if it wasn't.  Written before
+// the push; SDL's queue lock makes it visible to whoever polls the event.
+static std::vector<double> sent_at_;
+
+static int InjectMain(void* data) {
+  const double period = 1000.0 / rate_;
+  const double start = ClockMillis();
+
+  for (int i = 0; i < count_ && running_; i++) {
+    double due = start + i * period;
+    for (double ahead; (ahead = due - ClockMillis()) > 0 && running_; ) {
+      SDL_Delay(ahead >= 1 ? (Uint32)ahead : 1);
+    }
+
+    SDL_Event event;
+    memset(&event, 0, sizeof(event));
+    event.type = SDL_USEREVENT;
+    event.user.code = i;
+    sent_at_[i] = ClockMillis();
+    if (SDL_PushEvent(&event) < 0) {
+      sent_at_[i] = -1;
+      __sync_fetch_and_add(&failed_, 1);
+    }
+    __sync_fetch_and_add(&sent_, 1);
+  }
+  __sync_synchronize();
+  done_ = 1;
+  return 0;
+}
+
+static void StopThread() {
+  if (!thread_) return;
+  running_ = 0;
+  SDL_WaitThread(thread_, NULL);
+  thread_ = NULL;
+}
+
+Handle<Value> INJECT::Start(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 2 && args[0]->IsNumber() && args[1]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected INJECT::Start(Number, Number)")));
+  }
+
+  double rate = args[0]->NumberValue();
+  int count = args[1]->Int32Value();
+  if (!(rate > 0) || count < 1 || count > MAX_INJECTED) {
+    return ThrowException(Exception::RangeError(String::New("INJECT::Start: rate must be positive and count from 1 to 4194304")));
+  }
+
+  StopThread();
+  rate_ = rate;
+  count_ = count;
+  sent_ = failed_ = done_ = 0;
+  sent_at_.assign(count, -1.0);
+  running_ = 1;
+  thread_ = SDL_CreateThread(InjectMain, NULL);
+  if (!thread_) {
+    running_ = 0;
+    return ThrowSDLException("INJECT::Start");
+  }
+  return Undefined();
+}
+
+Handle<Value> INJECT::Stop(const Arguments& args) {
+  HandleScope scope;
+
+  StopThread();
+  return Undefined();
+}
+
+// Returns { sent, failed, done }: events pushed so far, pushes SDL refused
+// because its queue was full, and whether the run is over.
+Handle<Value> INJECT::Stats(const Arguments& args) {
+  HandleScope scope;
+
+  Local<Object> result = Object::New();
+  result->Set(String::NewSymbol("sent"), Number::New(sent_));
+  result->Set(String::NewSymbol("failed"), Number::New(failed_));
+  result->Set(String::NewSymbol("done"), Boolean::New(done_ != 0));
+  return scope.Close(result);
+}
+
+// Milliseconds since injected event `code` was pushed.
+Handle<Value> INJECT::Age(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 1 && args[0]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected INJECT::Age(Number)")));
+  }
+
+  int code = args[0]->Int32Value();
+  if (code < 0 || code >= (int)sent_at_.size() || sent_at_[code] < 0) {
+    return ThrowException(Exception::RangeError(String::New("INJECT::Age: No such injected event")));
+  }
+  return scope.Close(Number::New(ClockMillis() - sent_at_[code]));
+}
+
+void ExportInject(Handle<Object> target) {
+  HandleScope scope;
+
+  Local<Object> INJECT = Object::New();
+  target->Set(String::New("INJECT"), INJECT);
+  NODE_SET_METHOD(INJECT, "start", sdl::INJECT::Start);
+  NODE_SET_METHOD(INJECT, "stop", sdl::INJECT::Stop);
+  NODE_SET_METHOD(INJECT, "stats", sdl::INJECT::Stats);
+  NODE_SET_METHOD(INJECT, "age", sdl::INJECT::Age);
+}
+
+} // sdl
@@ -0,0 +1,25 @@
+#ifndef NODE_SDL_INJECT_H_
+#define NODE_SDL_INJECT_H_
+
+#include <v8.h>
+#include <node.h>
+
+using namespace v8;
+
+namespace sdl {
+
+  // A thread that pushes USEREVENTs into SDL's queue at a steady rate, for
+  // measuring how long input takes to reach JS.  Event n carries code n, and
+  // INJECT.age(n) gives the milliseconds since it was pushed.
+  namespace INJECT {
+    Handle<Value> Start(const Arguments& args);
+    Handle<Value> Stop(const Arguments& args);
+    Handle<Value> Stats(const Arguments& args);
+    Handle<Value> Age(const Arguments& args);
+  }
+
+  void ExportInject(Handle<Object> target);
+
+} // sdl
+
+#endif  // NODE_SDL_INJECT_H_
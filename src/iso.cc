@@ -0,0 +1,511 @@
+#include <v8.h>
+#include <node.h>
+#include <SDL.h>
+#include <math.h>
+#include <stdio.h>
+#include <map>
+#include <vector>
+
+#include "helpers.h"
+#include "iso.h"
+
+namespace sdl {
+
+struct IsoSprite {
+  SDL_Rect src;                 // in the sheet
+  int dy;                       // drawn this much lower
+};
+
+// Draw order.  Tiles have height 0, so an object sorts after the tiles of
+// its own row and layer, and a jumping object after one standing there.
+struct IsoKey {
+  int row;
+  int layer;
+  int height;                   // 1/256 layers above the layer, plus one
+  int x;                        // 1/256 columns
+  int seq;                      // object id, for a stable order
+};
+
+static inline bool KeyBefore(const IsoKey& a, const IsoKey& b) {
+  if (a.row != b.row) return a.row < b.row;
+  if (a.layer != b.layer) return a.layer < b.layer;
+  if (a.height != b.height) return a.height < b.height;
+  if (a.x != b.x) return a.x < b.x;
+  return a.seq < b.seq;
+}
+
+struct IsoObject {
+  int id;
+  int sprite;                   // -1 hides it
+  double x, y, z;               // column, row, layer
+  IsoKey key;
+};
+
+struct IsoMap {
+  SDL_Surface* sheet;
+  std::vector<IsoSprite> sprites;
+  int tile_w, tile_h, layer_h;
+  int columns, rows, layers;
+  std::vector<Sint16> cells;    // [layer][row][column], -1 when empty
+  // Occupied columns [first, last] of each layer's rows; first > last when
+  // the row is empty.
+  std::vector<Sint16> first, last;
+  // Extents over all sprites, for finding the rows and columns to visit.
+  int max_w, max_h, min_dy, max_dy;
+
+  std::map<int, IsoObject*> objects;
+  std::vector<IsoObject*> order; // sorted by key when !dirty
+  bool dirty;
+  int next_object_id;
+};
+
+static std::map<int, IsoMap*> maps_;
+static int next_map_id_ = 1;
+
+static IsoMap* LookupMap(Handle<Value> value) {
+  std::map<int, IsoMap*>::iterator it = maps_.find(value->Int32Value());
+  return it == maps_.end() ? NULL : it->second;
+}
+
+static Handle<Value> ThrowNoMap(const char* name) {
+  return ThrowException(Exception::RangeError(String::Concat(String::New(name), String::New(": No such map"))));
+}
+
+static void SetCell(IsoMap* map, int layer, int row, int column, int sprite) {
+  map->cells[((size_t)layer * map->rows + row) * map->columns + column] = sprite;
+  if (sprite < 0) return;
+  int span = layer * map->rows + row;
+  if (column < map->first[span]) map->first[span] = column;
+  if (column > map->last[span]) map->last[span] = column;
+}
+
+// Object positions beyond this many columns, rows or layers are refused, so
+// that sort keys and pixel positions fit an int.
+static const double MAX_POSITION = 1 << 20;
+// Pixel positions past this are off any surface, and skipped before they can
+// overflow.
+static const double MAX_PIXEL = 1 << 30;
+
+static bool ValidPosition(double x, double y, double z) {
+  // Written so that NaNs fail too.
+  return fabs(x) <= MAX_POSITION && fabs(y) <= MAX_POSITION && fabs(z) <= MAX_POSITION;
+}
+
+static void ComputeKey(IsoObject* obj) {
+  double layer = floor(obj->z);
+  obj->key.row = (int)floor(obj->y + 0.5);
+  obj->key.layer = (int)layer;
+  obj->key.height = 1 + (int)((obj->z - layer) * 256);
+  obj->key.x = (int)floor(obj->x * 256);
+  obj->key.seq = obj->id;
+}
+
+// Moved objects rarely pass more than a neighbour or two, so an insertion
+// sort puts the list back in order in about one pass.
+static void SortObjects(IsoMap* map) {
+  std::vector<IsoObject*>& order = map->order;
+  for (size_t i = 1; i < order.size(); i++) {
+    IsoObject* obj = order[i];
+    size_t j = i;
+    while (j > 0 && KeyBefore(obj->key, order[j - 1]->key)) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = obj;
+  }
+  map->dirty = false;
+}
+
+static bool IntField(Handle<Object> obj, const char* key, int* out) {
+  Local<Value> value = obj->Get(String::New(key));
+  if (!value->IsNumber()) return false;
+  *out = value->Int32Value();
+  return true;
+}
+
+// Reads [x, y, w, h] or [x, y, w, h, dy] rects of the sheet.
+static const char* ParseSprites(Handle<Value> value, IsoMap* map) {
+  if (!value->IsArray() || Handle<Array>::Cast(value)->Length() == 0) return "sprites must be a non-empty array";
+  Handle<Array> list = Handle<Array>::Cast(value);
+  if (list->Length() > 32767) return "too many sprites";
+  map->max_w = map->max_h = 0;
+  map->min_dy = map->max_dy = 0;
+  for (unsigned i = 0; i < list->Length(); i++) {
+    Local<Value> entry = list->Get(i);
+    if (!entry->IsArray()) return "sprites must be [x, y, w, h, [dy]] arrays";
+    Handle<Array> rect = Handle<Array>::Cast(entry);
+    if (rect->Length() < 4) return "sprites must be [x, y, w, h, [dy]] arrays";
+    IsoSprite sprite;
+    sprite.src.x = rect->Get(0)->Int32Value();
+    sprite.src.y = rect->Get(1)->Int32Value();
+    sprite.src.w = rect->Get(2)->Int32Value();
+    sprite.src.h = rect->Get(3)->Int32Value();
+    sprite.dy = rect->Length() > 4 ? rect->Get(4)->Int32Value() : 0;
+    if (sprite.src.x < 0 || sprite.src.y < 0 || sprite.src.w <= 0 || sprite.src.h <= 0
+        || sprite.src.x + sprite.src.w > map->sheet->w || sprite.src.y + sprite.src.h > map->sheet->h) {
+      return "sprite rects must lie within the sheet";
+    }
+    if (sprite.src.w > map->max_w) map->max_w = sprite.src.w;
+    if (sprite.src.h > map->max_h) map->max_h = sprite.src.h;
+    if (sprite.dy < map->min_dy) map->min_dy = sprite.dy;
+    if (sprite.dy > map->max_dy) map->max_dy = sprite.dy;
+    map->sprites.push_back(sprite);
+  }
+  return NULL;
+}
+
+// Reads layers as arrays of rows of sprite indices, with null or -1 for
+// empty cells.  Rows may be ragged; the map is as wide and tall as the
+// largest.
+static const char* ParseLayers(Handle<Value> value, IsoMap* map) {
+  if (!value->IsArray() || Handle<Array>::Cast(value)->Length() == 0) return "layers must be a non-empty array";
+  Handle<Array> layers = Handle<Array>::Cast(value);
+  map->layers = layers->Length();
+  map->rows = map->columns = 0;
+  for (int z = 0; z < map->layers; z++) {
+    Local<Value> layer = layers->Get(z);
+    if (!layer->IsArray()) return "each layer must be an array of rows";
+    Handle<Array> rows = Handle<Array>::Cast(layer);
+    if ((int)rows->Length() > map->rows) map->rows = rows->Length();
+    for (unsigned r = 0; r < rows->Length(); r++) {
+      Local<Value> row = rows->Get(r);
+      if (!row->IsArray()) return "each row must be an array";
+      int length = Handle<Array>::Cast(row)->Length();
+      if (length > map->columns) map->columns = length;
+    }
+  }
+  if (map->rows == 0 || map->columns == 0) return "layers are empty";
+  if (map->columns > 32767 || map->rows > 32767) return "layers are too large";
+
+  map->cells.assign((size_t)map->layers * map->rows * map->columns, -1);
+  map->first.assign((size_t)map->layers * map->rows, (Sint16)map->columns);
+  map->last.assign((size_t)map->layers * map->rows, -1);
+  const int count = map->sprites.size();
+  for (int z = 0; z < map->layers; z++) {
+    Handle<Array> rows = Handle<Array>::Cast(layers->Get(z));
+    for (unsigned r = 0; r < rows->Length(); r++) {
+      Handle<Array> row = Handle<Array>::Cast(rows->Get(r));
+      for (unsigned c = 0; c < row->Length(); c++) {
+        Local<Value> cell = row->Get(c);
+        if (cell->IsNull() || cell->IsUndefined()) continue;
+        if (!cell->IsNumber() || cell->Int32Value() < -1 || cell->Int32Value() >= count) {
+          return "cells must be sprite indices, -1 or null";
+        }
+        SetCell(map, z, r, c, cell->Int32Value());
+      }
+    }
+  }
+  return NULL;
+}
+
+static void FreeMapData(IsoMap* map) {
+  for (std::map<int, IsoObject*>::iterator it = map->objects.begin(); it != map->objects.end(); ++it) {
+    delete it->second;
+  }
+  ReleaseSurface(map->sheet);
+  delete map;
+}
+
+// Creates a map from { sheet, sprites, layers, tileWidth, tileHeight,
+// layerHeight } and returns its id.  The map holds a reference to the sheet,
+// so freeing the sheet's surface first is safe.
+Handle<Value> ISO::CreateMap(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 1 && args[0]->IsObject())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected ISO::CreateMap(Object)")));
+  }
+
+  Handle<Object> options = args[0]->ToObject();
+  Local<Value> sheet = options->Get(String::New("sheet"));
+  if (!sheet->IsObject()) {
+    return ThrowException(Exception::TypeError(String::New("ISO::CreateMap: sheet must be a Surface")));
+  }
+
+  IsoMap* map = new IsoMap();
+  map->sheet = UnwrapSurface(sheet->ToObject());
+  map->sheet->refcount++;
+  map->dirty = false;
+  map->next_object_id = 1;
+  const char* problem = NULL;
+  if (!IntField(options, "tileWidth", &map->tile_w) || !IntField(options, "tileHeight", &map->tile_h)
+      || !IntField(options, "layerHeight", &map->layer_h)
+      || map->tile_w <= 0 || map->tile_h <= 0 || map->layer_h < 0) {
+    problem = "tileWidth and tileHeight must be positive, layerHeight not negative";
+  }
+  if (!problem) problem = ParseSprites(options->Get(String::New("sprites")), map);
+  if (!problem) problem = ParseLayers(options->Get(String::New("layers")), map);
+  if (problem) {
+    FreeMapData(map);
+    return ThrowException(Exception::RangeError(String::Concat(String::New("ISO::CreateMap: "), String::New(problem))));
+  }
+
+  int id = next_map_id_++;
+  maps_[id] = map;
+  return scope.Close(Number::New(id));
+}
+
+Handle<Value> ISO::FreeMap(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 1 && args[0]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected ISO::FreeMap(Number)")));
+  }
+  IsoMap* map = LookupMap(args[0]);
+  if (!map) return Undefined();
+  maps_.erase(args[0]->Int32Value());
+  FreeMapData(map);
+  return Undefined();
+}
+
+// Sets one cell to a sprite index, or -1 to clear it.
+Handle<Value> ISO::SetTile(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 5 && args[0]->IsNumber() && args[1]->IsNumber() && args[2]->IsNumber()
+        && args[3]->IsNumber() && args[4]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected ISO::SetTile(Number, Number, Number, Number, Number)")));
+  }
+  IsoMap* map = LookupMap(args[0]);
+  if (!map) return ThrowNoMap("ISO::SetTile");
+
+  int layer = args[1]->Int32Value(), column = args[2]->Int32Value(), row = args[3]->Int32Value();
+  int sprite = args[4]->Int32Value();
+  if (layer < 0 || layer >= map->layers || row < 0 || row >= map->rows || column < 0 || column >= map->columns) {
+    return ThrowException(Exception::RangeError(String::New("ISO::SetTile: Cell outside the map")));
+  }
+  if (sprite < -1 || sprite >= (int)map->sprites.size()) {
+    return ThrowException(Exception::RangeError(String::New("ISO::SetTile: No such sprite")));
+  }
+  SetCell(map, layer, row, column, sprite);
+  return Undefined();
+}
+
+// Adds an object showing a sprite at (x, y, z) in columns, rows and layers
+// and returns its id.  An object standing on layer n has z = n + 1.
+Handle<Value> ISO::AddObject(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 5 && args[0]->IsNumber() && args[1]->IsNumber() && args[2]->IsNumber()
+        && args[3]->IsNumber() && args[4]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected ISO::AddObject(Number, Number, Number, Number, Number)")));
+  }
+  IsoMap* map = LookupMap(args[0]);
+  if (!map) return ThrowNoMap("ISO::AddObject");
+  int sprite = args[1]->Int32Value();
+  if (sprite < -1 || sprite >= (int)map->sprites.size()) {
+    return ThrowException(Exception::RangeError(String::New("ISO::AddObject: No such sprite")));
+  }
+
+  if (!ValidPosition(args[2]->NumberValue(), args[3]->NumberValue(), args[4]->NumberValue())) {
+    return ThrowException(Exception::RangeError(String::New("ISO::AddObject: Position out of range")));
+  }
+
+  IsoObject* obj = new IsoObject();
+  obj->id = map->next_object_id++;
+  obj->sprite = sprite;
+  obj->x = args[2]->NumberValue();
+  obj->y = args[3]->NumberValue();
+  obj->z = args[4]->NumberValue();
+  ComputeKey(obj);
+  map->objects[obj->id] = obj;
+  map->order.push_back(obj);
+  map->dirty = true;
+  return scope.Close(Number::New(obj->id));
+}
+
+static IsoObject* LookupObject(IsoMap* map, Handle<Value> value) {
+  std::map<int, IsoObject*>::iterator it = map->objects.find(value->Int32Value());
+  return it == map->objects.end() ? NULL : it->second;
+}
+
+// Moves an object.  It is put back in order at the next draw.
+Handle<Value> ISO::MoveObject(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 5 && args[0]->IsNumber() && args[1]->IsNumber() && args[2]->IsNumber()
+        && args[3]->IsNumber() && args[4]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected ISO::MoveObject(Number, Number, Number, Number, Number)")));
+  }
+  IsoMap* map = LookupMap(args[0]);
+  if (!map) return ThrowNoMap("ISO::MoveObject");
+  IsoObject* obj = LookupObject(map, args[1]);
+  if (!obj) {
+    return ThrowException(Exception::RangeError(String::New("ISO::MoveObject: No such object")));
+  }
+  if (!ValidPosition(args[2]->NumberValue(), args[3]->NumberValue(), args[4]->NumberValue())) {
+    return ThrowException(Exception::RangeError(String::New("ISO::MoveObject: Position out of range")));
+  }
+
+  obj->x = args[2]->NumberValue();
+  obj->y = args[3]->NumberValue();
+  obj->z = args[4]->NumberValue();
+  IsoKey old = obj->key;
+  ComputeKey(obj);
+  if (KeyBefore(old, obj->key) || KeyBefore(obj->key, old)) map->dirty = true;
+  return Undefined();
+}
+
+Handle<Value> ISO::SetObjectSprite(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 3 && args[0]->IsNumber() && args[1]->IsNumber() && args[2]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected ISO::SetObjectSprite(Number, Number, Number)")));
+  }
+  IsoMap* map = LookupMap(args[0]);
+  if (!map) return ThrowNoMap("ISO::SetObjectSprite");
+  IsoObject* obj = LookupObject(map, args[1]);
+  if (!obj) {
+    return ThrowException(Exception::RangeError(String::New("ISO::SetObjectSprite: No such object")));
+  }
+  int sprite = args[2]->Int32Value();
+  if (sprite < -1 || sprite >= (int)map->sprites.size()) {
+    return ThrowException(Exception::RangeError(String::New("ISO::SetObjectSprite: No such sprite")));
+  }
+  obj->sprite = sprite;
+  return Undefined();
+}
+
+Handle<Value> ISO::RemoveObject(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 2 && args[0]->IsNumber() && args[1]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected ISO::RemoveObject(Number, Number)")));
+  }
+  IsoMap* map = LookupMap(args[0]);
+  if (!map) return ThrowNoMap("ISO::RemoveObject");
+  IsoObject* obj = LookupObject(map, args[1]);
+  if (!obj) return Undefined();
+
+  map->objects.erase(obj->id);
+  for (size_t i = 0; i < map->order.size(); i++) {
+    if (map->order[i] == obj) {
+      map->order.erase(map->order.begin() + i);
+      break;
+    }
+  }
+  delete obj;
+  return Undefined();
+}
+
+struct IsoFrame {
+  IsoMap* map;
+  SDL_Surface* dst;
+  int left, top, right, bottom;  // clip rect, in map pixels
+  int camera_x, camera_y;
+  int blits;
+};
+
+// Blits a sprite with its top left at map pixel (x, y) unless it misses the
+// clip rect.
+static void DrawSprite(IsoFrame* frame, int sprite, int x, int y) {
+  const IsoSprite& s = frame->map->sprites[sprite];
+  y += s.dy;
+  if (x >= frame->right || y >= frame->bottom || x + s.src.w <= frame->left || y + s.src.h <= frame->top) return;
+  SDL_Rect src = s.src;
+  SDL_Rect dst;
+  dst.x = x - frame->camera_x;
+  dst.y = y - frame->camera_y;
+  SDL_BlitSurface(frame->map->sheet, &src, frame->dst, &dst);
+  frame->blits++;
+}
+
+static void DrawObject(IsoFrame* frame, IsoObject* obj) {
+  if (obj->sprite < 0) return;
+  IsoMap* map = frame->map;
+  double x = floor(obj->x * map->tile_w), y = floor(obj->y * map->tile_h - obj->z * map->layer_h);
+  if (fabs(x) > MAX_PIXEL || fabs(y) > MAX_PIXEL) return;
+  DrawSprite(frame, obj->sprite, (int)x, (int)y);
+}
+
+static inline int FloorDiv(int a, int b) {
+  return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// Draws the map with the camera's top left at map pixel (x, y): tile
+// (column, row) of layer z sits at (column * tileWidth, row * tileHeight -
+// z * layerHeight).  Returns the number of blits.
+static int DrawMap(IsoMap* map, SDL_Surface* dst, int camera_x, int camera_y) {
+  if (map->dirty) SortObjects(map);
+
+  IsoFrame frame;
+  frame.map = map;
+  frame.dst = dst;
+  frame.camera_x = camera_x;
+  frame.camera_y = camera_y;
+  const SDL_Rect& clip = dst->clip_rect;
+  frame.left = clip.x + camera_x;
+  frame.top = clip.y + camera_y;
+  frame.right = frame.left + clip.w;
+  frame.bottom = frame.top + clip.h;
+  frame.blits = 0;
+
+  // The rows and columns whose sprites can reach the clip rect.  Higher
+  // layers lift later rows into view.
+  int r0 = FloorDiv(frame.top - map->max_h - map->max_dy, map->tile_h) + 1;
+  int r1 = FloorDiv(frame.bottom - 1 + (map->layers - 1) * map->layer_h - map->min_dy, map->tile_h);
+  int c0 = FloorDiv(frame.left - map->max_w, map->tile_w) + 1;
+  int c1 = FloorDiv(frame.right - 1, map->tile_w);
+  if (r0 < 0) r0 = 0;
+  if (r1 > map->rows - 1) r1 = map->rows - 1;
+  if (c0 < 0) c0 = 0;
+  if (c1 > map->columns - 1) c1 = map->columns - 1;
+
+  // Objects are culled one by one, so those off the visible rows cost a
+  // comparison each.
+  const std::vector<IsoObject*>& order = map->order;
+  size_t next = 0;
+  IsoKey key;
+  key.height = 0;
+  key.seq = 0;
+  for (int r = r0; r <= r1; r++) {
+    key.row = r;
+    for (int z = 0; z < map->layers; z++) {
+      int span = z * map->rows + r;
+      int first = map->first[span] > c0 ? map->first[span] : c0;
+      int last = map->last[span] < c1 ? map->last[span] : c1;
+      if (first > last) continue;
+      const Sint16* cells = &map->cells[(size_t)span * map->columns];
+      int y = r * map->tile_h - z * map->layer_h;
+      key.layer = z;
+      for (int c = first; c <= last; c++) {
+        if (cells[c] < 0) continue;
+        key.x = c * 256;
+        while (next < order.size() && KeyBefore(order[next]->key, key)) DrawObject(&frame, order[next++]);
+        DrawSprite(&frame, cells[c], c * map->tile_w, y);
+      }
+    }
+  }
+  while (next < order.size()) DrawObject(&frame, order[next++]);
+  return frame.blits;
+}
+
+Handle<Value> ISO::Draw(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 4 && args[0]->IsNumber() && args[1]->IsObject() && args[2]->IsNumber() && args[3]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected ISO::Draw(Number, Surface, Number, Number)")));
+  }
+  IsoMap* map = LookupMap(args[0]);
+  if (!map) return ThrowNoMap("ISO::Draw");
+
+  int blits = DrawMap(map, UnwrapSurface(args[1]->ToObject()), args[2]->Int32Value(), args[3]->Int32Value());
+  return scope.Close(Number::New(blits));
+}
+
+void ExportIso(Handle<Object> target) {
+  HandleScope scope;
+
+  Local<Object> ISO = Object::New();
+  target->Set(String::New("ISO"), ISO);
+  NODE_SET_METHOD(ISO, "createMap", sdl::ISO::CreateMap);
+  NODE_SET_METHOD(ISO, "freeMap", sdl::ISO::FreeMap);
+  NODE_SET_METHOD(ISO, "setTile", sdl::ISO::SetTile);
+  NODE_SET_METHOD(ISO, "addObject", sdl::ISO::AddObject);
+  NODE_SET_METHOD(ISO, "moveObject", sdl::ISO::MoveObject);
+  NODE_SET_METHOD(ISO, "setObjectSprite", sdl::ISO::SetObjectSprite);
+  NODE_SET_METHOD(ISO, "removeObject", sdl::ISO::RemoveObject);
+  NODE_SET_METHOD(ISO, "draw", sdl::ISO::Draw);
+}
+
+} // sdl
@@ -0,0 +1,30 @@
+#ifndef NODE_SDL_ISO_H_
+#define NODE_SDL_ISO_H_
+
+#include <v8.h>
+#include <node.h>
+
+using namespace v8;
+
+namespace sdl {
+
+  // Layered tile maps drawn in depth order.  A map holds a grid of sprite
+  // indices per layer plus objects at fractional positions.  draw() walks
+  // only the rows and columns that can reach the target's clip rect,
+  // merging tiles and objects in (row, layer, height, column) order.
+  namespace ISO {
+    Handle<Value> CreateMap(const Arguments& args);
+    Handle<Value> FreeMap(const Arguments& args);
+    Handle<Value> SetTile(const Arguments& args);
+    Handle<Value> AddObject(const Arguments& args);
+    Handle<Value> MoveObject(const Arguments& args);
+    Handle<Value> SetObjectSprite(const Arguments& args);
+    Handle<Value> RemoveObject(const Arguments& args);
+    Handle<Value> Draw(const Arguments& args);
+  }
+
+  void ExportIso(Handle<Object> target);
+
+} // sdl
+
+#endif  // NODE_SDL_ISO_H_
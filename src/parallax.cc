@@ -0,0 +1,216 @@
+#include <v8.h>
+#include <node.h>
+#include <SDL.h>
+#include <math.h>
+#include <map>
+#include <vector>
+
+#include "helpers.h"
+#include "parallax.h"
+
+namespace sdl {
+
+struct ParallaxLayer {
+  SDL_Surface* surface;
+  double x, y;                  // where the layer's origin is with the camera at 0, 0
+  double factor_x, factor_y;    // 1 moves with the camera, 0 stays put
+  bool repeat_x, repeat_y;
+};
+
+typedef std::vector<ParallaxLayer> ParallaxSet;
+
+// Offsets and cameras are kept within this many pixels, and factors within
+// MAX_FACTOR, so that a layer's origin always fits an int.
+static const double MAX_OFFSET = 1 << 24;
+static const double MAX_FACTOR = 64;
+
+static std::map<int, ParallaxSet*> sets_;
+static int next_set_id_ = 1;
+
+static ParallaxSet* LookupSet(Handle<Value> value) {
+  std::map<int, ParallaxSet*>::iterator it = sets_.find(value->Int32Value());
+  return it == sets_.end() ? NULL : it->second;
+}
+
+static Handle<Value> ThrowNoSet(const char* name) {
+  return ThrowException(Exception::RangeError(String::Concat(String::New(name), String::New(": No such layer set"))));
+}
+
+static double NumberField(Handle<Object> obj, const char* key, double fallback) {
+  Local<Value> value = obj->Get(String::New(key));
+  return value->IsNumber() ? value->NumberValue() : fallback;
+}
+
+// Reads { surface, [x], [y], [factorX], [factorY], [repeatX], [repeatY] }.
+// Factors default to 1, offsets to 0 and repeats to false.
+static bool ParseLayer(Handle<Value> value, ParallaxLayer* layer) {
+  if (!value->IsObject()) return false;
+  Handle<Object> obj = value->ToObject();
+  Local<Value> surface = obj->Get(String::New("surface"));
+  if (!surface->IsObject()) return false;
+  layer->surface = UnwrapSurface(surface->ToObject());
+  if (!layer->surface || layer->surface->w <= 0 || layer->surface->h <= 0) return false;
+  layer->x = NumberField(obj, "x", 0);
+  layer->y = NumberField(obj, "y", 0);
+  layer->factor_x = NumberField(obj, "factorX", 1);
+  layer->factor_y = NumberField(obj, "factorY", 1);
+  layer->repeat_x = obj->Get(String::New("repeatX"))->BooleanValue();
+  layer->repeat_y = obj->Get(String::New("repeatY"))->BooleanValue();
+  return true;
+}
+
+static bool LayerInRange(const ParallaxLayer& layer) {
+  // Written so that NaNs fail too.
+  return fabs(layer.x) <= MAX_OFFSET && fabs(layer.y) <= MAX_OFFSET
+    && fabs(layer.factor_x) <= MAX_FACTOR && fabs(layer.factor_y) <= MAX_FACTOR;
+}
+
+// Every layer holds a reference to its surface.
+static void FreeSet(ParallaxSet* set) {
+  for (size_t i = 0; i < set->size(); i++) ReleaseSurface((*set)[i].surface);
+  delete set;
+}
+
+// Creates a set from an array of layers, back to front, and returns its
+// id.  The set keeps its own references to the surfaces.
+Handle<Value> PARALLAX::Create(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 1 && args[0]->IsArray())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected PARALLAX::Create(Array)")));
+  }
+
+  Handle<Array> layers = Handle<Array>::Cast(args[0]);
+  ParallaxSet* set = new ParallaxSet();
+  for (unsigned i = 0; i < layers->Length(); i++) {
+    ParallaxLayer layer;
+    if (!ParseLayer(layers->Get(i), &layer)) {
+      FreeSet(set);
+      return ThrowException(Exception::TypeError(String::New("PARALLAX::Create: Layers must be objects with a surface")));
+    }
+    if (!LayerInRange(layer)) {
+      FreeSet(set);
+      return ThrowException(Exception::RangeError(String::New("PARALLAX::Create: Layer offset or factor out of range")));
+    }
+    layer.surface->refcount++;
+    set->push_back(layer);
+  }
+
+  int id = next_set_id_++;
+  sets_[id] = set;
+  return scope.Close(Number::New(id));
+}
+
+// Replaces layer `index` of a set, or appends it when index is the length.
+Handle<Value> PARALLAX::SetLayer(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 3 && args[0]->IsNumber() && args[1]->IsNumber() && args[2]->IsObject())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected PARALLAX::SetLayer(Number, Number, Object)")));
+  }
+  ParallaxSet* set = LookupSet(args[0]);
+  if (!set) return ThrowNoSet("PARALLAX::SetLayer");
+
+  int index = args[1]->Int32Value();
+  if (index < 0 || index > (int)set->size()) {
+    return ThrowException(Exception::RangeError(String::New("PARALLAX::SetLayer: No such layer")));
+  }
+  ParallaxLayer layer;
+  if (!ParseLayer(args[2], &layer)) {
+    return ThrowException(Exception::TypeError(String::New("PARALLAX::SetLayer: Layers must be objects with a surface")));
+  }
+  if (!LayerInRange(layer)) {
+    return ThrowException(Exception::RangeError(String::New("PARALLAX::SetLayer: Layer offset or factor out of range")));
+  }
+  layer.surface->refcount++;
+  if (index == (int)set->size()) {
+    set->push_back(layer);
+  } else {
+    ReleaseSurface((*set)[index].surface);
+    (*set)[index] = layer;
+  }
+  return Undefined();
+}
+
+// First copy along one axis at or before `lo` for a layer whose origin is
+// at `origin` and which repeats every `size` pixels.
+static int FirstCopy(int origin, int lo, int size) {
+  int offset = (origin - lo) % size;
+  if (offset > 0) offset -= size;
+  return lo + offset;
+}
+
+// Draws the set's layers in order for a camera at (x, y): a layer's origin
+// lands at (x - cameraX * factorX, y - cameraY * factorY) on the target.
+// Returns the number of blits.
+Handle<Value> PARALLAX::Draw(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 4 && args[0]->IsNumber() && args[1]->IsObject() && args[2]->IsNumber() && args[3]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected PARALLAX::Draw(Number, Surface, Number, Number)")));
+  }
+  ParallaxSet* set = LookupSet(args[0]);
+  if (!set) return ThrowNoSet("PARALLAX::Draw");
+
+  SDL_Surface* dst = UnwrapSurface(args[1]->ToObject());
+  double camera_x = args[2]->NumberValue(), camera_y = args[3]->NumberValue();
+  if (!(fabs(camera_x) <= MAX_OFFSET && fabs(camera_y) <= MAX_OFFSET)) {
+    return ThrowException(Exception::RangeError(String::New("PARALLAX::Draw: Camera out of range")));
+  }
+  const SDL_Rect& clip = dst->clip_rect;
+  const int left = clip.x, top = clip.y, right = clip.x + clip.w, bottom = clip.y + clip.h;
+  int blits = 0;
+
+  for (size_t i = 0; i < set->size(); i++) {
+    const ParallaxLayer& layer = (*set)[i];
+    const int w = layer.surface->w, h = layer.surface->h;
+    int ox = (int)floor(layer.x - camera_x * layer.factor_x);
+    int oy = (int)floor(layer.y - camera_y * layer.factor_y);
+
+    int x0 = layer.repeat_x ? FirstCopy(ox, left, w) : ox;
+    int x1 = layer.repeat_x ? right : ox + 1;
+    int y0 = layer.repeat_y ? FirstCopy(oy, top, h) : oy;
+    int y1 = layer.repeat_y ? bottom : oy + 1;
+
+    for (int y = y0; y < y1; y += h) {
+      if (y >= bottom || y + h <= top) continue;
+      for (int x = x0; x < x1; x += w) {
+        if (x >= right || x + w <= left) continue;
+        // SDL clips each copy to the clip rect and writes the result back.
+        SDL_Rect to;
+        to.x = x;
+        to.y = y;
+        SDL_BlitSurface(layer.surface, NULL, dst, &to);
+        blits++;
+      }
+    }
+  }
+
+  return scope.Close(Number::New(blits));
+}
+
+Handle<Value> PARALLAX::Free(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 1 && args[0]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected PARALLAX::Free(Number)")));
+  }
+  ParallaxSet* set = LookupSet(args[0]);
+  if (!set) return Undefined();
+  sets_.erase(args[0]->Int32Value());
+  FreeSet(set);
+  return Undefined();
+}
+
+void ExportParallax(Handle<Object> target) {
+  HandleScope scope;
+
+  Local<Object> PARALLAX = Object::New();
+  target->Set(String::New("PARALLAX"), PARALLAX);
+  NODE_SET_METHOD(PARALLAX, "create", sdl::PARALLAX::Create);
+  NODE_SET_METHOD(PARALLAX, "setLayer", sdl::PARALLAX::SetLayer);
+  NODE_SET_METHOD(PARALLAX, "draw", sdl::PARALLAX::Draw);
+  NODE_SET_METHOD(PARALLAX, "free", sdl::PARALLAX::Free);
+}
+
+} // sdl
@@ -0,0 +1,25 @@
+#ifndef NODE_SDL_PARALLAX_H_
+#define NODE_SDL_PARALLAX_H_
+
+#include <v8.h>
+#include <node.h>
+
+using namespace v8;
+
+namespace sdl {
+
+  // Sets of background layers that scroll at a fraction of the camera's
+  // speed and repeat along either axis.  draw() blits every copy that
+  // reaches the target's clip rect, for all layers, in one call.
+  namespace PARALLAX {
+    Handle<Value> Create(const Arguments& args);
+    Handle<Value> SetLayer(const Arguments& args);
+    Handle<Value> Draw(const Arguments& args);
+    Handle<Value> Free(const Arguments& args);
+  }
+
+  void ExportParallax(Handle<Object> target);
+
+} // sdl
+
+#endif  // NODE_SDL_PARALLAX_H_
@@ -0,0 +1,472 @@
+#include <v8.h>
+#include <node.h>
+#include <node_buffer.h>
+#include <SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The SSSE3 kernels are built with a target attribute and chosen at run
+// time, so the default build, which doesn't pass -mssse3, still uses them on
+// CPUs that have it.
+#if (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define PIXELS_SSSE3 1
+#define SSSE3_TARGET __attribute__((target("ssse3")))
+#include <tmmintrin.h>
+#endif
+
+#include "helpers.h"
+#include "pixels.h"
+
+namespace sdl {
+
+int PixelLayoutBytes(int layout) {
+  switch (layout) {
+    case PIXEL_RGBA8888:
+    case PIXEL_BGRA8888:
+      return 4;
+    case PIXEL_RGB565:
+      return 2;
+  }
+  return 0;
+}
+
+bool ResolveSurfaceRect(SDL_Surface* surface, SDL_Rect* rect, SDL_Rect* out) {
+  if (!rect) {
+    out->x = 0;
+    out->y = 0;
+    out->w = surface->w;
+    out->h = surface->h;
+    return true;
+  }
+  if (rect->x < 0 || rect->y < 0 || rect->x + rect->w > surface->w || rect->y + rect->h > surface->h) {
+    return false;
+  }
+  *out = *rect;
+  return true;
+}
+
+static inline Uint32 LoadPixel(const Uint8* p, int bpp) {
+  switch (bpp) {
+    case 1:
+      return *p;
+    case 2:
+      return *(const Uint16*)p;
+    case 3:
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+      return (p[0] << 16) | (p[1] << 8) | p[2];
+#else
+      return p[0] | (p[1] << 8) | (p[2] << 16);
+#endif
+    default:
+      return *(const Uint32*)p;
+  }
+}
+
+static inline void StorePixel(Uint8* p, int bpp, Uint32 pixel) {
+  switch (bpp) {
+    case 1:
+      *p = pixel;
+      break;
+    case 2:
+      *(Uint16*)p = pixel;
+      break;
+    case 3:
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+      p[0] = pixel >> 16; p[1] = pixel >> 8; p[2] = pixel;
+#else
+      p[0] = pixel; p[1] = pixel >> 8; p[2] = pixel >> 16;
+#endif
+      break;
+    default:
+      *(Uint32*)p = pixel;
+      break;
+  }
+}
+
+// 32 bit formats whose channels are whole bytes convert by shuffling bytes.
+bool ByteChannels(const SDL_PixelFormat* fmt, int idx[4]) {
+  if (fmt->BytesPerPixel != 4 || fmt->Rloss || fmt->Gloss || fmt->Bloss) return false;
+  int shifts[4] = { fmt->Rshift, fmt->Gshift, fmt->Bshift, fmt->Ashift };
+  for (int c = 0; c < 4; c++) {
+    if (c == 3 && !fmt->Amask) {
+      idx[c] = -1;
+      continue;
+    }
+    if (shifts[c] % 8 || (c == 3 && fmt->Aloss)) return false;
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    idx[c] = 3 - shifts[c] / 8;
+#else
+    idx[c] = shifts[c] / 8;
+#endif
+  }
+  return true;
+}
+
+#ifdef PIXELS_SSSE3
+static bool HasSSSE3() {
+  static int has = -1;
+  if (has < 0) has = __builtin_cpu_supports("ssse3") ? 1 : 0;
+  return has != 0;
+}
+
+// Applies the 16 byte shuffle `m` to whole groups of four pixels and returns
+// how many pixels were converted.  When `alpha` is set the alpha bytes are
+// forced to 0xff afterwards.
+SSSE3_TARGET static int ShuffleRowSSSE3(const Uint8* src, Uint8* dst, int count, const char m[16], bool alpha) {
+  const __m128i mask = _mm_loadu_si128((const __m128i*)m);
+  const __m128i opaque = _mm_set1_epi32(alpha ? 0xff000000 : 0);
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i px = _mm_loadu_si128((const __m128i*)(src + i * 4));
+    px = _mm_or_si128(_mm_shuffle_epi8(px, mask), opaque);
+    _mm_storeu_si128((__m128i*)(dst + i * 4), px);
+  }
+  return i;
+}
+
+SSSE3_TARGET static int SwapRedBlueSSSE3(const Uint8* src, int count, Uint8* dst) {
+  const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i px = _mm_loadu_si128((const __m128i*)(src + i * 4));
+    _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_shuffle_epi8(px, mask));
+  }
+  return i;
+}
+
+// Eight pixels at a time: each 32 bit lane becomes its 565 value, then the
+// low halves of two registers are gathered into one.
+SSSE3_TARGET static int RGBAToRGB565SSSE3(const Uint8* rgba, int count, Uint16* dst) {
+  const __m128i red = _mm_set1_epi32(0xf800), green = _mm_set1_epi32(0x07e0), blue = _mm_set1_epi32(0x001f);
+  const __m128i lo = _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -128, -128, -128, -128, -128, -128, -128, -128);
+  const __m128i hi = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, 0, 1, 4, 5, 8, 9, 12, 13);
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i a = _mm_loadu_si128((const __m128i*)(rgba + i * 4));
+    __m128i b = _mm_loadu_si128((const __m128i*)(rgba + i * 4 + 16));
+    a = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_slli_epi32(a, 8), red),
+      _mm_and_si128(_mm_srli_epi32(a, 5), green)), _mm_and_si128(_mm_srli_epi32(a, 19), blue));
+    b = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_slli_epi32(b, 8), red),
+      _mm_and_si128(_mm_srli_epi32(b, 5), green)), _mm_and_si128(_mm_srli_epi32(b, 19), blue));
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_shuffle_epi8(a, lo), _mm_shuffle_epi8(b, hi)));
+  }
+  return i;
+}
+
+// Widens one register of four 565 values in 32 bit lanes to opaque RGBA,
+// replicating the top bits into the bottom like the scalar loop.
+SSSE3_TARGET static inline __m128i ExpandRGB565(__m128i v) {
+  const __m128i five = _mm_set1_epi32(0x1f), six = _mm_set1_epi32(0x3f);
+  __m128i r = _mm_and_si128(_mm_srli_epi32(v, 11), five);
+  __m128i g = _mm_and_si128(_mm_srli_epi32(v, 5), six);
+  __m128i b = _mm_and_si128(v, five);
+  r = _mm_or_si128(_mm_slli_epi32(r, 3), _mm_srli_epi32(r, 2));
+  g = _mm_or_si128(_mm_slli_epi32(g, 2), _mm_srli_epi32(g, 4));
+  b = _mm_or_si128(_mm_slli_epi32(b, 3), _mm_srli_epi32(b, 2));
+  return _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)),
+    _mm_or_si128(_mm_slli_epi32(b, 16), _mm_set1_epi32(0xff000000)));
+}
+
+SSSE3_TARGET static int RGB565ToRGBASSSE3(const Uint16* src, int count, Uint8* rgba) {
+  const __m128i zero = _mm_setzero_si128();
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+    _mm_storeu_si128((__m128i*)(rgba + i * 4), ExpandRGB565(_mm_unpacklo_epi16(v, zero)));
+    _mm_storeu_si128((__m128i*)(rgba + i * 4 + 16), ExpandRGB565(_mm_unpackhi_epi16(v, zero)));
+  }
+  return i;
+}
+#endif
+
+void DecodeRow(const SDL_PixelFormat* fmt, const Uint8* src, int count, Uint8* rgba) {
+  int idx[4];
+  if (ByteChannels(fmt, idx)) {
+    int i = 0;
+#ifdef PIXELS_SSSE3
+    if (HasSSSE3()) {
+      char m[16];
+      for (int p = 0; p < 4; p++) {
+        for (int c = 0; c < 4; c++) m[p * 4 + c] = idx[c] < 0 ? (char)0x80 : p * 4 + idx[c];
+      }
+      i = ShuffleRowSSSE3(src, rgba, count, m, idx[3] < 0);
+    }
+#endif
+    for (; i < count; i++) {
+      const Uint8* s = src + i * 4;
+      Uint8* d = rgba + i * 4;
+      d[0] = s[idx[0]];
+      d[1] = s[idx[1]];
+      d[2] = s[idx[2]];
+      d[3] = idx[3] < 0 ? 0xff : s[idx[3]];
+    }
+    return;
+  }
+
+  int bpp = fmt->BytesPerPixel;
+  for (int i = 0; i < count; i++) {
+    Uint8* d = rgba + i * 4;
+    SDL_GetRGBA(LoadPixel(src + i * bpp, bpp), (SDL_PixelFormat*)fmt, d, d + 1, d + 2, d + 3);
+  }
+}
+
+void EncodeRow(const SDL_PixelFormat* fmt, const Uint8* rgba, int count, Uint8* dst) {
+  int idx[4];
+  if (ByteChannels(fmt, idx)) {
+    int i = 0;
+#ifdef PIXELS_SSSE3
+    if (HasSSSE3()) {
+      char m[16];
+      for (int b = 0; b < 16; b++) m[b] = (char)0x80;
+      for (int p = 0; p < 4; p++) {
+        for (int c = 0; c < 4; c++) if (idx[c] >= 0) m[p * 4 + idx[c]] = p * 4 + c;
+      }
+      i = ShuffleRowSSSE3(rgba, dst, count, m, false);
+    }
+#endif
+    for (; i < count; i++) {
+      const Uint8* s = rgba + i * 4;
+      Uint8* d = dst + i * 4;
+      *(Uint32*)d = 0;
+      d[idx[0]] = s[0];
+      d[idx[1]] = s[1];
+      d[idx[2]] = s[2];
+      if (idx[3] >= 0) d[idx[3]] = s[3];
+    }
+    return;
+  }
+
+  int bpp = fmt->BytesPerPixel;
+  for (int i = 0; i < count; i++) {
+    const Uint8* s = rgba + i * 4;
+    StorePixel(dst + i * bpp, bpp, SDL_MapRGBA((SDL_PixelFormat*)fmt, s[0], s[1], s[2], s[3]));
+  }
+}
+
+// RGBA <-> BGRA is the same swap of bytes 0 and 2 in both directions.
+static void SwapRedBlue(const Uint8* src, int count, Uint8* dst) {
+  int i = 0;
+#ifdef PIXELS_SSSE3
+  if (HasSSSE3()) i = SwapRedBlueSSSE3(src, count, dst);
+#endif
+  for (; i < count; i++) {
+    const Uint8* s = src + i * 4;
+    Uint8* d = dst + i * 4;
+    Uint8 r = s[0];
+    d[0] = s[2];
+    d[1] = s[1];
+    d[2] = r;
+    d[3] = s[3];
+  }
+}
+
+void RGBAToLayout(int layout, const Uint8* rgba, int count, Uint8* dst) {
+  switch (layout) {
+    case PIXEL_RGBA8888:
+      if (dst != rgba) memcpy(dst, rgba, count * 4);
+      break;
+    case PIXEL_BGRA8888:
+      SwapRedBlue(rgba, count, dst);
+      break;
+    case PIXEL_RGB565: {
+      Uint16* d = (Uint16*)dst;
+      int i = 0;
+#ifdef PIXELS_SSSE3
+      if (HasSSSE3()) i = RGBAToRGB565SSSE3(rgba, count, d);
+#endif
+      for (; i < count; i++) {
+        const Uint8* s = rgba + i * 4;
+        d[i] = ((s[0] >> 3) << 11) | ((s[1] >> 2) << 5) | (s[2] >> 3);
+      }
+      break;
+    }
+  }
+}
+
+void LayoutToRGBA(int layout, const Uint8* src, int count, Uint8* rgba) {
+  switch (layout) {
+    case PIXEL_RGBA8888:
+      if (rgba != src) memcpy(rgba, src, count * 4);
+      break;
+    case PIXEL_BGRA8888:
+      SwapRedBlue(src, count, rgba);
+      break;
+    case PIXEL_RGB565: {
+      const Uint16* s = (const Uint16*)src;
+      int i = 0;
+#ifdef PIXELS_SSSE3
+      if (HasSSSE3()) i = RGB565ToRGBASSSE3(s, count, rgba);
+#endif
+      for (; i < count; i++) {
+        Uint8* d = rgba + i * 4;
+        Uint8 r = (s[i] >> 11) & 0x1f, g = (s[i] >> 5) & 0x3f, b = s[i] & 0x1f;
+        d[0] = (r << 3) | (r >> 2);
+        d[1] = (g << 2) | (g >> 4);
+        d[2] = (b << 3) | (b >> 2);
+        d[3] = 0xff;
+      }
+      break;
+    }
+  }
+}
+
+Uint8* CopySurfaceRGBA(SDL_Surface* surface) {
+  Uint8* rgba = (Uint8*)malloc((size_t)surface->w * surface->h * 4 + 1);
+  if (!rgba) {
+    SDL_OutOfMemory();
+    return NULL;
+  }
+  if (SDL_MUSTLOCK(surface) && SDL_LockSurface(surface) < 0) {
+    free(rgba);
+    return NULL;
+  }
+  for (int y = 0; y < surface->h; y++) {
+    DecodeRow(surface->format, (const Uint8*)surface->pixels + y * surface->pitch, surface->w,
+      rgba + (size_t)y * surface->w * 4);
+  }
+  if (SDL_MUSTLOCK(surface)) SDL_UnlockSurface(surface);
+  return rgba;
+}
+
+// Shared argument handling for ReadPixels/WritePixels.  Returns false after
+// throwing when the arguments don't describe a valid transfer.
+static bool PixelTransferArgs(const Arguments& args, const char* usage, SDL_Surface** surface,
+    SDL_Rect* rect, Uint8** data, int* layout, Handle<Value>* error) {
+  if (!(args.Length() == 4
+      && args[0]->IsObject()
+      && (args[1]->IsObject() || args[1]->IsNull())
+      && Buffer::HasInstance(args[2])
+      && args[3]->IsNumber()
+  )) {
+    *error = ThrowException(Exception::TypeError(String::New(usage)));
+    return false;
+  }
+
+  *surface = UnwrapSurface(args[0]->ToObject());
+  SDL_Rect r;
+  if (!ResolveSurfaceRect(*surface, ValueToRect(args[1], &r), rect)) {
+    *error = ThrowException(Exception::RangeError(String::New("Rect is outside of the surface")));
+    return false;
+  }
+
+  *layout = args[3]->Int32Value();
+  int bytes = PixelLayoutBytes(*layout);
+  if (!bytes) {
+    *error = ThrowException(Exception::RangeError(String::New("Unknown pixel format")));
+    return false;
+  }
+
+  Local<Object> buf = args[2]->ToObject();
+  if (BufferLength(buf) < (size_t)rect->w * rect->h * bytes) {
+    *error = ThrowException(Exception::RangeError(String::New("Buffer too small for rect")));
+    return false;
+  }
+  *data = (Uint8*)BufferData(buf);
+  return true;
+}
+
+// Copies a rect of the surface into a tightly packed buffer in the requested
+// layout, locking the surface once for the whole transfer.
+Handle<Value> ReadPixels(const Arguments& args) {
+  HandleScope scope;
+
+  SDL_Surface* surface;
+  SDL_Rect rect;
+  Uint8* data;
+  int layout;
+  Handle<Value> error;
+  if (!PixelTransferArgs(args, "Invalid arguments: Expected ReadPixels(Surface, Rect, Buffer, Number)",
+      &surface, &rect, &data, &layout, &error)) {
+    return error;
+  }
+  if (!rect.w || !rect.h) return Undefined();
+
+  Uint8* row = NULL;
+  if (layout != PIXEL_RGBA8888) {
+    row = (Uint8*)malloc(rect.w * 4);
+    if (!row) return ThrowException(Exception::Error(String::New("ReadPixels: Out of memory")));
+  }
+
+  if (SDL_MUSTLOCK(surface) && SDL_LockSurface(surface) < 0) {
+    free(row);
+    return ThrowSDLException(__func__);
+  }
+
+  int bpp = surface->format->BytesPerPixel;
+  int stride = rect.w * PixelLayoutBytes(layout);
+  for (int y = 0; y < rect.h; y++) {
+    const Uint8* src = (const Uint8*)surface->pixels + (rect.y + y) * surface->pitch + rect.x * bpp;
+    Uint8* dst = data + y * stride;
+    if (row) {
+      DecodeRow(surface->format, src, rect.w, row);
+      RGBAToLayout(layout, row, rect.w, dst);
+    } else {
+      DecodeRow(surface->format, src, rect.w, dst);
+    }
+  }
+
+  if (SDL_MUSTLOCK(surface)) SDL_UnlockSurface(surface);
+  free(row);
+
+  return Undefined();
+}
+
+Handle<Value> WritePixels(const Arguments& args) {
+  HandleScope scope;
+
+  SDL_Surface* surface;
+  SDL_Rect rect;
+  Uint8* data;
+  int layout;
+  Handle<Value> error;
+  if (!PixelTransferArgs(args, "Invalid arguments: Expected WritePixels(Surface, Rect, Buffer, Number)",
+      &surface, &rect, &data, &layout, &error)) {
+    return error;
+  }
+  if (!rect.w || !rect.h) return Undefined();
+
+  Uint8* row = NULL;
+  if (layout != PIXEL_RGBA8888) {
+    row = (Uint8*)malloc(rect.w * 4);
+    if (!row) return ThrowException(Exception::Error(String::New("WritePixels: Out of memory")));
+  }
+
+  if (SDL_MUSTLOCK(surface) && SDL_LockSurface(surface) < 0) {
+    free(row);
+    return ThrowSDLException(__func__);
+  }
+
+  int bpp = surface->format->BytesPerPixel;
+  int stride = rect.w * PixelLayoutBytes(layout);
+  for (int y = 0; y < rect.h; y++) {
+    const Uint8* src = data + y * stride;
+    Uint8* dst = (Uint8*)surface->pixels + (rect.y + y) * surface->pitch + rect.x * bpp;
+    if (row) {
+      LayoutToRGBA(layout, src, rect.w, row);
+      EncodeRow(surface->format, row, rect.w, dst);
+    } else {
+      EncodeRow(surface->format, src, rect.w, dst);
+    }
+  }
+
+  if (SDL_MUSTLOCK(surface)) SDL_UnlockSurface(surface);
+  free(row);
+
+  return Undefined();
+}
+
+void ExportPixels(Handle<Object> target) {
+  HandleScope scope;
+
+  NODE_SET_METHOD(target, "readPixels", ReadPixels);
+  NODE_SET_METHOD(target, "writePixels", WritePixels);
+
+  Local<Object> PIXEL = Object::New();
+  target->Set(String::New("PIXEL"), PIXEL);
+  PIXEL->Set(String::New("RGBA8888"), Number::New(PIXEL_RGBA8888));
+  PIXEL->Set(String::New("BGRA8888"), Number::New(PIXEL_BGRA8888));
+  PIXEL->Set(String::New("RGB565"), Number::New(PIXEL_RGB565));
+}
+
+} // sdl
@@ -0,0 +1,50 @@
+#ifndef NODE_SDL_PIXELS_H_
+#define NODE_SDL_PIXELS_H_
+
+#include <v8.h>
+#include <node.h>
+#include <SDL.h>
+
+using namespace v8;
+
+namespace sdl {
+
+  // Memory layouts for pixels exchanged with JS buffers.  RGBA8888 and
+  // BGRA8888 name the byte order in memory, RGB565 is a native endian Uint16.
+  enum PixelLayout {
+    PIXEL_RGBA8888 = 0,
+    PIXEL_BGRA8888 = 1,
+    PIXEL_RGB565 = 2
+  };
+
+  int PixelLayoutBytes(int layout);
+
+  // True for 32 bit formats whose channels are whole bytes, filling idx with
+  // the byte offset of R, G, B and A within a pixel (-1 when there's no alpha).
+  bool ByteChannels(const SDL_PixelFormat* fmt, int idx[4]);
+
+  // Row converters between a surface's own format and RGBA8888 bytes.  The
+  // caller is responsible for locking the surface.
+  void DecodeRow(const SDL_PixelFormat* fmt, const Uint8* src, int count, Uint8* rgba);
+  void EncodeRow(const SDL_PixelFormat* fmt, const Uint8* rgba, int count, Uint8* dst);
+
+  // Row converters between RGBA8888 bytes and the other layouts.
+  void RGBAToLayout(int layout, const Uint8* rgba, int count, Uint8* dst);
+  void LayoutToRGBA(int layout, const Uint8* src, int count, Uint8* rgba);
+
+  // Checks that rect lies within the surface; a NULL rect selects all of it.
+  bool ResolveSurfaceRect(SDL_Surface* surface, SDL_Rect* rect, SDL_Rect* out);
+
+  // Copies a whole surface into a new malloc'd RGBA8888 buffer (w * 4 bytes per
+  // row) that stays valid after the surface changes or is freed.  Returns NULL
+  // and sets the SDL error on failure.
+  Uint8* CopySurfaceRGBA(SDL_Surface* surface);
+
+  Handle<Value> ReadPixels(const Arguments& args);
+  Handle<Value> WritePixels(const Arguments& args);
+
+  void ExportPixels(Handle<Object> target);
+
+} // sdl
+
+#endif  // NODE_SDL_PIXELS_H_
@@ -0,0 +1,10 @@
+#include "probes.h"
+
+#ifdef NODE_SDL_USDT
+
+// The semaphores live in .probes, where tracers expect to find them.
+#define NODE_SDL_DEFINE_SEMAPHORE(name) \
+  unsigned short node_sdl_##name##_semaphore __attribute__((section(".probes"))) = 0;
+NODE_SDL_PROBES(NODE_SDL_DEFINE_SEMAPHORE)
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef NODE_SDL_PROBES_H_
+#define NODE_SDL_PROBES_H_
+
+#include <SDL.h>
+
+// Static tracepoints for perf, bpftrace and SystemTap (provider node_sdl).
+// They are compiled in only when NODE_SDL_USDT is defined; see README, 3.2.
+// A probe site then costs a test of its semaphore until a tracer attaches;
+// its arguments, and the clock for a *__done probe, are only evaluated while
+// something is attached to it.
+//
+//   blit__start(w, h)        blit__done(w, h, ns)        SDL.blitSurface
+//   fill__start(w, h)        fill__done(w, h, ns)        SDL.fillRect
+//   flip__start(w, h)        flip__done(w, h, ns)        SDL.flip
+//   pump__start()            pump__done(events, ns)      pollEvent, pumpEventRing
+//   decode__start(path)      decode__done(w, h, ns)      SDL.IMG.load
+//   text__start(length)      text__done(w, h, ns)        renderTextBlended, renderRichText
+//
+// Sizes are in pixels (0 when the call failed), durations in nanoseconds,
+// length is characters or spans.
+
+#ifdef NODE_SDL_USDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#include <time.h>
+
+#define NODE_SDL_PROBES(X) \
+  X(blit__start) X(blit__done) \
+  X(fill__start) X(fill__done) \
+  X(flip__start) X(flip__done) \
+  X(pump__start) X(pump__done) \
+  X(decode__start) X(decode__done) \
+  X(text__start) X(text__done)
+
+// Tracers bump a probe's semaphore while attached to it.
+#define NODE_SDL_DECLARE_SEMAPHORE(name) extern unsigned short node_sdl_##name##_semaphore;
+NODE_SDL_PROBES(NODE_SDL_DECLARE_SEMAPHORE)
+
+namespace sdl {
+  inline Uint64 ProbeNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (Uint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+  }
+}
+
+#define PROBE_TIMER(timer, done) \
+  Uint64 timer = __builtin_expect(node_sdl_##done##_semaphore != 0, 0) ? sdl::ProbeNanos() : 0
+#define PROBE0(name) STAP_PROBE(node_sdl, name)
+#define PROBE_ENABLED(name) __builtin_expect(node_sdl_##name##_semaphore != 0, 0)
+#define PROBE1(name, a) \
+  do { if (PROBE_ENABLED(name)) STAP_PROBE1(node_sdl, name, a); } while (0)
+#define PROBE2(name, a, b) \
+  do { if (PROBE_ENABLED(name)) STAP_PROBE2(node_sdl, name, a, b); } while (0)
+#define PROBE_DONE1(name, timer, a) \
+  do { if (timer) STAP_PROBE2(node_sdl, name, a, sdl::ProbeNanos() - timer); } while (0)
+#define PROBE_DONE2(name, timer, a, b) \
+  do { if (timer) STAP_PROBE3(node_sdl, name, a, b, sdl::ProbeNanos() - timer); } while (0)
+
+#else
+
+#define PROBE_TIMER(timer, done)
+#define PROBE0(name)
+#define PROBE1(name, a)
+#define PROBE2(name, a, b)
+#define PROBE_DONE1(name, timer, a)
+#define PROBE_DONE2(name, timer, a, b)
+
+#endif
+
+#endif  // NODE_SDL_PROBES_H_
@@ -0,0 +1,296 @@
+#include <v8.h>
+#include <node.h>
+#include <SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "helpers.h"
+#include "pixels.h"
+#include "quantize.h"
+
+namespace sdl {
+
+// Colors are binned at 5 bits per channel before the median cut.
+static const int QSIDE = 32;
+static const int QCELLS = QSIDE * QSIDE * QSIDE;
+
+static inline int Cell(int r, int g, int b) {
+  return ((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3);
+}
+
+static inline int Clamp8(int v) {
+  return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+struct ColorHistogram {
+  Uint32 count[QCELLS];
+  Uint64 sum[QCELLS][3];       // a flat 4096 x 4096 background overflows 32 bits
+};
+
+// Inclusive range of cells in 5 bit coordinates.
+struct ColorBox {
+  int lo[3];
+  int hi[3];
+  Uint64 count;
+};
+
+static inline int BoxCell(int* v) {
+  return (v[0] << 10) | (v[1] << 5) | v[2];
+}
+
+// Shrinks the box to the populated cells inside it and recounts.
+static void ShrinkBox(const ColorHistogram* hist, ColorBox* box) {
+  int lo[3] = { QSIDE, QSIDE, QSIDE };
+  int hi[3] = { -1, -1, -1 };
+  Uint64 count = 0;
+  int v[3];
+  for (v[0] = box->lo[0]; v[0] <= box->hi[0]; v[0]++) {
+    for (v[1] = box->lo[1]; v[1] <= box->hi[1]; v[1]++) {
+      for (v[2] = box->lo[2]; v[2] <= box->hi[2]; v[2]++) {
+        Uint32 n = hist->count[BoxCell(v)];
+        if (!n) continue;
+        count += n;
+        for (int c = 0; c < 3; c++) {
+          if (v[c] < lo[c]) lo[c] = v[c];
+          if (v[c] > hi[c]) hi[c] = v[c];
+        }
+      }
+    }
+  }
+  box->count = count;
+  if (count) {
+    memcpy(box->lo, lo, sizeof(lo));
+    memcpy(box->hi, hi, sizeof(hi));
+  }
+}
+
+// Splits box at the median of its longest axis into box and *other.
+static bool SplitBox(const ColorHistogram* hist, ColorBox* box, ColorBox* other) {
+  int axis = 0;
+  for (int c = 1; c < 3; c++) {
+    if (box->hi[c] - box->lo[c] > box->hi[axis] - box->lo[axis]) axis = c;
+  }
+  if (box->hi[axis] == box->lo[axis]) return false;
+
+  Uint64 slices[QSIDE];
+  memset(slices, 0, sizeof(slices));
+  int v[3];
+  for (v[0] = box->lo[0]; v[0] <= box->hi[0]; v[0]++) {
+    for (v[1] = box->lo[1]; v[1] <= box->hi[1]; v[1]++) {
+      for (v[2] = box->lo[2]; v[2] <= box->hi[2]; v[2]++) {
+        slices[v[axis]] += hist->count[BoxCell(v)];
+      }
+    }
+  }
+
+  Uint64 half = box->count / 2, acc = 0;
+  int cut = box->lo[axis];
+  for (; cut < box->hi[axis] - 1; cut++) {
+    acc += slices[cut];
+    if (acc >= half) break;
+  }
+
+  *other = *box;
+  box->hi[axis] = cut;
+  other->lo[axis] = cut + 1;
+  ShrinkBox(hist, box);
+  ShrinkBox(hist, other);
+  return true;
+}
+
+static int Nearest(const Palette* palette, int opaque, int r, int g, int b) {
+  int best = 0, best_dist = 0x7fffffff;
+  for (int i = 0; i < opaque; i++) {
+    const SDL_Color& c = palette->colors[i];
+    int dr = c.r - r, dg = c.g - g, db = c.b - b;
+    int dist = dr * dr * 2 + dg * dg * 4 + db * db * 3;
+    if (dist < best_dist) {
+      best_dist = dist;
+      best = i;
+    }
+  }
+  return best;
+}
+
+bool QuantizeRGBA(const Uint8* rgba, int width, int height, int max_colors, bool dither,
+    Uint8* indices, Palette* palette) {
+  if (max_colors < 2) max_colors = 2;
+  if (max_colors > 256) max_colors = 256;
+
+  ColorHistogram* hist = (ColorHistogram*)calloc(1, sizeof(ColorHistogram));
+  Sint16* lookup = (Sint16*)malloc(QCELLS * sizeof(Sint16));
+  int* errors = (int*)calloc((size_t)(width + 2) * 6, sizeof(int));
+  if (!hist || !lookup || !errors) {
+    free(hist);
+    free(lookup);
+    free(errors);
+    return false;
+  }
+
+  size_t pixels = (size_t)width * height;
+  bool transparent = false;
+  for (size_t i = 0; i < pixels; i++) {
+    const Uint8* p = rgba + i * 4;
+    if (p[3] < 128) {
+      transparent = true;
+      continue;
+    }
+    int cell = Cell(p[0], p[1], p[2]);
+    hist->count[cell]++;
+    hist->sum[cell][0] += p[0];
+    hist->sum[cell][1] += p[1];
+    hist->sum[cell][2] += p[2];
+  }
+
+  // Median cut: keep splitting the most populated box that can be split.
+  int wanted = transparent ? max_colors - 1 : max_colors;
+  ColorBox boxes[256];
+  int nboxes = 1;
+  boxes[0].lo[0] = boxes[0].lo[1] = boxes[0].lo[2] = 0;
+  boxes[0].hi[0] = boxes[0].hi[1] = boxes[0].hi[2] = QSIDE - 1;
+  ShrinkBox(hist, &boxes[0]);
+  if (!boxes[0].count) nboxes = 0;
+
+  bool splittable[256];
+  memset(splittable, 1, sizeof(splittable));
+  while (nboxes < wanted) {
+    int pick = -1;
+    for (int i = 0; i < nboxes; i++) {
+      if (splittable[i] && boxes[i].count > 1 && (pick < 0 || boxes[i].count > boxes[pick].count)) pick = i;
+    }
+    if (pick < 0) break;
+    if (!SplitBox(hist, &boxes[pick], &boxes[nboxes])) {
+      splittable[pick] = false;
+      continue;
+    }
+    nboxes++;
+  }
+
+  for (int i = 0; i < nboxes; i++) {
+    Uint64 sum[3] = { 0, 0, 0 };
+    int v[3];
+    for (v[0] = boxes[i].lo[0]; v[0] <= boxes[i].hi[0]; v[0]++) {
+      for (v[1] = boxes[i].lo[1]; v[1] <= boxes[i].hi[1]; v[1]++) {
+        for (v[2] = boxes[i].lo[2]; v[2] <= boxes[i].hi[2]; v[2]++) {
+          int cell = BoxCell(v);
+          for (int c = 0; c < 3; c++) sum[c] += hist->sum[cell][c];
+        }
+      }
+    }
+    SDL_Color& color = palette->colors[i];
+    color.r = (Uint8)(sum[0] / boxes[i].count);
+    color.g = (Uint8)(sum[1] / boxes[i].count);
+    color.b = (Uint8)(sum[2] / boxes[i].count);
+    color.unused = 0;
+  }
+  if (nboxes == 0) {
+    // Nothing opaque: keep one black entry so the palette is never empty.
+    memset(&palette->colors[0], 0, sizeof(SDL_Color));
+    nboxes = 1;
+  }
+  int opaque = nboxes;
+  palette->transparent = transparent ? opaque : -1;
+  palette->count = transparent ? opaque + 1 : opaque;
+  if (transparent) memset(&palette->colors[opaque], 0, sizeof(SDL_Color));
+
+  // Map pixels, caching the nearest palette entry per histogram cell.
+  for (int i = 0; i < QCELLS; i++) lookup[i] = -1;
+  int* cur = errors + 3;
+  int* next = errors + (width + 2) * 3 + 3;
+  for (int y = 0; y < height; y++) {
+    const Uint8* row = rgba + (size_t)y * width * 4;
+    Uint8* out = indices + (size_t)y * width;
+    for (int x = 0; x < width; x++) {
+      const Uint8* p = row + x * 4;
+      if (p[3] < 128) {
+        out[x] = palette->transparent;
+        continue;
+      }
+      int r = p[0], g = p[1], b = p[2];
+      if (dither) {
+        r = Clamp8(r + cur[x * 3] / 16);
+        g = Clamp8(g + cur[x * 3 + 1] / 16);
+        b = Clamp8(b + cur[x * 3 + 2] / 16);
+      }
+      int cell = Cell(r, g, b);
+      if (lookup[cell] < 0) {
+        lookup[cell] = Nearest(palette, opaque, (r & ~7) | 4, (g & ~7) | 4, (b & ~7) | 4);
+      }
+      int index = lookup[cell];
+      out[x] = index;
+      if (dither) {
+        const SDL_Color& c = palette->colors[index];
+        int err[3] = { r - c.r, g - c.g, b - c.b };
+        for (int k = 0; k < 3; k++) {
+          cur[(x + 1) * 3 + k] += err[k] * 7;
+          next[(x - 1) * 3 + k] += err[k] * 3;
+          next[x * 3 + k] += err[k] * 5;
+          next[(x + 1) * 3 + k] += err[k];
+        }
+      }
+    }
+    if (dither) {
+      int* tmp = cur;
+      cur = next;
+      next = tmp;
+      memset(next - 3, 0, (width + 2) * 3 * sizeof(int));
+    }
+  }
+
+  free(hist);
+  free(lookup);
+  free(errors);
+  return true;
+}
+
+// Returns a new 8 bit palettized copy of a surface with at most `colors`
+// entries.  Transparent pixels (alpha < 128) become the color key.
+Handle<Value> Quantize(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 3 && args[0]->IsObject() && args[1]->IsNumber() && args[2]->IsBoolean())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected Quantize(Surface, Number, Boolean)")));
+  }
+
+  SDL_Surface* surface = UnwrapSurface(args[0]->ToObject());
+  int colors = args[1]->Int32Value();
+  bool dither = args[2]->BooleanValue();
+
+  Uint8* rgba = CopySurfaceRGBA(surface);
+  if (!rgba) return ThrowSDLException(__func__);
+
+  SDL_Surface* result = CreateAlignedSurface(SDL_SWSURFACE, surface->w, surface->h, 8, 0, 0, 0, 0);
+  if (!result) {
+    free(rgba);
+    return ThrowSDLException(__func__);
+  }
+
+  // Rows of the result are padded, so quantize into a packed buffer first.
+  Palette palette;
+  Uint8* indices = (Uint8*)malloc((size_t)surface->w * surface->h + 1);
+  if (!indices || !QuantizeRGBA(rgba, surface->w, surface->h, colors, dither, indices, &palette)) {
+    free(rgba);
+    free(indices);
+    ReleaseSurface(result);
+    return ThrowException(Exception::Error(String::New("Quantize: Out of memory")));
+  }
+  free(rgba);
+
+  for (int y = 0; y < surface->h; y++) {
+    memcpy((Uint8*)result->pixels + y * result->pitch, indices + (size_t)y * surface->w, surface->w);
+  }
+  free(indices);
+
+  SDL_SetColors(result, palette.colors, 0, palette.count);
+  if (palette.transparent >= 0) SDL_SetColorKey(result, SDL_SRCCOLORKEY, palette.transparent);
+
+  return scope.Close(WrapSurface(result));
+}
+
+void ExportQuantize(Handle<Object> target) {
+  HandleScope scope;
+
+  NODE_SET_METHOD(target, "quantize", Quantize);
+}
+
+} // sdl
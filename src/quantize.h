@@ -0,0 +1,31 @@
+#ifndef NODE_SDL_QUANTIZE_H_
+#define NODE_SDL_QUANTIZE_H_
+
+#include <v8.h>
+#include <node.h>
+#include <SDL.h>
+
+using namespace v8;
+
+namespace sdl {
+
+  struct Palette {
+    SDL_Color colors[256];
+    int count;
+    int transparent;  // index used for pixels with alpha < 128, or -1
+  };
+
+  // Median cut quantization of a packed RGBA8888 image down to at most
+  // max_colors (2..256) entries, writing one palette index per pixel.  With
+  // dither set the mapping uses Floyd-Steinberg error diffusion.  Safe to call
+  // from any thread.  Returns false when out of memory.
+  bool QuantizeRGBA(const Uint8* rgba, int width, int height, int max_colors, bool dither,
+    Uint8* indices, Palette* palette);
+
+  Handle<Value> Quantize(const Arguments& args);
+
+  void ExportQuantize(Handle<Object> target);
+
+} // sdl
+
+#endif  // NODE_SDL_QUANTIZE_H_
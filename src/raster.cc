@@ -0,0 +1,412 @@
+#include <v8.h>
+#include <node.h>
+#include <SDL.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "helpers.h"
+#include "affine.h"
+#include "workers.h"
+#include "raster.h"
+
+namespace sdl {
+
+// Triangles are binned into bands of BIN_ROWS rows, one band per parallel
+// task, and each band walks its triangles in BLOCK x BLOCK pixel tiles.
+static const int BIN_ROWS = 32;
+static const int BLOCK = 8;
+
+// Attribute plane: value at the center of pixel (ox + x, oy + y) is
+// c + dx * x + dy * y, where (ox, oy) is the triangle's top left bound.
+struct Plane {
+  float c;
+  float dx;
+  float dy;
+};
+
+struct Triangle {
+  int minx, miny, maxx, maxy;   // inclusive pixel bounds, clipped
+  Sint64 c[3];                  // edge functions at the center of pixel (0, 0)
+  Sint64 a[3];                  // ... step per pixel in x
+  Sint64 b[3];                  // ... step per pixel in y
+  Plane z, q, uq, vq;           // depth, 1 / w, u / w, v / w
+};
+
+static void SetupPlane(Plane* plane, const double* x, const double* y, double area,
+    double a0, double a1, double a2, int ox, int oy) {
+  double dx = ((a1 - a0) * (y[2] - y[0]) - (a2 - a0) * (y[1] - y[0])) / area;
+  double dy = ((a2 - a0) * (x[1] - x[0]) - (a1 - a0) * (x[2] - x[0])) / area;
+  plane->dx = (float)dx;
+  plane->dy = (float)dy;
+  plane->c = (float)(a0 + dx * (ox + 0.5 - x[0]) + dy * (oy + 0.5 - y[0]));
+}
+
+// Snaps a triangle to 28.4 fixed point and sets up its edge functions and
+// attribute planes.  Returns false for triangles that draw nothing.
+static bool SetupTriangle(const float* v0, const float* v1, const float* v2, const SDL_Rect* clip,
+    int flags, Triangle* t) {
+  const float* v[3] = { v0, v1, v2 };
+  Sint64 X[3], Y[3];
+  for (int i = 0; i < 3; i++) {
+    // Written so that NaNs fail too.
+    if (!(fabs(v[i][0]) < 1048576.0f && fabs(v[i][1]) < 1048576.0f && v[i][3] > 0)) return false;
+    if (!(fabs(v[i][2]) < 1048576.0f && fabs(v[i][4]) < 1048576.0f && fabs(v[i][5]) < 1048576.0f)) return false;
+    X[i] = (Sint64)floor(v[i][0] * 16.0 + 0.5);
+    Y[i] = (Sint64)floor(v[i][1] * 16.0 + 0.5);
+  }
+
+  Sint64 area = (X[1] - X[0]) * (Y[2] - Y[0]) - (Y[1] - Y[0]) * (X[2] - X[0]);
+  if (area == 0) return false;
+  if (area < 0) {
+    if (flags & RASTER_CULL_BACK) return false;
+    const float* tv = v[1]; v[1] = v[2]; v[2] = tv;
+    Sint64 tx = X[1]; X[1] = X[2]; X[2] = tx;
+    Sint64 ty = Y[1]; Y[1] = Y[2]; Y[2] = ty;
+    area = -area;
+  }
+
+  Sint64 minX = X[0], maxX = X[0], minY = Y[0], maxY = Y[0];
+  for (int i = 1; i < 3; i++) {
+    if (X[i] < minX) minX = X[i];
+    if (X[i] > maxX) maxX = X[i];
+    if (Y[i] < minY) minY = Y[i];
+    if (Y[i] > maxY) maxY = Y[i];
+  }
+  t->minx = (int)(minX >> 4);
+  t->maxx = (int)(maxX >> 4);
+  t->miny = (int)(minY >> 4);
+  t->maxy = (int)(maxY >> 4);
+  if (t->minx < clip->x) t->minx = clip->x;
+  if (t->miny < clip->y) t->miny = clip->y;
+  if (t->maxx > clip->x + clip->w - 1) t->maxx = clip->x + clip->w - 1;
+  if (t->maxy > clip->y + clip->h - 1) t->maxy = clip->y + clip->h - 1;
+  if (t->minx > t->maxx || t->miny > t->maxy) return false;
+
+  // Edge k runs from vertex k to k + 1 and is positive inside.  Pixels exactly
+  // on an edge belong to the triangle only for top and left edges.
+  for (int k = 0; k < 3; k++) {
+    int n = (k + 1) % 3;
+    Sint64 dx = X[n] - X[k], dy = Y[n] - Y[k];
+    t->a[k] = -dy * 16;
+    t->b[k] = dx * 16;
+    t->c[k] = dx * (8 - Y[k]) - dy * (8 - X[k]);
+    if (!(dy < 0 || (dy == 0 && dx > 0))) t->c[k] -= 1;
+  }
+
+  double x[3], y[3], q[3];
+  for (int i = 0; i < 3; i++) {
+    x[i] = X[i] / 16.0;
+    y[i] = Y[i] / 16.0;
+    q[i] = 1.0 / v[i][3];
+  }
+  double farea = area / 256.0;
+  SetupPlane(&t->z, x, y, farea, v[0][2], v[1][2], v[2][2], t->minx, t->miny);
+  SetupPlane(&t->q, x, y, farea, q[0], q[1], q[2], t->minx, t->miny);
+  SetupPlane(&t->uq, x, y, farea, v[0][4] * q[0], v[1][4] * q[1], v[2][4] * q[2], t->minx, t->miny);
+  SetupPlane(&t->vq, x, y, farea, v[0][5] * q[0], v[1][5] * q[1], v[2][5] * q[2], t->minx, t->miny);
+  return true;
+}
+
+struct RasterJob {
+  const SampleSource* texture;
+  SDL_Surface* dst;
+  Uint16* depth;
+  int flags;
+  const Triangle* triangles;
+  const int* bin_start;         // nbands + 1 offsets into bin_items
+  const int* bin_items;
+  int band_y;                   // first row of band 0
+  int band_end;                 // one past the last row of the last band
+  Uint8* buffers;               // BLOCK * 8 bytes per worker
+};
+
+static inline int WrapCoord(int i, int size, bool wrap) {
+  if (wrap) {
+    i %= size;
+    return i < 0 ? i + size : i;
+  }
+  return i < 0 ? 0 : i >= size ? size - 1 : i;
+}
+
+static void Sample(const SampleSource* s, float u, float v, int flags, Uint8* out) {
+  bool wrap = (flags & RASTER_WRAP) != 0;
+  // Keep far off coordinates inside int range.  Interpolation can still make
+  // a NaN out of finite vertices, so these are written to catch it.
+  if (!(u >= -1e6f)) u = -1e6f;
+  if (!(u <= 1e6f)) u = 1e6f;
+  if (!(v >= -1e6f)) v = -1e6f;
+  if (!(v <= 1e6f)) v = 1e6f;
+
+  if (!(flags & RASTER_BILINEAR)) {
+    FetchSample(s, WrapCoord((int)floorf(u), s->w, wrap), WrapCoord((int)floorf(v), s->h, wrap), out);
+  } else {
+    float fu = u - 0.5f, fv = v - 0.5f;
+    int xa = (int)floorf(fu), ya = (int)floorf(fv);
+    int fx = (int)((fu - xa) * 256.0f), fy = (int)((fv - ya) * 256.0f);
+    int xb = WrapCoord(xa + 1, s->w, wrap), yb = WrapCoord(ya + 1, s->h, wrap);
+    xa = WrapCoord(xa, s->w, wrap);
+    ya = WrapCoord(ya, s->h, wrap);
+    Uint8 p[4][4];
+    FetchSample(s, xa, ya, p[0]);
+    FetchSample(s, xb, ya, p[1]);
+    FetchSample(s, xa, yb, p[2]);
+    FetchSample(s, xb, yb, p[3]);
+    BlendBilinear(p, fx, fy, out);
+  }
+  if (s->alpha != 255) out[3] = out[3] * s->alpha / 255;
+}
+
+// Shades pixel (x, y) of t into out.  Returns false if the pixel is rejected
+// by the depth test or is fully transparent.
+static inline bool ShadePixel(const RasterJob* job, const Triangle* t, int x, int y, bool blend, Uint8* out) {
+  float fx = (float)(x - t->minx), fy = (float)(y - t->miny);
+  Uint16* depth = NULL;
+  Uint16 z16 = 0;
+  if (job->depth) {
+    float z = t->z.c + t->z.dx * fx + t->z.dy * fy;
+    z16 = z >= 1 ? 0xffff : z > 0 ? (Uint16)(z * 65535.0f) : 0;
+    depth = job->depth + y * job->dst->w + x;
+    if (z16 >= *depth) return false;
+  }
+
+  float q = t->q.c + t->q.dx * fx + t->q.dy * fy;
+  if (!(q > 0)) return false;
+  float u = (t->uq.c + t->uq.dx * fx + t->uq.dy * fy) / q;
+  float v = (t->vq.c + t->vq.dx * fx + t->vq.dy * fy) / q;
+  Sample(job->texture, u, v, job->flags, out);
+  if (blend && out[3] == 0) return false;
+
+  if (depth && !(job->flags & RASTER_NO_DEPTH_WRITE)) *depth = z16;
+  return true;
+}
+
+static void RasterBand(void* ctx, int begin, int end, int worker) {
+  const RasterJob* job = (const RasterJob*)ctx;
+  Uint8* run = job->buffers + worker * BLOCK * 8;
+  Uint8* scratch = run + BLOCK * 4;
+  bool blend = job->texture->blend || job->texture->keyed;
+
+  for (int band = begin; band < end; band++) {
+    int y0 = job->band_y + band * BIN_ROWS;
+    int y1 = y0 + BIN_ROWS < job->band_end ? y0 + BIN_ROWS : job->band_end;
+
+    for (int item = job->bin_start[band]; item < job->bin_start[band + 1]; item++) {
+      const Triangle* t = job->triangles + job->bin_items[item];
+      int ty0 = t->miny > y0 ? t->miny : y0;
+      int ty1 = t->maxy + 1 < y1 ? t->maxy + 1 : y1;
+
+      for (int by = ty0 & ~(BLOCK - 1); by < ty1; by += BLOCK) {
+        int r0 = by > ty0 ? by : ty0;
+        int r1 = by + BLOCK < ty1 ? by + BLOCK : ty1;
+
+        for (int bx = t->minx & ~(BLOCK - 1); bx <= t->maxx; bx += BLOCK) {
+          int c0 = bx > t->minx ? bx : t->minx;
+          int c1 = bx + BLOCK < t->maxx + 1 ? bx + BLOCK : t->maxx + 1;
+
+          // Classify the tile against each edge from its extreme corners.
+          bool full = true, empty = false;
+          Sint64 e0[3];
+          for (int k = 0; k < 3; k++) {
+            e0[k] = t->c[k] + t->a[k] * c0 + t->b[k] * r0;
+            Sint64 sx = t->a[k] * (c1 - 1 - c0), sy = t->b[k] * (r1 - 1 - r0);
+            Sint64 hi = e0[k] + (sx > 0 ? sx : 0) + (sy > 0 ? sy : 0);
+            Sint64 lo = e0[k] + (sx < 0 ? sx : 0) + (sy < 0 ? sy : 0);
+            if (hi < 0) empty = true;
+            if (lo < 0) full = false;
+          }
+          if (empty) continue;
+
+          for (int y = r0; y < r1; y++) {
+            Sint64 e[3];
+            for (int k = 0; k < 3; k++) e[k] = e0[k] + t->b[k] * (y - r0);
+            int start = c0, n = 0;
+            for (int x = c0; x < c1; x++) {
+              bool inside = full || (e[0] >= 0 && e[1] >= 0 && e[2] >= 0);
+              e[0] += t->a[0];
+              e[1] += t->a[1];
+              e[2] += t->a[2];
+              if (inside && ShadePixel(job, t, x, y, blend, run + n * 4)) {
+                if (!n) start = x;
+                n++;
+              } else if (n) {
+                CompositeSpan(job->dst, start, y, n, run, blend, scratch);
+                n = 0;
+              }
+            }
+            if (n) CompositeSpan(job->dst, start, y, n, run, blend, scratch);
+          }
+        }
+      }
+    }
+  }
+}
+
+// Draws textured triangles from a Float32Array of vertices (MESH_VERTEX_SIZE
+// floats each) into dst.  indices is a Uint16Array or Uint32Array of vertex
+// triples, or null to take the vertices three at a time.  depth is null or a
+// Uint16Array of dst.w * dst.h values, nearer pixels being smaller.  Returns
+// the number of triangles drawn after culling and clipping.
+Handle<Value> DrawMesh(const Arguments& args) {
+  HandleScope scope;
+
+  int nfloats = 0, nindices = 0, ndepth = 0;
+  float* vertices = NULL;
+  Uint16* indices16 = NULL;
+  Uint32* indices32 = NULL;
+  Uint16* depth = NULL;
+  if (args.Length() == 6) {
+    vertices = (float*)TypedArrayData(args[2], kExternalFloatArray, &nfloats);
+    indices16 = (Uint16*)TypedArrayData(args[3], kExternalUnsignedShortArray, &nindices);
+    if (!indices16) indices32 = (Uint32*)TypedArrayData(args[3], kExternalUnsignedIntArray, &nindices);
+    depth = (Uint16*)TypedArrayData(args[4], kExternalUnsignedShortArray, &ndepth);
+  }
+  if (!(args.Length() == 6
+      && args[0]->IsObject()
+      && args[1]->IsObject()
+      && vertices
+      && (indices16 || indices32 || args[3]->IsNull())
+      && (depth || args[4]->IsNull())
+      && args[5]->IsNumber()
+  )) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected DrawMesh(Surface, Surface, Float32Array, Uint16Array, Uint16Array, Number)")));
+  }
+
+  SDL_Surface* src = UnwrapSurface(args[0]->ToObject());
+  SDL_Surface* dst = UnwrapSurface(args[1]->ToObject());
+  int flags = args[5]->Int32Value();
+  int nvertices = nfloats / MESH_VERTEX_SIZE;
+  if (!indices16 && !indices32) nindices = nvertices;
+  int ntriangles = nindices / 3;
+
+  if (depth && ndepth < dst->w * dst->h) {
+    return ThrowException(Exception::RangeError(String::New("DrawMesh: Depth buffer is smaller than the surface")));
+  }
+  for (int i = 0; i < ntriangles * 3; i++) {
+    Uint32 index = indices16 ? indices16[i] : indices32 ? indices32[i] : (Uint32)i;
+    if (index >= (Uint32)nvertices) {
+      return ThrowException(Exception::RangeError(String::New("DrawMesh: Index out of range")));
+    }
+  }
+  if (ntriangles == 0 || src->w == 0 || src->h == 0) return scope.Close(Number::New(0));
+
+  const SDL_Rect& clip = dst->clip_rect;
+  int nbands = (clip.h + BIN_ROWS - 1) / BIN_ROWS;
+  Triangle* triangles = (Triangle*)malloc(ntriangles * sizeof(Triangle));
+  int* bin_start = (int*)calloc(nbands + 2, sizeof(int));
+  Uint8* buffers = (Uint8*)malloc(WorkerCount() * BLOCK * 8);
+  if (!triangles || !bin_start || !buffers) {
+    free(triangles);
+    free(bin_start);
+    free(buffers);
+    return ThrowException(Exception::Error(String::New("DrawMesh: Out of memory")));
+  }
+
+  // Set up every triangle and count how many land in each band.
+  int drawn = 0, items = 0;
+  for (int i = 0; i < ntriangles && nbands > 0; i++) {
+    Uint32 k0 = 3 * i, k1 = 3 * i + 1, k2 = 3 * i + 2;
+    if (indices16) {
+      k0 = indices16[k0]; k1 = indices16[k1]; k2 = indices16[k2];
+    } else if (indices32) {
+      k0 = indices32[k0]; k1 = indices32[k1]; k2 = indices32[k2];
+    }
+    Triangle* t = triangles + drawn;
+    if (!SetupTriangle(vertices + k0 * MESH_VERTEX_SIZE, vertices + k1 * MESH_VERTEX_SIZE,
+        vertices + k2 * MESH_VERTEX_SIZE, &clip, flags, t)) {
+      continue;
+    }
+    int b0 = (t->miny - clip.y) / BIN_ROWS, b1 = (t->maxy - clip.y) / BIN_ROWS;
+    for (int b = b0; b <= b1; b++) bin_start[b + 2]++;
+    items += b1 - b0 + 1;
+    drawn++;
+  }
+
+  // Prefix sums, then fill the bins in draw order.
+  int* bin_items = (int*)malloc((items + 1) * sizeof(int));
+  if (!bin_items) {
+    free(triangles);
+    free(bin_start);
+    free(buffers);
+    return ThrowException(Exception::Error(String::New("DrawMesh: Out of memory")));
+  }
+  for (int b = 2; b <= nbands + 1; b++) bin_start[b] += bin_start[b - 1];
+  for (int i = 0; i < drawn; i++) {
+    int b0 = (triangles[i].miny - clip.y) / BIN_ROWS, b1 = (triangles[i].maxy - clip.y) / BIN_ROWS;
+    for (int b = b0; b <= b1; b++) bin_items[bin_start[b + 1]++] = i;
+  }
+
+  if (SDL_MUSTLOCK(src) && SDL_LockSurface(src) < 0) drawn = -1;
+  else if (SDL_MUSTLOCK(dst) && SDL_LockSurface(dst) < 0) {
+    if (SDL_MUSTLOCK(src)) SDL_UnlockSurface(src);
+    drawn = -1;
+  }
+  if (drawn < 0) {
+    free(triangles);
+    free(bin_start);
+    free(bin_items);
+    free(buffers);
+    return ThrowSDLException(__func__);
+  }
+
+  SDL_Rect all = { 0, 0, (Uint16)src->w, (Uint16)src->h };
+  SampleSource texture;
+  Uint8* copy;
+  bool ok = OpenSampleSource(src, &all, &texture, &copy);
+  if (ok && drawn) {
+    RasterJob job;
+    job.texture = &texture;
+    job.dst = dst;
+    job.depth = depth;
+    job.flags = flags;
+    job.triangles = triangles;
+    job.bin_start = bin_start;
+    job.bin_items = bin_items;
+    job.band_y = clip.y;
+    job.band_end = clip.y + clip.h;
+    job.buffers = buffers;
+    ParallelFor(nbands, 1, RasterBand, &job);
+  }
+
+  if (SDL_MUSTLOCK(dst)) SDL_UnlockSurface(dst);
+  if (SDL_MUSTLOCK(src)) SDL_UnlockSurface(src);
+  free(copy);
+  free(triangles);
+  free(bin_start);
+  free(bin_items);
+  free(buffers);
+  if (!ok) return ThrowException(Exception::Error(String::New("DrawMesh: Out of memory")));
+
+  return scope.Close(Number::New(drawn));
+}
+
+// Resets every entry of a depth buffer to the far plane.
+Handle<Value> ClearDepth(const Arguments& args) {
+  HandleScope scope;
+
+  int length = 0;
+  Uint16* depth = args.Length() == 1 ? (Uint16*)TypedArrayData(args[0], kExternalUnsignedShortArray, &length) : NULL;
+  if (!depth) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected ClearDepth(Uint16Array)")));
+  }
+
+  memset(depth, 0xff, length * sizeof(Uint16));
+  return Undefined();
+}
+
+void ExportRaster(Handle<Object> target) {
+  HandleScope scope;
+
+  NODE_SET_METHOD(target, "drawMesh", DrawMesh);
+  NODE_SET_METHOD(target, "clearDepth", ClearDepth);
+
+  Local<Object> RASTER = Object::New();
+  target->Set(String::New("RASTER"), RASTER);
+  RASTER->Set(String::New("VERTEX_SIZE"), Number::New(MESH_VERTEX_SIZE));
+  RASTER->Set(String::New("CULL_BACK"), Number::New(RASTER_CULL_BACK));
+  RASTER->Set(String::New("BILINEAR"), Number::New(RASTER_BILINEAR));
+  RASTER->Set(String::New("WRAP"), Number::New(RASTER_WRAP));
+  RASTER->Set(String::New("NO_DEPTH_WRITE"), Number::New(RASTER_NO_DEPTH_WRITE));
+}
+
+} // sdl
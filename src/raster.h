@@ -0,0 +1,30 @@
+#ifndef NODE_SDL_RASTER_H_
+#define NODE_SDL_RASTER_H_
+
+#include <v8.h>
+#include <node.h>
+
+using namespace v8;
+
+namespace sdl {
+
+  // Floats per vertex in a mesh: x, y (destination pixels), z (0 near .. 1
+  // far, for the depth buffer), w (positive view depth, divides u and v for
+  // perspective correction), u, v (texels).
+  const int MESH_VERTEX_SIZE = 6;
+
+  enum RasterFlags {
+    RASTER_CULL_BACK = 1,       // skip triangles wound counter clockwise on screen
+    RASTER_BILINEAR = 2,
+    RASTER_WRAP = 4,            // repeat the texture instead of clamping
+    RASTER_NO_DEPTH_WRITE = 8   // test against the depth buffer without updating it
+  };
+
+  Handle<Value> DrawMesh(const Arguments& args);
+  Handle<Value> ClearDepth(const Arguments& args);
+
+  void ExportRaster(Handle<Object> target);
+
+} // sdl
+
+#endif  // NODE_SDL_RASTER_H_
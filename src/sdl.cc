@@ -28,6 +28,11 @@ init(Handle<Object> target)
   NODE_SET_METHOD(target, "setError", sdl::SetError);
   NODE_SET_METHOD(target, "waitEvent", sdl::WaitEvent);
   NODE_SET_METHOD(target, "pollEvent", sdl::PollEvent);
+  NODE_SET_METHOD(target, "pushEvent", sdl::PushEvent);
+  NODE_SET_METHOD(target, "enableUNICODE", sdl::EnableUNICODE);
+  NODE_SET_METHOD(target, "enableKeyRepeat", sdl::EnableKeyRepeat);
+  NODE_SET_METHOD(target, "startTextInput", sdl::StartTextInput);
+  NODE_SET_METHOD(target, "stopTextInput", sdl::StopTextInput);
   NODE_SET_METHOD(target, "setVideoMode", sdl::SetVideoMode);
   NODE_SET_METHOD(target, "videoModeOK", sdl::VideoModeOK);
   NODE_SET_METHOD(target, "numJoysticks", sdl::NumJoysticks);
@@ -57,6 +62,21 @@ init(Handle<Object> target)
   NODE_SET_METHOD(target, "getRGBA", sdl::GetRGBA);
   NODE_SET_METHOD(target, "setClipRect",sdl::SetClipRect);
 
+  sdl::ExportEventRing(target);
+  sdl::ExportPixels(target);
+  sdl::ExportStats(target);
+  sdl::ExportQuantize(target);
+  sdl::ExportGIF(target);
+  sdl::ExportAffine(target);
+  sdl::ExportRaster(target);
+  sdl::ExportAudio(target);
+  sdl::ExportAllocTracking(target);
+  sdl::ExportInject(target);
+  sdl::ExportAssets(target);
+  sdl::ExportTaskGraph(target);
+  sdl::ExportIso(target);
+  sdl::ExportParallax(target);
+
   Local<Object> INIT = Object::New();
   target->Set(String::New("INIT"), INIT);
   INIT->Set(String::New("TIMER"), Number::New(SDL_INIT_TIMER));
@@ -66,6 +86,9 @@ init(Handle<Object> target)
   INIT->Set(String::New("EVERYTHING"), Number::New(SDL_INIT_EVERYTHING));
   INIT->Set(String::New("NOPARACHUTE"), Number::New(SDL_INIT_NOPARACHUTE));
 
+  target->Set(String::New("DEFAULT_REPEAT_DELAY"), Number::New(SDL_DEFAULT_REPEAT_DELAY));
+  target->Set(String::New("DEFAULT_REPEAT_INTERVAL"), Number::New(SDL_DEFAULT_REPEAT_INTERVAL));
+
   Local<Object> SURFACE = Object::New();
   target->Set(String::New("SURFACE"), SURFACE);
   SURFACE->Set(String::New("ANYFORMAT"), Number::New(SDL_ANYFORMAT));
@@ -88,11 +111,27 @@ init(Handle<Object> target)
   NODE_SET_METHOD(TTF, "init", sdl::TTF::Init);
   NODE_SET_METHOD(TTF, "openFont", sdl::TTF::OpenFont);
   NODE_SET_METHOD(TTF, "renderTextBlended", sdl::TTF::RenderTextBlended);
+  NODE_SET_METHOD(TTF, "createFontChain", sdl::TTF::CreateFontChain);
+  NODE_SET_METHOD(TTF, "sizeText", sdl::TTF::SizeText);
+  NODE_SET_METHOD(TTF, "renderRichText", sdl::TTF::RenderRichText);
+  NODE_SET_METHOD(TTF, "sizeRichText", sdl::TTF::SizeRichText);
+  NODE_SET_METHOD(TTF, "setGlyphCacheDir", sdl::TTF::SetGlyphCacheDir);
+  NODE_SET_METHOD(TTF, "saveGlyphCache", sdl::TTF::SaveGlyphCache);
 
   Local<Object> IMG = Object::New();
   target->Set(String::New("IMG"), IMG);
 
+  NODE_SET_METHOD(IMG, "init", sdl::IMG::Init);
+  NODE_SET_METHOD(IMG, "quit", sdl::IMG::Quit);
   NODE_SET_METHOD(IMG, "load", sdl::IMG::Load);
+  NODE_SET_METHOD(IMG, "loadAsync", sdl::IMG::LoadAsync);
+  NODE_SET_METHOD(IMG, "loadBatch", sdl::IMG::LoadBatch);
+
+  Local<Object> IMG_INIT = Object::New();
+  IMG->Set(String::New("INIT"), IMG_INIT);
+  IMG_INIT->Set(String::New("JPG"), Number::New(IMG_INIT_JPG));
+  IMG_INIT->Set(String::New("PNG"), Number::New(IMG_INIT_PNG));
+  IMG_INIT->Set(String::New("TIF"), Number::New(IMG_INIT_TIF));
 
   Local<Object> WM = Object::New();
   target->Set(String::New("WM"), WM);
@@ -241,6 +280,7 @@ Handle<Value> sdl::GetError(const Arguments& args) {
     return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected GetError()")));
   }
 
+  TrackAlloc(ALLOC_GET_ERROR, 0, 1);
   return String::New(SDL_GetError());
 }
 
@@ -269,14 +309,18 @@ static int sdl::EIO_OnEvent(eio_req *req) {
   sdl::closure_t *closure = (sdl::closure_t *) req->data;
   ev_unref(EV_DEFAULT_UC);
 
-  Handle<Value> argv[1];
+  // The worker only waits; the event is taken off the queue here, the same
+  // way pollEvent takes it, so text input is merged for waitEvent too.
+  Handle<Value> argv[2];
   if (closure->status == 0) {
     argv[0] = MakeSDLException("WaitEvent");
+    argv[1] = Undefined();
   } else {
     argv[0] = Undefined();
+    argv[1] = NextEvent();
   }
 
-  closure->fn->Call(Context::GetCurrent()->Global(), 1, argv);
+  closure->fn->Call(Context::GetCurrent()->Global(), 2, argv);
 
   closure->fn.Dispose();
   free(closure);
@@ -299,6 +343,123 @@ static Handle<Value> sdl::WaitEvent(const Arguments& args) {
 
 
 
+// Text input mode.  While enabled, runs of queued character key presses (and
+// the releases of those keys) are collapsed into a single TEXTINPUT event so a
+// frame's worth of typing reaches JS as one string.
+static bool text_input_ = false;
+static int unicode_before_text_input_ = 0;
+static bool text_keys_down_[SDLK_LAST];
+
+static bool IsTextKeyDown(const SDL_Event& event) {
+  if (event.type != SDL_KEYDOWN) return false;
+  Uint16 ch = event.key.keysym.unicode;
+  return ch >= 0x20 && ch != 0x7f;
+}
+
+static bool IsTextKeyUp(const SDL_Event& event) {
+  return event.type == SDL_KEYUP && text_keys_down_[event.key.keysym.sym];
+}
+
+static Handle<Value> sdl::EnableUNICODE(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 1 && args[0]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected EnableUNICODE(Number)")));
+  }
+
+  return Number::New(SDL_EnableUNICODE(args[0]->Int32Value()));
+}
+
+static Handle<Value> sdl::EnableKeyRepeat(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 2 && args[0]->IsNumber() && args[1]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected EnableKeyRepeat(Number, Number)")));
+  }
+
+  if (SDL_EnableKeyRepeat(args[0]->Int32Value(), args[1]->Int32Value()) < 0) return ThrowSDLException(__func__);
+
+  return Undefined();
+}
+
+static Handle<Value> sdl::StartTextInput(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 0)) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected StartTextInput()")));
+  }
+
+  if (!text_input_) {
+    unicode_before_text_input_ = SDL_EnableUNICODE(1);
+    memset(text_keys_down_, 0, sizeof(text_keys_down_));
+    text_input_ = true;
+  }
+
+  return Undefined();
+}
+
+static Handle<Value> sdl::StopTextInput(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 0)) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected StopTextInput()")));
+  }
+
+  if (text_input_) {
+    SDL_EnableUNICODE(unicode_before_text_input_);
+    text_input_ = false;
+  }
+
+  return Undefined();
+}
+
+// Consumes the character key events at the head of the queue, starting with
+// the already polled `event`, and returns them as one TEXTINPUT string.
+static Local<Object> CollectTextInput(SDL_Event& event) {
+  HandleScope scope;
+
+  uint16_t text[256];
+  int length = 0;
+
+  for (;;) {
+    if (event.type == SDL_KEYDOWN) {
+      text_keys_down_[event.key.keysym.sym] = true;
+      text[length++] = event.key.keysym.unicode;
+    } else {
+      text_keys_down_[event.key.keysym.sym] = false;
+    }
+
+    if (length == (int)(sizeof(text) / sizeof(text[0]))) break;
+    SDL_PumpEvents();
+    if (SDL_PeepEvents(&event, 1, SDL_PEEKEVENT, SDL_ALLEVENTS) <= 0) break;
+    if (!(IsTextKeyDown(event) || IsTextKeyUp(event))) break;
+    SDL_PeepEvents(&event, 1, SDL_GETEVENT, SDL_ALLEVENTS);
+  }
+
+  sdl::TrackAlloc(sdl::ALLOC_POLL_EVENT, 1, 4);
+  Local<Object> evt = Object::New();
+  evt->Set(String::New("type"), String::New("TEXTINPUT"));
+  evt->Set(String::New("text"), String::New(text, length));
+  return scope.Close(evt);
+}
+
+// Strings PollEvent creates for an event: the type name plus a key per field.
+static int EventStrings(const SDL_Event& event) {
+  switch (event.type) {
+    case SDL_ACTIVEEVENT: return 4;
+    case SDL_KEYDOWN: case SDL_KEYUP: return 6;
+    case SDL_MOUSEMOTION: return 8;
+    case SDL_MOUSEBUTTONDOWN: case SDL_MOUSEBUTTONUP: return 6;
+    case SDL_JOYAXISMOTION: return 5;
+    case SDL_JOYBALLMOTION: return 6;
+    case SDL_JOYHATMOTION: return 5;
+    case SDL_JOYBUTTONDOWN: case SDL_JOYBUTTONUP: return 4;
+    case SDL_QUIT: return 2;
+    case SDL_USEREVENT: return 3;
+    default: return 3;
+  }
+}
+
 Handle<Value> sdl::PollEvent(const Arguments& args) {
   HandleScope scope;
 
@@ -306,11 +467,33 @@ Handle<Value> sdl::PollEvent(const Arguments& args) {
     return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected PollEvent()")));
   }
 
+  return scope.Close(NextEvent());
+}
+
+// Takes the next event off the queue and converts it, or returns undefined
+// when there is none.  Used by pollEvent and waitEvent.
+static Handle<Value> sdl::NextEvent() {
+  HandleScope scope;
+
+  PROBE0(pump__start);
+  PROBE_TIMER(timer, pump__done);
   SDL_Event event;
-  if (!SDL_PollEvent(&event)) {
+  int polled = SDL_PollEvent(&event);
+  PROBE_DONE1(pump__done, timer, polled);
+  if (!polled) {
     return Undefined();
   }
 
+  if (text_input_) {
+    // A lone release of a character key carries no text, drop it.
+    while (IsTextKeyUp(event)) {
+      text_keys_down_[event.key.keysym.sym] = false;
+      if (!SDL_PollEvent(&event)) return Undefined();
+    }
+    if (IsTextKeyDown(event)) return scope.Close(CollectTextInput(event));
+  }
+
+  TrackAlloc(ALLOC_POLL_EVENT, 1, EventStrings(event));
   Local<Object> evt = Object::New();
 
   switch (event.type) {
@@ -325,6 +508,7 @@ Handle<Value> sdl::PollEvent(const Arguments& args) {
       evt->Set(String::New("scancode"), Number::New(event.key.keysym.scancode));
       evt->Set(String::New("sym"), Number::New(event.key.keysym.sym));
       evt->Set(String::New("mod"), Number::New(event.key.keysym.mod));
+      evt->Set(String::New("unicode"), Number::New(event.key.keysym.unicode));
       break;
     case SDL_MOUSEMOTION:
       evt->Set(String::New("type"), String::New("MOUSEMOTION"));
@@ -371,6 +555,10 @@ Handle<Value> sdl::PollEvent(const Arguments& args) {
     case SDL_QUIT:
       evt->Set(String::New("type"), String::New("QUIT"));
       break;
+    case SDL_USEREVENT:
+      evt->Set(String::New("type"), String::New("USEREVENT"));
+      evt->Set(String::New("code"), Number::New(event.user.code));
+      break;
     default:
       evt->Set(String::New("type"), String::New("UNKNOWN"));
       evt->Set(String::New("typeCode"), Number::New(event.type));
@@ -380,6 +568,87 @@ Handle<Value> sdl::PollEvent(const Arguments& args) {
   return scope.Close(evt);
 }
 
+static int EventField(Handle<Object> evt, const char* key) {
+  return evt->Get(String::New(key))->Int32Value();
+}
+
+// Takes an object shaped like the ones pollEvent returns and queues it as if
+// it came from the device, for scripted input.
+Handle<Value> sdl::PushEvent(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 1 && args[0]->IsObject())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected PushEvent(Object)")));
+  }
+
+  Local<Object> evt = args[0]->ToObject();
+  String::Utf8Value type(evt->Get(String::New("type")));
+  SDL_Event event;
+  memset(&event, 0, sizeof(event));
+
+  if (!strcmp(*type, "ACTIVEEVENT")) {
+    event.type = SDL_ACTIVEEVENT;
+    event.active.gain = evt->Get(String::New("gain"))->BooleanValue();
+    event.active.state = EventField(evt, "state");
+  } else if (!strcmp(*type, "KEYDOWN") || !strcmp(*type, "KEYUP")) {
+    bool down = !strcmp(*type, "KEYDOWN");
+    event.type = down ? SDL_KEYDOWN : SDL_KEYUP;
+    event.key.state = down ? SDL_PRESSED : SDL_RELEASED;
+    event.key.keysym.scancode = EventField(evt, "scancode");
+    event.key.keysym.sym = (SDLKey)EventField(evt, "sym");
+    event.key.keysym.mod = (SDLMod)EventField(evt, "mod");
+    event.key.keysym.unicode = EventField(evt, "unicode");
+  } else if (!strcmp(*type, "MOUSEMOTION")) {
+    event.type = SDL_MOUSEMOTION;
+    event.motion.state = EventField(evt, "state");
+    event.motion.which = EventField(evt, "which");
+    event.motion.x = EventField(evt, "x");
+    event.motion.y = EventField(evt, "y");
+    event.motion.xrel = EventField(evt, "xrel");
+    event.motion.yrel = EventField(evt, "yrel");
+  } else if (!strcmp(*type, "MOUSEBUTTONDOWN") || !strcmp(*type, "MOUSEBUTTONUP")) {
+    bool down = !strcmp(*type, "MOUSEBUTTONDOWN");
+    event.type = down ? SDL_MOUSEBUTTONDOWN : SDL_MOUSEBUTTONUP;
+    event.button.state = down ? SDL_PRESSED : SDL_RELEASED;
+    event.button.button = EventField(evt, "button");
+    event.button.which = EventField(evt, "which");
+    event.button.x = EventField(evt, "x");
+    event.button.y = EventField(evt, "y");
+  } else if (!strcmp(*type, "JOYAXISMOTION")) {
+    event.type = SDL_JOYAXISMOTION;
+    event.jaxis.which = EventField(evt, "which");
+    event.jaxis.axis = EventField(evt, "axis");
+    event.jaxis.value = EventField(evt, "value");
+  } else if (!strcmp(*type, "JOYBALLMOTION")) {
+    event.type = SDL_JOYBALLMOTION;
+    event.jball.which = EventField(evt, "which");
+    event.jball.ball = EventField(evt, "ball");
+    event.jball.xrel = EventField(evt, "xrel");
+    event.jball.yrel = EventField(evt, "yrel");
+  } else if (!strcmp(*type, "JOYHATMOTION")) {
+    event.type = SDL_JOYHATMOTION;
+    event.jhat.which = EventField(evt, "which");
+    event.jhat.hat = EventField(evt, "hat");
+    event.jhat.value = EventField(evt, "value");
+  } else if (!strcmp(*type, "JOYBUTTONDOWN") || !strcmp(*type, "JOYBUTTONUP")) {
+    bool down = !strcmp(*type, "JOYBUTTONDOWN");
+    event.type = down ? SDL_JOYBUTTONDOWN : SDL_JOYBUTTONUP;
+    event.jbutton.state = down ? SDL_PRESSED : SDL_RELEASED;
+    event.jbutton.which = EventField(evt, "which");
+    event.jbutton.button = EventField(evt, "button");
+  } else if (!strcmp(*type, "QUIT")) {
+    event.type = SDL_QUIT;
+  } else if (!strcmp(*type, "USEREVENT")) {
+    event.type = SDL_USEREVENT;
+    event.user.code = EventField(evt, "code");
+  } else {
+    return ThrowException(Exception::TypeError(String::New("PushEvent: Unknown event type")));
+  }
+
+  if (SDL_PushEvent(&event) < 0) return ThrowSDLException(__func__);
+  return Undefined();
+}
+
 static Handle<Value> sdl::SetVideoMode(const Arguments& args) {
   HandleScope scope;
 
@@ -452,6 +721,7 @@ static Handle<Value> sdl::JoystickName(const Arguments& args) {
     return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected JoystickName(Number)")));
   }
 
+  TrackAlloc(ALLOC_JOYSTICK_NAME, 0, 1);
   return String::New(SDL_JoystickName(args[0]->Int32Value()));
 }
 
@@ -541,7 +811,11 @@ static Handle<Value> sdl::Flip(const Arguments& args) {
     return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected Flip(Surface)")));
   }
 
-  SDL_Flip(UnwrapSurface(args[0]->ToObject()));
+  SDL_Surface* screen = UnwrapSurface(args[0]->ToObject());
+  PROBE2(flip__start, screen->w, screen->h);
+  PROBE_TIMER(timer, flip__done);
+  SDL_Flip(screen);
+  PROBE_DONE2(flip__done, timer, screen->w, screen->h);
 
   return Undefined();
 }
@@ -564,6 +838,7 @@ static Handle<Value> sdl::FillRect(const Arguments& args) {
   } else if (args[1]->IsArray()) {
     SDL_Rect r;
     Handle<Object> arr = args[1]->ToObject();
+    TrackAlloc(ALLOC_RECT_ARRAY, 0, 4);
     r.x = arr->Get(String::New("0"))->Int32Value();
     r.y = arr->Get(String::New("1"))->Int32Value();
     r.w = arr->Get(String::New("2"))->Int32Value();
@@ -574,7 +849,10 @@ static Handle<Value> sdl::FillRect(const Arguments& args) {
   }
   int color = args[2]->Int32Value();
 
+  PROBE2(fill__start, rect ? rect->w : surface->w, rect ? rect->h : surface->h);
+  PROBE_TIMER(timer, fill__done);
   if (SDL_FillRect (surface, rect, color) < 0) return ThrowSDLException(__func__);
+  PROBE_DONE2(fill__done, timer, rect ? rect->w : surface->w, rect ? rect->h : surface->h);
 
   return Undefined();
 }
@@ -596,6 +874,7 @@ static Handle<Value> sdl::UpdateRect(const Arguments& args) {
   } else if (args[1]->IsArray()) {
     SDL_Rect r;
     Handle<Object> arr = args[1]->ToObject();
+    TrackAlloc(ALLOC_RECT_ARRAY, 0, 4);
     r.x = arr->Get(String::New("0"))->Int32Value();
     r.y = arr->Get(String::New("1"))->Int32Value();
     r.w = arr->Get(String::New("2"))->Int32Value();
@@ -614,13 +893,15 @@ static Handle<Value> sdl::UpdateRect(const Arguments& args) {
 static Handle<Value> sdl::CreateRGBSurface(const Arguments& args) {
   HandleScope scope;
 
-  if (!(args.Length() == 3 && args[0]->IsNumber() && args[1]->IsNumber() && args[2]->IsNumber())) {
-    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected CreateRGBSurface(Number, Number, Number)")));
+  if (!((args.Length() == 3 || (args.Length() == 4 && args[3]->IsBoolean()))
+      && args[0]->IsNumber() && args[1]->IsNumber() && args[2]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected CreateRGBSurface(Number, Number, Number, [Boolean])")));
   }
 
   int flags = args[0]->Int32Value();
   int width = args[1]->Int32Value();
   int height = args[2]->Int32Value();
+  bool aligned = args.Length() < 4 || args[3]->BooleanValue();
 
   SDL_Surface *surface;
   int rmask, gmask, bmask, amask;
@@ -639,7 +920,11 @@ static Handle<Value> sdl::CreateRGBSurface(const Arguments& args) {
   amask = 0xff000000;
 #endif
 
-  surface = SDL_CreateRGBSurface(flags, width, height, 32, rmask, gmask, bmask, amask);
+  if (aligned) {
+    surface = CreateAlignedSurface(flags, width, height, 32, rmask, gmask, bmask, amask);
+  } else {
+    surface = SDL_CreateRGBSurface(flags, width, height, 32, rmask, gmask, bmask, amask);
+  }
   if (surface == NULL) return ThrowSDLException(__func__);
   return scope.Close(WrapSurface(surface));
 }
@@ -659,33 +944,9 @@ static Handle<Value> sdl::BlitSurface(const Arguments& args) {
   SDL_Surface* src = UnwrapSurface(args[0]->ToObject());
   SDL_Surface* dst = UnwrapSurface(args[2]->ToObject());
 
-  SDL_Rect* srcrect;
-  if (args[1]->IsNull()) {
-    srcrect = NULL;
-  } else if (args[1]->IsArray()) {
-    Handle<Object> arr1 = args[1]->ToObject();
-    srcrect = new SDL_Rect();
-    srcrect->x = arr1->Get(String::New("0"))->Int32Value();
-    srcrect->y = arr1->Get(String::New("1"))->Int32Value();
-    srcrect->w = arr1->Get(String::New("2"))->Int32Value();
-    srcrect->h = arr1->Get(String::New("3"))->Int32Value();
-  } else {
-    srcrect = UnwrapRect(args[1]->ToObject());
-  }
-
-  SDL_Rect* dstrect;
-  if (args[3]->IsNull()) {
-    dstrect = NULL;
-  } else if (args[3]->IsArray()) {
-    Handle<Object> arr2 = args[3]->ToObject();
-    dstrect = new SDL_Rect();
-    dstrect->x = arr2->Get(String::New("0"))->Int32Value();
-    dstrect->y = arr2->Get(String::New("1"))->Int32Value();
-    dstrect->w = arr2->Get(String::New("2"))->Int32Value();
-    dstrect->h = arr2->Get(String::New("3"))->Int32Value();
-  } else {
-    dstrect = UnwrapRect(args[3]->ToObject());
-  }
+  SDL_Rect src_storage, dst_storage;
+  SDL_Rect* srcrect = ValueToRect(args[1], &src_storage);
+  SDL_Rect* dstrect = ValueToRect(args[3], &dst_storage);
 
 //  if (srcrect) printf("srcrect = {x: %d, y: %d, w: %d, h: %d}\n", srcrect->x, srcrect->y, srcrect->w, srcrect->h);
 //  else printf("srcrect = null\n");
@@ -693,7 +954,10 @@ static Handle<Value> sdl::BlitSurface(const Arguments& args) {
 //  else printf("dstrect = null\n");
 
 
+  PROBE2(blit__start, srcrect ? srcrect->w : src->w, srcrect ? srcrect->h : src->h);
+  PROBE_TIMER(timer, blit__done);
   if (SDL_BlitSurface(src, srcrect, dst, dstrect) < 0) return ThrowSDLException(__func__);
+  PROBE_DONE2(blit__done, timer, srcrect ? srcrect->w : src->w, srcrect ? srcrect->h : src->h);
   return Undefined();
 }
 
@@ -705,7 +969,9 @@ static Handle<Value> sdl::FreeSurface(const Arguments& args) {
   }
 
   // TODO: find a way to do this automatically by using GC hooks.  This is dangerous in JS land
-  SDL_FreeSurface(UnwrapSurface(args[0]->ToObject()));
+  SDL_Surface* surface = UnwrapSurface(args[0]->ToObject());
+  ForgetSurface(surface);
+  ReleaseSurface(surface);
   args[0]->ToObject()->Set(String::New("DEAD"), Boolean::New(true));
 
   return Undefined();
@@ -736,8 +1002,18 @@ static Handle<Value> sdl::DisplayFormat(const Arguments& args) {
   }
 
   SDL_Surface* surface = UnwrapSurface(args[0]->ToObject());
+  SDL_Surface* screen = SDL_GetVideoSurface();
+  if (!screen) {
+    SDL_SetError("No video mode has been set");
+    return ThrowSDLException(__func__);
+  }
 
-  return scope.Close(WrapSurface(SDL_DisplayFormat(surface)));
+  // The flags SDL_DisplayFormat converts with.
+  Uint32 flags = (screen->flags & SDL_HWSURFACE)
+    | (surface->flags & (SDL_SRCCOLORKEY | SDL_SRCALPHA | SDL_RLEACCELOK));
+  SDL_Surface* result = ConvertAlignedSurface(surface, screen->format, flags);
+  if (!result) return ThrowSDLException(__func__);
+  return scope.Close(WrapSurface(result));
 }
 
 static Handle<Value> sdl::DisplayFormatAlpha(const Arguments& args) {
@@ -748,8 +1024,31 @@ static Handle<Value> sdl::DisplayFormatAlpha(const Arguments& args) {
   }
 
   SDL_Surface* surface = UnwrapSurface(args[0]->ToObject());
+  SDL_Surface* screen = SDL_GetVideoSurface();
+  if (!screen) {
+    SDL_SetError("No video mode has been set");
+    return ThrowSDLException(__func__);
+  }
+
+  // 32 bit ARGB, or ABGR on a BGR screen, as SDL_DisplayFormatAlpha picks.
+  SDL_PixelFormat* vf = screen->format;
+  SDL_PixelFormat format;
+  memset(&format, 0, sizeof(format));
+  format.BitsPerPixel = 32;
+  format.BytesPerPixel = 4;
+  format.Rmask = 0x00ff0000;
+  format.Gmask = 0x0000ff00;
+  format.Bmask = 0x000000ff;
+  format.Amask = 0xff000000;
+  if (vf->BytesPerPixel > 2 && vf->Rmask == 0x000000ff && vf->Bmask == 0x00ff0000) {
+    format.Rmask = 0x000000ff;
+    format.Bmask = 0x00ff0000;
+  }
 
-  return scope.Close(WrapSurface(SDL_DisplayFormatAlpha(surface)));
+  Uint32 flags = (screen->flags & SDL_HWSURFACE) | (surface->flags & (SDL_SRCALPHA | SDL_RLEACCELOK));
+  SDL_Surface* result = ConvertAlignedSurface(surface, &format, flags);
+  if (!result) return ThrowSDLException(__func__);
+  return scope.Close(WrapSurface(result));
 }
 
 static Handle<Value> sdl::SetAlpha(const Arguments& args) {
@@ -812,6 +1111,7 @@ static Handle<Value> sdl::GetRGB(const Arguments& args) {
 
   SDL_GetRGB(pixel, fmt, &r, &g, &b);
 
+  TrackAlloc(ALLOC_GET_RGB, 1, 3);
   Local<Object> rgb = Object::New();
   rgb->Set(String::New("r"), Number::New(r));
   rgb->Set(String::New("g"), Number::New(g));
@@ -833,6 +1133,7 @@ static Handle<Value> sdl::GetRGBA(const Arguments& args) {
 
   SDL_GetRGBA(pixel, fmt, &r, &g, &b, &a);
 
+  TrackAlloc(ALLOC_GET_RGBA, 1, 4);
   Local<Object> rgba = Object::New();
   rgba->Set(String::New("r"), Number::New(r));
   rgba->Set(String::New("g"), Number::New(g));
@@ -857,6 +1158,7 @@ static Handle<Value> sdl::SetClipRect(const Arguments& args) {
   } else if (args[1]->IsArray()) {
     SDL_Rect r;
     Handle<Object> arr = args[1]->ToObject();
+    TrackAlloc(ALLOC_RECT_ARRAY, 0, 4);
     r.x = arr->Get(String::New("0"))->Int32Value();
     r.y = arr->Get(String::New("1"))->Int32Value();
     r.w = arr->Get(String::New("2"))->Int32Value();
@@ -904,6 +1206,7 @@ static Handle<Value> sdl::TTF::OpenFont(const Arguments& args) {
       String::New(TTF_GetError())
     )));
   }
+  RegisterFontFile(font, *file, ptsize);
   return scope.Close(WrapFont(font));
 }
 
@@ -915,8 +1218,8 @@ static Handle<Value> sdl::TTF::RenderTextBlended(const Arguments& args) {
   }
 
   SDL_PixelFormat* vfmt = SDL_GetVideoInfo()->vfmt;
-  TTF_Font* font = UnwrapFont(args[0]->ToObject());
-  String::Utf8Value text(args[1]);
+  FontChain* chain = UnwrapFontChain(args[0]);
+  Local<String> text = args[1]->ToString();
   int colorCode = args[2]->Int32Value();
 
   Uint8 r, g, b;
@@ -927,8 +1230,18 @@ static Handle<Value> sdl::TTF::RenderTextBlended(const Arguments& args) {
   color.g = g;
   color.b = b;
 
+  PROBE1(text__start, text->Length());
+  PROBE_TIMER(timer, text__done);
+  // Once the on disk cache is on, plain fonts draw from it too, so a warm
+  // start renders its first labels without rasterizing anything.
   SDL_Surface *resulting_text;
-  resulting_text = TTF_RenderText_Blended(font, *text, color);
+  if (chain || GlyphCacheEnabled()) {
+    resulting_text = RenderCachedText(chain ? NULL : UnwrapFont(args[0]->ToObject()), chain, text, color);
+  } else {
+    resulting_text = AlignSurface(TTF_RenderText_Blended(UnwrapFont(args[0]->ToObject()),
+      *String::Utf8Value(text), color), NULL);
+  }
+  PROBE_DONE2(text__done, timer, resulting_text ? resulting_text->w : 0, resulting_text ? resulting_text->h : 0);
   if (!resulting_text) {
     return ThrowException(Exception::Error(String::Concat(
       String::New("TTF::RenderTextBlended: "),
@@ -938,7 +1251,41 @@ static Handle<Value> sdl::TTF::RenderTextBlended(const Arguments& args) {
   return scope.Close(WrapSurface(resulting_text));
 }
 
-// TODO: make an async version so this can be used in loops or parallel load images
+// Loads the decoders for the given IMG.INIT flags up front; formats that
+// aren't loaded here are loaded on first use.  Returns the flags of every
+// decoder loaded so far.
+static Handle<Value> sdl::IMG::Init(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 1 && args[0]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected IMG::Init(Number)")));
+  }
+
+  int flags = args[0]->Int32Value();
+  int loaded = IMG_Init(flags);
+  if ((loaded & flags) != flags) {
+    return ThrowException(Exception::Error(String::Concat(
+      String::New("IMG::Init: "),
+      String::New(IMG_GetError())
+    )));
+  }
+
+  return scope.Close(Number::New(loaded));
+}
+
+static Handle<Value> sdl::IMG::Quit(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 0)) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected IMG::Quit()")));
+  }
+
+  IMG_Quit();
+
+  return Undefined();
+}
+
+// See IMG::LoadAsync and IMG::LoadBatch for decoding off the JS thread.
 static Handle<Value> sdl::IMG::Load(const Arguments& args) {
   HandleScope scope;
 
@@ -948,8 +1295,7 @@ static Handle<Value> sdl::IMG::Load(const Arguments& args) {
 
   String::Utf8Value file(args[0]);
 
-  SDL_Surface *image;
-  image=IMG_Load(*file);
+  SDL_Surface *image = LoadImage(*file, NULL);
   if(!image) {
     return ThrowException(Exception::Error(String::Concat(
       String::New("IMG::Load: "),
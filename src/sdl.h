@@ -9,6 +9,24 @@
 
 
 #include "helpers.h"
+#include "eventring.h"
+#include "pixels.h"
+#include "stats.h"
+#include "quantize.h"
+#include "gif.h"
+#include "affine.h"
+#include "raster.h"
+#include "text.h"
+#include "glyphcache.h"
+#include "audio.h"
+#include "alloctrack.h"
+#include "probes.h"
+#include "inject.h"
+#include "imgload.h"
+#include "assets.h"
+#include "taskgraph.h"
+#include "iso.h"
+#include "parallax.h"
 
 using namespace v8;
 
@@ -24,6 +42,11 @@ namespace sdl {
   static Handle<Value> SetError(const Arguments& args);
   static Handle<Value> WaitEvent(const Arguments& args);
   static Handle<Value> PollEvent(const Arguments& args);
+  static Handle<Value> PushEvent(const Arguments& args);
+  static Handle<Value> EnableUNICODE(const Arguments& args);
+  static Handle<Value> EnableKeyRepeat(const Arguments& args);
+  static Handle<Value> StartTextInput(const Arguments& args);
+  static Handle<Value> StopTextInput(const Arguments& args);
   static Handle<Value> SetVideoMode(const Arguments& args);
   static Handle<Value> VideoModeOK(const Arguments& args);
   static Handle<Value> NumJoysticks(const Arguments& args);
@@ -60,6 +83,8 @@ namespace sdl {
   }
 
   namespace IMG {
+    static Handle<Value> Init(const Arguments& args);
+    static Handle<Value> Quit(const Arguments& args);
     static Handle<Value> Load(const Arguments& args);
   }
 
@@ -85,6 +110,7 @@ namespace sdl {
   } closure_t;
   static void EIO_WaitEvent(eio_req *req);
   static int  EIO_OnEvent(eio_req *req);
+  static Handle<Value> NextEvent();
 
 }
 
@@ -0,0 +1,310 @@
+#include <v8.h>
+#include <node.h>
+#include <node_buffer.h>
+#include <SDL.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "helpers.h"
+#include "pixels.h"
+#include "stats.h"
+#include "workers.h"
+
+namespace sdl {
+
+// Rows per chunk handed to a worker.
+static const int STATS_GRAIN = 16;
+
+// Rec. 601 luma in 8.8 fixed point.
+static inline int Luma(const Uint8* p) {
+  return (77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8;
+}
+
+struct StatsPartial {
+  Uint8 min[4];
+  Uint8 max[4];
+  Uint64 sum[4];
+  int lmin;
+  int lmax;
+  Uint64 lsum;
+  Uint64 lsq;
+};
+
+// Everything a worker needs to scan the sampled rows of a locked surface.
+struct ScanJob {
+  SDL_Surface* surface;
+  SDL_Rect rect;
+  int step;
+  int columns;      // sampled pixels per row
+  Uint8* scratch;   // per worker: columns * bpp raw + columns * 4 RGBA
+  Uint32* hist;     // per worker HISTOGRAM_SIZE bins, or NULL
+  StatsPartial* partial;  // per worker, or NULL
+};
+
+// Returns sampled row `row` of the job as RGBA8888 in the worker's scratch.
+static const Uint8* ScanRow(ScanJob* job, int row, int worker) {
+  SDL_Surface* surface = job->surface;
+  int bpp = surface->format->BytesPerPixel;
+  Uint8* raw = job->scratch + (size_t)worker * job->columns * (bpp + 4);
+  Uint8* rgba = raw + job->columns * bpp;
+  const Uint8* src = (const Uint8*)surface->pixels
+    + (job->rect.y + row * job->step) * surface->pitch + job->rect.x * bpp;
+
+  if (job->step > 1) {
+    for (int i = 0; i < job->columns; i++) {
+      memcpy(raw + i * bpp, src + i * job->step * bpp, bpp);
+    }
+    src = raw;
+  }
+  DecodeRow(surface->format, src, job->columns, rgba);
+  return rgba;
+}
+
+static void HistogramRows(void* ctx, int begin, int end, int worker) {
+  ScanJob* job = (ScanJob*)ctx;
+  Uint32* hist = job->hist + (size_t)worker * HISTOGRAM_SIZE;
+  for (int row = begin; row < end; row++) {
+    const Uint8* p = ScanRow(job, row, worker);
+    for (int i = 0; i < job->columns; i++, p += 4) {
+      hist[p[0]]++;
+      hist[256 + p[1]]++;
+      hist[512 + p[2]]++;
+      hist[768 + p[3]]++;
+      hist[1024 + Luma(p)]++;
+    }
+  }
+}
+
+static void StatsRows(void* ctx, int begin, int end, int worker) {
+  ScanJob* job = (ScanJob*)ctx;
+  StatsPartial* s = job->partial + worker;
+  int n = job->columns;
+
+  for (int row = begin; row < end; row++) {
+    const Uint8* p = ScanRow(job, row, worker);
+    int i = 0;
+
+#ifdef __SSE2__
+    // Four RGBA pixels per vector: byte lanes line up with the channels, so
+    // min/max work directly and the sums widen into four Uint32 lanes.
+    __m128i vmin = _mm_set1_epi8((char)0xff);
+    __m128i vmax = _mm_setzero_si128();
+    __m128i vsum = _mm_setzero_si128();
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= n; i += 4) {
+      __m128i px = _mm_loadu_si128((const __m128i*)(p + i * 4));
+      vmin = _mm_min_epu8(vmin, px);
+      vmax = _mm_max_epu8(vmax, px);
+      __m128i lo = _mm_unpacklo_epi8(px, zero);
+      __m128i hi = _mm_unpackhi_epi8(px, zero);
+      vsum = _mm_add_epi32(vsum, _mm_unpacklo_epi16(lo, zero));
+      vsum = _mm_add_epi32(vsum, _mm_unpackhi_epi16(lo, zero));
+      vsum = _mm_add_epi32(vsum, _mm_unpacklo_epi16(hi, zero));
+      vsum = _mm_add_epi32(vsum, _mm_unpackhi_epi16(hi, zero));
+    }
+    Uint8 mins[16], maxs[16];
+    Uint32 sums[4];
+    _mm_storeu_si128((__m128i*)mins, vmin);
+    _mm_storeu_si128((__m128i*)maxs, vmax);
+    _mm_storeu_si128((__m128i*)sums, vsum);
+    if (i) {
+      for (int c = 0; c < 4; c++) {
+        for (int k = c; k < 16; k += 4) {
+          if (mins[k] < s->min[c]) s->min[c] = mins[k];
+          if (maxs[k] > s->max[c]) s->max[c] = maxs[k];
+        }
+        s->sum[c] += sums[c];
+      }
+    }
+#endif
+
+    for (; i < n; i++) {
+      const Uint8* q = p + i * 4;
+      for (int c = 0; c < 4; c++) {
+        if (q[c] < s->min[c]) s->min[c] = q[c];
+        if (q[c] > s->max[c]) s->max[c] = q[c];
+        s->sum[c] += q[c];
+      }
+    }
+
+    Uint32 lsum = 0;
+    Uint64 lsq = 0;
+    for (i = 0; i < n; i++) {
+      int l = Luma(p + i * 4);
+      if (l < s->lmin) s->lmin = l;
+      if (l > s->lmax) s->lmax = l;
+      lsum += l;
+      lsq += l * l;
+    }
+    s->lsum += lsum;
+    s->lsq += lsq;
+  }
+}
+
+// Parses (Surface, Rect, out, [step]) and prepares a job over the locked
+// surface.  Returns false after throwing.
+static bool PrepareScan(const Arguments& args, const char* usage, ExternalArrayType type, int size,
+    ScanJob* job, void** out, Handle<Value>* error) {
+  if (!((args.Length() == 3 || (args.Length() == 4 && args[3]->IsNumber()))
+      && args[0]->IsObject()
+      && (args[1]->IsObject() || args[1]->IsNull())
+      && args[2]->IsObject()
+  )) {
+    *error = ThrowException(Exception::TypeError(String::New(usage)));
+    return false;
+  }
+
+  int length;
+  *out = TypedArrayData(args[2], type, &length);
+  if (!*out || length < size) {
+    *error = ThrowException(Exception::TypeError(String::New(usage)));
+    return false;
+  }
+
+  memset(job, 0, sizeof(*job));
+  job->surface = UnwrapSurface(args[0]->ToObject());
+  SDL_Rect r;
+  if (!ResolveSurfaceRect(job->surface, ValueToRect(args[1], &r), &job->rect)) {
+    *error = ThrowException(Exception::RangeError(String::New("Rect is outside of the surface")));
+    return false;
+  }
+  job->step = args.Length() == 4 ? args[3]->Int32Value() : 1;
+  if (job->step < 1) job->step = 1;
+  job->columns = (job->rect.w + job->step - 1) / job->step;
+
+  int bpp = job->surface->format->BytesPerPixel;
+  job->scratch = (Uint8*)malloc((size_t)WorkerCount() * job->columns * (bpp + 4) + 1);
+  if (!job->scratch) {
+    *error = ThrowException(Exception::Error(String::New("Out of memory")));
+    return false;
+  }
+  if (SDL_MUSTLOCK(job->surface) && SDL_LockSurface(job->surface) < 0) {
+    free(job->scratch);
+    *error = ThrowSDLException("Lock");
+    return false;
+  }
+  return true;
+}
+
+static void FinishScan(ScanJob* job) {
+  if (SDL_MUSTLOCK(job->surface)) SDL_UnlockSurface(job->surface);
+  free(job->scratch);
+}
+
+// Fills a Uint32Array with R, G, B, A and luminance histograms of a rect.  An
+// optional step samples every step-th pixel of every step-th row.
+Handle<Value> Histogram(const Arguments& args) {
+  HandleScope scope;
+
+  ScanJob job;
+  void* out;
+  Handle<Value> error;
+  if (!PrepareScan(args, "Invalid arguments: Expected Histogram(Surface, Rect, Uint32Array, [Number])",
+      kExternalUnsignedIntArray, HISTOGRAM_SIZE, &job, &out, &error)) {
+    return error;
+  }
+
+  int workers = WorkerCount();
+  job.hist = (Uint32*)calloc((size_t)workers * HISTOGRAM_SIZE, sizeof(Uint32));
+  if (!job.hist) {
+    FinishScan(&job);
+    return ThrowException(Exception::Error(String::New("Histogram: Out of memory")));
+  }
+
+  int rows = (job.rect.h + job.step - 1) / job.step;
+  ParallelFor(rows, STATS_GRAIN, HistogramRows, &job);
+  FinishScan(&job);
+
+  Uint32* hist = (Uint32*)out;
+  memcpy(hist, job.hist, HISTOGRAM_SIZE * sizeof(Uint32));
+  for (int w = 1; w < workers; w++) {
+    const Uint32* part = job.hist + (size_t)w * HISTOGRAM_SIZE;
+    for (int i = 0; i < HISTOGRAM_SIZE; i++) hist[i] += part[i];
+  }
+  free(job.hist);
+
+  return Undefined();
+}
+
+// Fills a Float32Array with per channel min/max/mean and luminance
+// min/max/mean/stddev of a rect (layout in stats.h).  Returns the number of
+// pixels sampled.
+Handle<Value> SurfaceStats(const Arguments& args) {
+  HandleScope scope;
+
+  ScanJob job;
+  void* out;
+  Handle<Value> error;
+  if (!PrepareScan(args, "Invalid arguments: Expected SurfaceStats(Surface, Rect, Float32Array, [Number])",
+      kExternalFloatArray, STATS_SIZE, &job, &out, &error)) {
+    return error;
+  }
+
+  int workers = WorkerCount();
+  job.partial = (StatsPartial*)calloc(workers, sizeof(StatsPartial));
+  if (!job.partial) {
+    FinishScan(&job);
+    return ThrowException(Exception::Error(String::New("SurfaceStats: Out of memory")));
+  }
+  for (int w = 0; w < workers; w++) {
+    memset(job.partial[w].min, 0xff, 4);
+    job.partial[w].lmin = 255;
+  }
+
+  int rows = (job.rect.h + job.step - 1) / job.step;
+  ParallelFor(rows, STATS_GRAIN, StatsRows, &job);
+  FinishScan(&job);
+
+  StatsPartial total = job.partial[0];
+  for (int w = 1; w < workers; w++) {
+    StatsPartial* s = job.partial + w;
+    for (int c = 0; c < 4; c++) {
+      if (s->min[c] < total.min[c]) total.min[c] = s->min[c];
+      if (s->max[c] > total.max[c]) total.max[c] = s->max[c];
+      total.sum[c] += s->sum[c];
+    }
+    if (s->lmin < total.lmin) total.lmin = s->lmin;
+    if (s->lmax > total.lmax) total.lmax = s->lmax;
+    total.lsum += s->lsum;
+    total.lsq += s->lsq;
+  }
+  free(job.partial);
+
+  double count = (double)rows * job.columns;
+  float* stats = (float*)out;
+  memset(stats, 0, STATS_SIZE * sizeof(float));
+  if (count > 0) {
+    for (int c = 0; c < 4; c++) {
+      stats[c] = total.min[c];
+      stats[4 + c] = total.max[c];
+      stats[8 + c] = total.sum[c] / count;
+    }
+    double mean = total.lsum / count;
+    double variance = total.lsq / count - mean * mean;
+    stats[12] = total.lmin;
+    stats[13] = total.lmax;
+    stats[14] = mean;
+    stats[15] = variance > 0 ? sqrt(variance) : 0;
+  }
+
+  return Number::New(count);
+}
+
+void ExportStats(Handle<Object> target) {
+  HandleScope scope;
+
+  NODE_SET_METHOD(target, "histogram", Histogram);
+  NODE_SET_METHOD(target, "surfaceStats", SurfaceStats);
+
+  Local<Object> STATS = Object::New();
+  target->Set(String::New("STATS"), STATS);
+  STATS->Set(String::New("HISTOGRAM_SIZE"), Number::New(HISTOGRAM_SIZE));
+  STATS->Set(String::New("SIZE"), Number::New(STATS_SIZE));
+}
+
+} // sdl
@@ -0,0 +1,25 @@
+#ifndef NODE_SDL_STATS_H_
+#define NODE_SDL_STATS_H_
+
+#include <v8.h>
+#include <node.h>
+
+using namespace v8;
+
+namespace sdl {
+
+  // Histogram output: 256 bins each for R, G, B, A and luminance.
+  const int HISTOGRAM_SIZE = 5 * 256;
+
+  // Statistics output: min[4], max[4], mean[4] for RGBA followed by min, max,
+  // mean and standard deviation of the luminance.
+  const int STATS_SIZE = 16;
+
+  Handle<Value> Histogram(const Arguments& args);
+  Handle<Value> SurfaceStats(const Arguments& args);
+
+  void ExportStats(Handle<Object> target);
+
+} // sdl
+
+#endif  // NODE_SDL_STATS_H_
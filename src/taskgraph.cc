@@ -0,0 +1,675 @@
+#include <v8.h>
+#include <node.h>
+#include <SDL.h>
+#include <SDL_image.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "helpers.h"
+#include "pixels.h"
+#include "affine.h"
+#include "workers.h"
+#include "taskgraph.h"
+
+namespace sdl {
+
+enum TaskOp {
+  TASK_DECODE,
+  TASK_CONVERT,
+  TASK_SCALE,
+  TASK_BLUR,
+  TASK_ATLAS
+};
+
+static const char* const TASK_OP_NAMES[] = { "decode", "convert", "scale", "blur", "atlas" };
+static const int TASK_OP_COUNT = 5;
+
+static const int MAX_BLUR_RADIUS = 255;
+static const int MAX_BLUR_PASSES = 8;
+// Largest scale or atlas side.  Atlas rects are SDL_Rects, with 16 bit
+// positions, and it keeps pitches well inside an int.
+static const int MAX_TASK_SIZE = 16384;
+
+struct TaskGraph;
+
+struct TaskNode {
+  TaskGraph* graph;
+  int index;
+  int op;
+  std::string path;             // decode
+  bool rgba;                    // convert: to RGBA8888 instead of the screen's format
+  int w, h;                     // scale, atlas
+  int filter;                   // scale
+  int radius, passes;           // blur
+  int padding;                  // atlas
+  std::vector<int> inputs;
+  std::vector<int> consumers;   // one entry per use, like inputs
+  volatile int waiting;         // inputs not produced yet
+  volatile int readers;         // consumers not done with the surface yet
+  SDL_Surface* surface;
+  std::vector<SDL_Rect> rects;  // atlas: where each input went
+};
+
+struct TaskGraph {
+  std::vector<TaskNode*> nodes;
+  volatile int remaining;       // nodes not run yet
+  char* volatile error;         // first failure
+  SDL_PixelFormat format;       // the screen's, for convert
+  Persistent<Function> fn;
+};
+
+static void Fail(TaskGraph* graph, const char* prefix, const char* reason) {
+  char* message = (char*)malloc(strlen(prefix) + strlen(reason) + 3);
+  if (!message) return;
+  sprintf(message, "%s: %s", prefix, reason);
+  if (!__sync_bool_compare_and_swap(&graph->error, (char*)NULL, message)) free(message);
+}
+
+static SDL_Surface* CreateRGBA(int w, int h) {
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+  return CreateAlignedSurface(SDL_SWSURFACE, w, h, 32,
+    0xff000000, 0x00ff0000, 0x0000ff00, 0x000000ff);
+#else
+  return CreateAlignedSurface(SDL_SWSURFACE, w, h, 32,
+    0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000);
+#endif
+}
+
+// Scale and blur keep 32 bit formats with byte channels.  Anything else,
+// and color keyed images, which need real alpha once pixels mix, come out as
+// RGBA8888.
+static SDL_Surface* CreateOutput(SDL_Surface* src, int w, int h) {
+  int idx[4];
+  SDL_PixelFormat* fmt = src->format;
+  if (!ByteChannels(fmt, idx) || (src->flags & SDL_SRCCOLORKEY)) return CreateRGBA(w, h);
+  return CreateAlignedSurface(SDL_SWSURFACE, w, h, 32, fmt->Rmask, fmt->Gmask, fmt->Bmask, fmt->Amask);
+}
+
+// Opens a whole surface for sampling.  Surfaces in a graph are software
+// surfaces we created, so no locking is needed.
+static bool OpenWhole(SDL_Surface* surface, SampleSource* source, Uint8** copy) {
+  SDL_Rect all = { 0, 0, (Uint16)surface->w, (Uint16)surface->h };
+  if (OpenSampleSource(surface, &all, source, copy)) return true;
+  SDL_OutOfMemory();
+  return false;
+}
+
+// An identical copy, for converting an input other nodes are reading:
+// converting briefly changes its source's color key and alpha.
+static SDL_Surface* CloneSurface(SDL_Surface* src) {
+  SDL_PixelFormat* fmt = src->format;
+  SDL_Surface* copy = CreateAlignedSurface(SDL_SWSURFACE, src->w, src->h, fmt->BitsPerPixel,
+    fmt->Rmask, fmt->Gmask, fmt->Bmask, fmt->Amask);
+  if (!copy) return NULL;
+  if (fmt->palette && copy->format->palette) {
+    SDL_SetColors(copy, fmt->palette->colors, 0, fmt->palette->ncolors);
+  }
+  size_t row = (size_t)src->w * fmt->BytesPerPixel;
+  for (int y = 0; y < src->h; y++) {
+    memcpy((Uint8*)copy->pixels + y * copy->pitch, (const Uint8*)src->pixels + y * src->pitch, row);
+  }
+  SDL_SetColorKey(copy, src->flags & SDL_SRCCOLORKEY, fmt->colorkey);
+  SDL_SetAlpha(copy, src->flags & SDL_SRCALPHA, fmt->alpha);
+  return copy;
+}
+
+static SDL_Surface* ConvertToRGBA(SDL_Surface* src) {
+  SampleSource source;
+  Uint8* copy;
+  if (!OpenWhole(src, &source, &copy)) return NULL;
+  SDL_Surface* dst = CreateRGBA(src->w, src->h);
+  Uint8* row = (Uint8*)malloc((size_t)src->w * 4 + 1);
+  if (dst && row) {
+    for (int y = 0; y < src->h; y++) {
+      for (int x = 0; x < src->w; x++) FetchSample(&source, x, y, row + x * 4);
+      EncodeRow(dst->format, row, src->w, (Uint8*)dst->pixels + y * dst->pitch);
+    }
+  } else if (dst) {
+    ReleaseSurface(dst);
+    dst = NULL;
+    SDL_OutOfMemory();
+  }
+  free(row);
+  free(copy);
+  return dst;
+}
+
+static SDL_Surface* Convert(TaskNode* node, SDL_Surface* src, bool shared) {
+  if (node->rgba) return ConvertToRGBA(src);
+
+  SDL_Surface* input = shared ? CloneSurface(src) : src;
+  if (!input) return NULL;
+  Uint32 flags = SDL_SWSURFACE | (input->flags & (SDL_SRCCOLORKEY | SDL_SRCALPHA));
+  SDL_Surface* dst = ConvertAlignedSurface(input, &node->graph->format, flags);
+  if (input != src) ReleaseSurface(input);
+  return dst;
+}
+
+// Resamples with pixel centres lined up.  Bilinear weights by alpha, so
+// transparent texels don't bleed their color into the edges.
+static SDL_Surface* Scale(TaskNode* node, SDL_Surface* src) {
+  SampleSource source;
+  Uint8* copy;
+  if (!OpenWhole(src, &source, &copy)) return NULL;
+  const int w = node->w, h = node->h;
+  SDL_Surface* dst = CreateOutput(src, w, h);
+  Uint8* row = (Uint8*)malloc((size_t)w * 4 + 1);
+  if (!dst || !row) {
+    ReleaseSurface(dst);
+    free(row);
+    free(copy);
+    SDL_OutOfMemory();
+    return NULL;
+  }
+
+  // 16.16 steps through the source per destination pixel.
+  const Sint32 du = (Sint32)(((Sint64)src->w << 16) / w);
+  const Sint32 dv = (Sint32)(((Sint64)src->h << 16) / h);
+  const int wmax = src->w - 1, hmax = src->h - 1;
+
+  for (int y = 0; y < h; y++) {
+    Sint32 v = dv * y + dv / 2;
+    if (node->filter == FILTER_BILINEAR) {
+      Sint32 sv = v - 0x8000;
+      int ya = sv >> 16, fy = (sv >> 8) & 0xff, yb = ya + 1;
+      if (ya < 0) ya = 0;
+      if (yb > hmax) yb = hmax;
+      if (ya > hmax) ya = hmax;
+      Sint32 u = du / 2 - 0x8000;
+      for (int x = 0; x < w; x++, u += du) {
+        int xa = u >> 16, fx = (u >> 8) & 0xff, xb = xa + 1;
+        if (xa < 0) xa = 0;
+        if (xb > wmax) xb = wmax;
+        if (xa > wmax) xa = wmax;
+        Uint8 p[4][4];
+        FetchSample(&source, xa, ya, p[0]);
+        FetchSample(&source, xb, ya, p[1]);
+        FetchSample(&source, xa, yb, p[2]);
+        FetchSample(&source, xb, yb, p[3]);
+        BlendBilinear(p, fx, fy, row + x * 4);
+      }
+    } else {
+      int sv = v >> 16;
+      if (sv > hmax) sv = hmax;
+      Sint32 u = du / 2;
+      for (int x = 0; x < w; x++, u += du) {
+        int su = u >> 16;
+        if (su > wmax) su = wmax;
+        FetchSample(&source, su, sv, row + x * 4);
+      }
+    }
+    EncodeRow(dst->format, row, w, (Uint8*)dst->pixels + y * dst->pitch);
+  }
+
+  free(row);
+  free(copy);
+  return dst;
+}
+
+// One box blur pass along rows, with edge pixels repeated.
+static void BoxRows(const Uint8* src, Uint8* dst, int w, int h, int r) {
+  const int d = 2 * r + 1;
+  for (int y = 0; y < h; y++) {
+    const Uint8* in = src + (size_t)y * w * 4;
+    Uint8* out = dst + (size_t)y * w * 4;
+    int sum[4];
+    for (int c = 0; c < 4; c++) {
+      sum[c] = in[c] * (r + 1);
+      for (int i = 1; i <= r; i++) sum[c] += in[std::min(i, w - 1) * 4 + c];
+    }
+    for (int x = 0; x < w; x++) {
+      const Uint8* add = in + std::min(x + r + 1, w - 1) * 4;
+      const Uint8* sub = in + std::max(x - r, 0) * 4;
+      for (int c = 0; c < 4; c++) {
+        out[x * 4 + c] = (Uint8)((sum[c] + r) / d);
+        sum[c] += add[c] - sub[c];
+      }
+    }
+  }
+}
+
+// The same down columns, a row at a time so memory is read in order.
+static void BoxColumns(const Uint8* src, Uint8* dst, int w, int h, int r, int* sum) {
+  const int d = 2 * r + 1;
+  const int n = w * 4;
+  for (int i = 0; i < n; i++) sum[i] = src[i] * (r + 1);
+  for (int k = 1; k <= r; k++) {
+    const Uint8* in = src + (size_t)std::min(k, h - 1) * n;
+    for (int i = 0; i < n; i++) sum[i] += in[i];
+  }
+  for (int y = 0; y < h; y++) {
+    Uint8* out = dst + (size_t)y * n;
+    const Uint8* add = src + (size_t)std::min(y + r + 1, h - 1) * n;
+    const Uint8* sub = src + (size_t)std::max(y - r, 0) * n;
+    for (int i = 0; i < n; i++) {
+      out[i] = (Uint8)((sum[i] + r) / d);
+      sum[i] += add[i] - sub[i];
+    }
+  }
+}
+
+// Repeated box blurs, which approach a gaussian quickly: three passes of
+// radius r are close to a gaussian with sigma r.  Works on premultiplied
+// alpha so transparent pixels don't darken the edges.
+static SDL_Surface* Blur(TaskNode* node, SDL_Surface* src) {
+  SampleSource source;
+  Uint8* copy;
+  if (!OpenWhole(src, &source, &copy)) return NULL;
+  const int w = src->w, h = src->h;
+  const size_t bytes = (size_t)w * h * 4;
+  SDL_Surface* dst = CreateOutput(src, w, h);
+  Uint8* a = (Uint8*)malloc(bytes + 1);
+  Uint8* b = (Uint8*)malloc(bytes + 1);
+  int* sum = (int*)malloc((size_t)w * 4 * sizeof(int));
+  if (!dst || !a || !b || !sum) {
+    ReleaseSurface(dst);
+    free(a);
+    free(b);
+    free(sum);
+    free(copy);
+    SDL_OutOfMemory();
+    return NULL;
+  }
+
+  for (int y = 0; y < h; y++) {
+    Uint8* p = a + (size_t)y * w * 4;
+    for (int x = 0; x < w; x++, p += 4) {
+      FetchSample(&source, x, y, p);
+      for (int c = 0; c < 3; c++) p[c] = (Uint8)Div255(p[c] * p[3]);
+    }
+  }
+  free(copy);
+
+  if (node->radius > 0) {
+    for (int pass = 0; pass < node->passes; pass++) {
+      BoxRows(a, b, w, h, node->radius);
+      BoxColumns(b, a, w, h, node->radius, sum);
+    }
+  }
+
+  for (int y = 0; y < h; y++) {
+    Uint8* p = a + (size_t)y * w * 4;
+    for (int x = 0; x < w; x++, p += 4) {
+      int alpha = p[3];
+      for (int c = 0; c < 3; c++) {
+        int v = alpha ? (p[c] * 255 + alpha / 2) / alpha : 0;
+        p[c] = (Uint8)(v > 255 ? 255 : v);
+      }
+    }
+    EncodeRow(dst->format, a + (size_t)y * w * 4, w, (Uint8*)dst->pixels + y * dst->pitch);
+  }
+
+  free(a);
+  free(b);
+  free(sum);
+  return dst;
+}
+
+// Tallest first, for shelf packing.
+struct ByHeight {
+  const std::vector<SDL_Surface*>* images;
+  bool operator()(int a, int b) const {
+    int ha = (*images)[a]->h, hb = (*images)[b]->h;
+    return ha != hb ? ha > hb : a < b;
+  }
+};
+
+// Packs the inputs onto shelves, tallest first, with `padding` transparent
+// pixels around each.  Returns NULL with the SDL error set when they don't
+// fit.
+static SDL_Surface* Atlas(TaskNode* node, const std::vector<SDL_Surface*>& images) {
+  const int n = (int)images.size(), pad = node->padding;
+  std::vector<int> order(n);
+  for (int i = 0; i < n; i++) order[i] = i;
+  ByHeight by_height = { &images };
+  std::sort(order.begin(), order.end(), by_height);
+
+  node->rects.assign(n, SDL_Rect());
+  int x = pad, y = pad, shelf = 0;
+  for (int k = 0; k < n; k++) {
+    SDL_Surface* image = images[order[k]];
+    if (x + image->w + pad > node->w && x > pad) {
+      x = pad;
+      y += shelf + pad;
+      shelf = 0;
+    }
+    if (x + image->w + pad > node->w || y + image->h + pad > node->h) {
+      SDL_SetError("Images don't fit in %dx%d", node->w, node->h);
+      return NULL;
+    }
+    SDL_Rect& rect = node->rects[order[k]];
+    rect.x = x;
+    rect.y = y;
+    rect.w = image->w;
+    rect.h = image->h;
+    x += image->w + pad;
+    if (image->h > shelf) shelf = image->h;
+  }
+
+  SDL_Surface* dst = CreateRGBA(node->w, node->h);
+  if (!dst) return NULL;
+  for (int i = 0; i < n; i++) {
+    SampleSource source;
+    Uint8* copy;
+    Uint8* row = (Uint8*)malloc((size_t)images[i]->w * 4 + 1);
+    if (!row || !OpenWhole(images[i], &source, &copy)) {
+      free(row);
+      ReleaseSurface(dst);
+      SDL_OutOfMemory();
+      return NULL;
+    }
+    const SDL_Rect& rect = node->rects[i];
+    for (int sy = 0; sy < rect.h; sy++) {
+      for (int sx = 0; sx < rect.w; sx++) FetchSample(&source, sx, sy, row + sx * 4);
+      EncodeRow(dst->format, row, rect.w, (Uint8*)dst->pixels + (rect.y + sy) * dst->pitch + rect.x * 4);
+    }
+    free(row);
+    free(copy);
+  }
+  return dst;
+}
+
+static SDL_Surface* Apply(TaskNode* node) {
+  TaskGraph* graph = node->graph;
+  if (node->op == TASK_DECODE) {
+    SDL_Surface* image = DecodeImage(node->path.c_str());
+    // Only a decode that is itself a result is handed out; others are read
+    // once and freed, so copying them onto aligned rows would be wasted.
+    return node->consumers.empty() ? AlignSurface(image, NULL) : image;
+  }
+
+  std::vector<SDL_Surface*> images;
+  for (size_t i = 0; i < node->inputs.size(); i++) {
+    images.push_back(graph->nodes[node->inputs[i]]->surface);
+  }
+  switch (node->op) {
+    case TASK_CONVERT:
+      return Convert(node, images[0], graph->nodes[node->inputs[0]]->consumers.size() > 1);
+    case TASK_SCALE:
+      return Scale(node, images[0]);
+    case TASK_BLUR:
+      return Blur(node, images[0]);
+    default:
+      return Atlas(node, images);
+  }
+}
+
+// Runs one node on a pool thread, then releases its inputs and queues the
+// consumers it was the last input of.  After a failure the remaining nodes
+// only do the bookkeeping.
+static void RunNode(void* data) {
+  TaskNode* node = (TaskNode*)data;
+  TaskGraph* graph = node->graph;
+
+  if (!graph->error) {
+    node->surface = Apply(node);
+    if (!node->surface) {
+      char prefix[64];
+      if (node->op == TASK_DECODE) {
+        Fail(graph, node->path.c_str(), IMG_GetError());
+      } else {
+        snprintf(prefix, sizeof(prefix), "Node %d (%s)", node->index, TASK_OP_NAMES[node->op]);
+        Fail(graph, prefix, SDL_GetError());
+      }
+    }
+  }
+
+  for (size_t i = 0; i < node->inputs.size(); i++) {
+    TaskNode* input = graph->nodes[node->inputs[i]];
+    if (__sync_sub_and_fetch(&input->readers, 1) == 0 && input->surface) {
+      ReleaseSurface(input->surface);
+      input->surface = NULL;
+    }
+  }
+  for (size_t i = 0; i < node->consumers.size(); i++) {
+    TaskNode* consumer = graph->nodes[node->consumers[i]];
+    if (__sync_sub_and_fetch(&consumer->waiting, 1) == 0) SpawnTask(RunNode, consumer);
+  }
+  if (__sync_sub_and_fetch(&graph->remaining, 1) == 0) WakeTaskWaiters();
+}
+
+// Starts the graph's roots and helps run the pool until every node is done.
+static void EIO_RunGraph(eio_req *req) {
+  TaskGraph* graph = (TaskGraph*)req->data;
+  // Collect the roots first: once the first one runs, its consumers may
+  // reach zero waiting inputs and be queued by a worker.
+  std::vector<TaskNode*> roots;
+  for (size_t i = 0; i < graph->nodes.size(); i++) {
+    if (graph->nodes[i]->waiting == 0) roots.push_back(graph->nodes[i]);
+  }
+  for (size_t i = 0; i < roots.size(); i++) SpawnTask(RunNode, roots[i]);
+  RunTasksUntil(&graph->remaining);
+}
+
+static void FreeGraph(TaskGraph* graph) {
+  for (size_t i = 0; i < graph->nodes.size(); i++) {
+    ReleaseSurface(graph->nodes[i]->surface);
+    delete graph->nodes[i];
+  }
+  free(graph->error);
+  graph->fn.Dispose();
+  delete graph;
+}
+
+static Handle<Object> RectObject(const SDL_Rect& rect) {
+  Local<Object> obj = Object::New();
+  obj->Set(String::NewSymbol("x"), Number::New(rect.x));
+  obj->Set(String::NewSymbol("y"), Number::New(rect.y));
+  obj->Set(String::NewSymbol("w"), Number::New(rect.w));
+  obj->Set(String::NewSymbol("h"), Number::New(rect.h));
+  return obj;
+}
+
+static int EIO_OnGraphDone(eio_req *req) {
+  HandleScope scope;
+
+  TaskGraph* graph = (TaskGraph*)req->data;
+  ev_unref(EV_DEFAULT_UC);
+
+  Handle<Value> argv[2];
+  if (graph->error) {
+    argv[0] = Exception::Error(String::Concat(String::New("TASKS::Run: "), String::New(graph->error)));
+    argv[1] = Undefined();
+  } else {
+    Local<Array> results = Array::New(graph->nodes.size());
+    for (size_t i = 0; i < graph->nodes.size(); i++) {
+      TaskNode* node = graph->nodes[i];
+      if (!node->consumers.empty()) continue;
+      Handle<Object> surface = WrapSurface(node->surface);
+      node->surface = NULL;
+      if (node->op != TASK_ATLAS) {
+        results->Set(i, surface);
+        continue;
+      }
+      Local<Object> atlas = Object::New();
+      Local<Array> rects = Array::New(node->rects.size());
+      for (size_t k = 0; k < node->rects.size(); k++) rects->Set(k, RectObject(node->rects[k]));
+      atlas->Set(String::NewSymbol("surface"), surface);
+      atlas->Set(String::NewSymbol("rects"), rects);
+      results->Set(i, atlas);
+    }
+    argv[0] = Undefined();
+    argv[1] = results;
+  }
+
+  graph->fn->Call(Context::GetCurrent()->Global(), 2, argv);
+
+  FreeGraph(graph);
+  return 0;
+}
+
+// Reads an integer option, leaving *out alone when it's missing.  False when
+// it's present but not a number.
+static bool IntOption(Handle<Object> spec, const char* key, int* out) {
+  Local<Value> value = spec->Get(String::New(key));
+  if (value->IsUndefined()) return true;
+  if (!value->IsNumber()) return false;
+  *out = value->Int32Value();
+  return true;
+}
+
+// Index of an earlier node, or -1.
+static int InputIndex(Handle<Value> value, int before) {
+  if (!value->IsNumber()) return -1;
+  int index = value->Int32Value();
+  return index >= 0 && index < before && index == value->NumberValue() ? index : -1;
+}
+
+// Fills in a node from its JS description.  Returns NULL, or what's wrong.
+static const char* ParseNode(Handle<Object> spec, TaskNode* node) {
+  String::Utf8Value op(spec->Get(String::New("op")));
+  node->op = -1;
+  for (int i = 0; i < TASK_OP_COUNT; i++) {
+    if (*op && !strcmp(*op, TASK_OP_NAMES[i])) node->op = i;
+  }
+  if (node->op < 0) return "op must be one of decode, convert, scale, blur, atlas";
+
+  if (node->op == TASK_DECODE) {
+    Local<Value> path = spec->Get(String::New("path"));
+    if (!path->IsString()) return "decode needs a path";
+    node->path = *String::Utf8Value(path);
+    return NULL;
+  }
+
+  if (node->op == TASK_ATLAS) {
+    Local<Value> inputs = spec->Get(String::New("inputs"));
+    if (!inputs->IsArray() || Handle<Array>::Cast(inputs)->Length() == 0) return "atlas needs inputs";
+    Handle<Array> list = Handle<Array>::Cast(inputs);
+    for (unsigned i = 0; i < list->Length(); i++) {
+      int input = InputIndex(list->Get(i), node->index);
+      if (input < 0) return "inputs must be earlier nodes";
+      node->inputs.push_back(input);
+    }
+  } else {
+    int input = InputIndex(spec->Get(String::New("input")), node->index);
+    if (input < 0) return "input must be an earlier node";
+    node->inputs.push_back(input);
+  }
+
+  switch (node->op) {
+    case TASK_CONVERT: {
+      Local<Value> format = spec->Get(String::New("format"));
+      if (format->IsUndefined()) break;
+      String::Utf8Value name(format);
+      if (!*name || (strcmp(*name, "display") && strcmp(*name, "rgba"))) return "format must be display or rgba";
+      node->rgba = !strcmp(*name, "rgba");
+      break;
+    }
+    case TASK_SCALE:
+      if (!IntOption(spec, "w", &node->w) || !IntOption(spec, "h", &node->h) || node->w < 1 || node->h < 1
+          || node->w > MAX_TASK_SIZE || node->h > MAX_TASK_SIZE) {
+        return "scale needs a w and h of 1 to 16384";
+      }
+      if (!IntOption(spec, "filter", &node->filter)
+          || (node->filter != FILTER_NEAREST && node->filter != FILTER_BILINEAR)) {
+        return "filter must be FILTER.NEAREST or FILTER.BILINEAR";
+      }
+      break;
+    case TASK_BLUR:
+      if (!IntOption(spec, "radius", &node->radius) || node->radius < 0 || node->radius > MAX_BLUR_RADIUS) {
+        return "radius must be 0 to 255";
+      }
+      if (!IntOption(spec, "passes", &node->passes) || node->passes < 1 || node->passes > MAX_BLUR_PASSES) {
+        return "passes must be 1 to 8";
+      }
+      break;
+    case TASK_ATLAS:
+      if (!IntOption(spec, "w", &node->w) || !IntOption(spec, "h", &node->h) || node->w < 1 || node->h < 1
+          || node->w > MAX_TASK_SIZE || node->h > MAX_TASK_SIZE) {
+        return "atlas needs a w and h of 1 to 16384";
+      }
+      if (!IntOption(spec, "padding", &node->padding) || node->padding < 0 || node->padding > MAX_TASK_SIZE) {
+        return "padding must be 0 to 16384";
+      }
+      break;
+  }
+  return NULL;
+}
+
+// Runs an array of nodes, each consuming earlier ones by index:
+//
+//   { op: 'decode', path }
+//   { op: 'convert', input, [format: 'display' | 'rgba'] }
+//   { op: 'scale', input, w, h, [filter] }
+//   { op: 'blur', input, radius, [passes] }
+//   { op: 'atlas', inputs: [...], w, h, [padding] }
+//
+// and calls back with (err, results), results[i] holding the Surface of
+// every node nothing consumes ({ surface, rects } for an atlas).  If any
+// node fails everything is freed and only the first error is reported.
+Handle<Value> TASKS::Run(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 2 && args[0]->IsArray() && args[1]->IsFunction())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected TASKS::Run(Array, Function)")));
+  }
+
+  Handle<Array> specs = Handle<Array>::Cast(args[0]);
+  if (specs->Length() == 0) {
+    return ThrowException(Exception::RangeError(String::New("TASKS::Run: No nodes")));
+  }
+
+  TaskGraph* graph = new TaskGraph();
+  graph->error = NULL;
+  bool display = false;
+  for (unsigned i = 0; i < specs->Length(); i++) {
+    TaskNode* node = new TaskNode();
+    graph->nodes.push_back(node);
+    node->graph = graph;
+    node->index = i;
+    node->rgba = false;
+    node->w = node->h = 0;
+    node->filter = FILTER_BILINEAR;
+    node->radius = 0;
+    node->passes = 3;
+    node->padding = 1;
+    node->surface = NULL;
+
+    Local<Value> spec = specs->Get(i);
+    const char* problem = spec->IsObject() ? ParseNode(spec->ToObject(), node) : "not an object";
+    if (problem) {
+      char message[128];
+      snprintf(message, sizeof(message), "TASKS::Run: Node %u: %s", i, problem);
+      FreeGraph(graph);
+      return ThrowException(Exception::RangeError(String::New(message)));
+    }
+    if (node->op == TASK_CONVERT && !node->rgba) display = true;
+
+    node->waiting = node->inputs.size();
+    node->readers = 0;
+    for (size_t k = 0; k < node->inputs.size(); k++) {
+      TaskNode* input = graph->nodes[node->inputs[k]];
+      input->consumers.push_back(i);
+      input->readers++;
+    }
+  }
+
+  if (display) {
+    SDL_Surface* screen = SDL_GetVideoSurface();
+    if (!screen) {
+      FreeGraph(graph);
+      return ThrowException(Exception::Error(String::New("TASKS::Run: No video mode set for convert")));
+    }
+    graph->format = *screen->format;
+  }
+
+  graph->remaining = graph->nodes.size();
+  graph->fn = Persistent<Function>::New(Handle<Function>::Cast(args[1]));
+  eio_custom(EIO_RunGraph, EIO_PRI_DEFAULT, EIO_OnGraphDone, graph);
+  ev_ref(EV_DEFAULT_UC);
+  return Undefined();
+}
+
+void ExportTaskGraph(Handle<Object> target) {
+  HandleScope scope;
+
+  Local<Object> TASKS = Object::New();
+  target->Set(String::New("TASKS"), TASKS);
+  NODE_SET_METHOD(TASKS, "run", sdl::TASKS::Run);
+}
+
+} // sdl
@@ -0,0 +1,23 @@
+#ifndef NODE_SDL_TASKGRAPH_H_
+#define NODE_SDL_TASKGRAPH_H_
+
+#include <v8.h>
+#include <node.h>
+
+using namespace v8;
+
+namespace sdl {
+
+  // Surface preparation as a graph of dependent steps run on the work
+  // stealing task pool (see workers.h).  Only the results of steps nothing
+  // else consumes come back to JS; intermediate surfaces are freed on the
+  // workers as soon as their last consumer is done.
+  namespace TASKS {
+    Handle<Value> Run(const Arguments& args);
+  }
+
+  void ExportTaskGraph(Handle<Object> target);
+
+} // sdl
+
+#endif  // NODE_SDL_TASKGRAPH_H_
@@ -0,0 +1,455 @@
+#include <v8.h>
+#include <node.h>
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <vector>
+
+#include "helpers.h"
+#include "alloctrack.h"
+#include "probes.h"
+#include "text.h"
+#include "glyphcache.h"
+
+namespace sdl {
+
+// Per font, 256 lazily allocated pages of 256 glyphs each.
+static std::map<TTF_Font*, Glyph**> glyph_pages_;
+
+Glyph* GlyphSlot(TTF_Font* font, Uint16 ch) {
+  Glyph** pages = glyph_pages_[font];
+  if (!pages) {
+    pages = (Glyph**)calloc(256, sizeof(Glyph*));
+    if (!pages) return NULL;
+    glyph_pages_[font] = pages;
+    LoadGlyphCache(font);
+  }
+  Glyph* page = pages[ch >> 8];
+  if (!page) {
+    page = (Glyph*)calloc(256, sizeof(Glyph));
+    if (!page) return NULL;
+    pages[ch >> 8] = page;
+  }
+  return page + (ch & 0xff);
+}
+
+void CachedGlyphs(TTF_Font* font, std::vector<Uint16>* chars) {
+  std::map<TTF_Font*, Glyph**>::iterator it = glyph_pages_.find(font);
+  if (it == glyph_pages_.end()) return;
+  for (int p = 0; p < 256; p++) {
+    if (!it->second[p]) continue;
+    for (int i = 0; i < 256; i++) {
+      if (it->second[p][i].loaded) chars->push_back((p << 8) | i);
+    }
+  }
+}
+
+const Glyph* GetGlyph(TTF_Font* font, Uint16 ch) {
+  Glyph* glyph = GlyphSlot(font, ch);
+  if (!glyph) return NULL;
+  if (glyph->loaded) return glyph;
+
+  int minx, maxx, miny, maxy, advance;
+  if (TTF_GlyphMetrics(font, ch, &minx, &maxx, &miny, &maxy, &advance) < 0) return NULL;
+  glyph->ox = minx < 0 ? -minx : 0;
+  glyph->advance = advance;
+
+  // Rendered as a one character string the bitmap starts at the ascent line,
+  // which is what lets glyphs of different fonts share a baseline.
+  Uint16 text[2] = { ch, 0 };
+  SDL_Color white = { 0xff, 0xff, 0xff, 0 };
+  SDL_Surface* rendered = TTF_RenderUNICODE_Blended(font, text, white);
+  if (rendered && rendered->format->BytesPerPixel == 4 && rendered->format->Amask) {
+    size_t size = (size_t)rendered->w * rendered->h;
+    Uint8* alpha = (Uint8*)malloc(size + 1);
+    bool blank = true;
+    if (alpha && (!SDL_MUSTLOCK(rendered) || SDL_LockSurface(rendered) == 0)) {
+      const SDL_PixelFormat* fmt = rendered->format;
+      for (int y = 0; y < rendered->h; y++) {
+        const Uint32* row = (const Uint32*)((const Uint8*)rendered->pixels + y * rendered->pitch);
+        Uint8* out = alpha + (size_t)y * rendered->w;
+        for (int x = 0; x < rendered->w; x++) {
+          out[x] = (row[x] & fmt->Amask) >> fmt->Ashift;
+          if (out[x]) blank = false;
+        }
+      }
+      if (SDL_MUSTLOCK(rendered)) SDL_UnlockSurface(rendered);
+    }
+    if (blank) {
+      free(alpha);
+    } else {
+      glyph->alpha = alpha;
+      glyph->w = rendered->w;
+      glyph->h = rendered->h;
+    }
+  }
+  if (rendered) SDL_FreeSurface(rendered);
+
+  glyph->loaded = true;
+  return glyph;
+}
+
+void DrawGlyph(SDL_Surface* dst, const Glyph* glyph, int x, int y, SDL_Color color) {
+  if (!glyph->alpha) return;
+  int left = x - glyph->ox;
+  int x0 = left < 0 ? -left : 0, y0 = y < 0 ? -y : 0;
+  int x1 = left + glyph->w > dst->w ? dst->w - left : glyph->w;
+  int y1 = y + glyph->h > dst->h ? dst->h - y : glyph->h;
+  const SDL_PixelFormat* fmt = dst->format;
+
+  for (int gy = y0; gy < y1; gy++) {
+    const Uint8* coverage = glyph->alpha + gy * glyph->w;
+    Uint32* row = (Uint32*)((Uint8*)dst->pixels + (y + gy) * dst->pitch) + left;
+    for (int gx = x0; gx < x1; gx++) {
+      int a = coverage[gx];
+      if (!a) continue;
+      Uint32 p = row[gx];
+      int da = (p & fmt->Amask) >> fmt->Ashift;
+      // Straight alpha "over": glyphs may overlap in tightly kerned spans.
+      int back = da * (255 - a) / 255;
+      int out = a + back;
+      int r = (color.r * a + (int)((p & fmt->Rmask) >> fmt->Rshift) * back) / out;
+      int g = (color.g * a + (int)((p & fmt->Gmask) >> fmt->Gshift) * back) / out;
+      int b = (color.b * a + (int)((p & fmt->Bmask) >> fmt->Bshift) * back) / out;
+      row[gx] = (r << fmt->Rshift) | (g << fmt->Gshift) | (b << fmt->Bshift) | (out << fmt->Ashift);
+    }
+  }
+}
+
+// Coverage bitmaps per font, shared by every chain the font is part of.
+static std::map<TTF_Font*, Uint32*> coverage_;
+
+static const Uint32* FontCoverage(TTF_Font* font) {
+  std::map<TTF_Font*, Uint32*>::iterator it = coverage_.find(font);
+  if (it != coverage_.end()) return it->second;
+
+  Uint32* bits = (Uint32*)calloc(65536 / 32, sizeof(Uint32));
+  if (!bits) return NULL;
+  for (int ch = 0; ch < 65536; ch++) {
+    if (TTF_GlyphIsProvided(font, ch)) bits[ch >> 5] |= 1u << (ch & 31);
+  }
+  coverage_[font] = bits;
+  return bits;
+}
+
+TTF_Font* ResolveFont(const FontChain* chain, Uint16 ch) {
+  for (int i = 0; i < chain->count; i++) {
+    if (chain->coverage[i][ch >> 5] & (1u << (ch & 31))) return chain->fonts[i];
+  }
+  return chain->fonts[0];
+}
+
+// Chain wrappers carry the address of chain_tag_ in a second internal field,
+// which tells them apart from Font wrappers.
+static Persistent<ObjectTemplate> chain_template_;
+static int chain_tag_;
+
+// Nothing but the wrapper refers to a chain, so it goes with the wrapper.
+// The coverage bitmaps stay with their fonts.
+static void OnFontChainCollected(Persistent<Value> object, void* parameter) {
+  delete static_cast<FontChain*>(parameter);
+  object.Dispose();
+  object.Clear();
+}
+
+static Handle<Object> WrapFontChain(FontChain* chain) {
+  HandleScope scope;
+
+  if (chain_template_.IsEmpty()) {
+    Handle<ObjectTemplate> raw_template = ObjectTemplate::New();
+    raw_template->SetInternalFieldCount(2);
+    chain_template_ = Persistent<ObjectTemplate>::New(raw_template);
+  }
+  Handle<Object> result = chain_template_->NewInstance();
+  result->SetInternalField(0, External::New(chain));
+  result->SetInternalField(1, External::New(&chain_tag_));
+  Persistent<Object> weak = Persistent<Object>::New(result);
+  weak.MakeWeak(chain, OnFontChainCollected);
+  return scope.Close(result);
+}
+
+FontChain* UnwrapFontChain(Handle<Value> value) {
+  if (!value->IsObject()) return NULL;
+  Handle<Object> obj = value->ToObject();
+  if (obj->InternalFieldCount() != 2) return NULL;
+  if (Handle<External>::Cast(obj->GetInternalField(1))->Value() != &chain_tag_) return NULL;
+  return static_cast<FontChain*>(Handle<External>::Cast(obj->GetInternalField(0))->Value());
+}
+
+struct TextItem {
+  TTF_Font* font;
+  SDL_Color color;
+  Uint16 ch;
+  const Glyph* glyph;
+  int x;
+  int line;
+};
+
+struct TextLine {
+  int width;
+  int ascent;
+  int descent;
+  int skip;
+  int top;
+};
+
+// Places items on lines no wider than max_width (0 for no limit), breaking
+// after spaces where possible and between any two glyphs otherwise.  Fills
+// in lines and the size of the whole block.
+static void LayoutText(std::vector<TextItem>& items, int max_width, std::vector<TextLine>& lines,
+    int* width, int* height) {
+  int x = 0, line = 0, line_start = 0, last_break = -1;
+  for (size_t i = 0; i < items.size(); i++) {
+    TextItem& item = items[i];
+    if (item.ch == '\n') {
+      item.x = x;
+      item.line = line++;
+      x = 0;
+      line_start = i + 1;
+      last_break = -1;
+      continue;
+    }
+
+    int advance = item.glyph->advance;
+    if (max_width > 0 && x + advance > max_width && (int)i > line_start && item.ch != ' ') {
+      if (last_break >= line_start) {
+        // Move the word after the last space down to the new line.
+        int first = last_break + 1;
+        int shift = first < (int)i ? items[first].x : x;
+        for (int j = first; j < (int)i; j++) {
+          items[j].x -= shift;
+          items[j].line++;
+        }
+        x -= shift;
+        line_start = first;
+      } else {
+        x = 0;
+        line_start = i;
+      }
+      line++;
+      last_break = -1;
+    }
+    item.x = x;
+    item.line = line;
+    x += advance;
+    if (item.ch == ' ') last_break = i;
+  }
+
+  TextLine blank = { 0, 0, 0, 0, 0 };
+  lines.assign(items.empty() ? 0 : line + 1, blank);
+  for (size_t i = 0; i < items.size(); i++) {
+    const TextItem& item = items[i];
+    TextLine& l = lines[item.line];
+    int ascent = TTF_FontAscent(item.font), descent = -TTF_FontDescent(item.font);
+    int skip = TTF_FontLineSkip(item.font);
+    if (ascent > l.ascent) l.ascent = ascent;
+    if (descent > l.descent) l.descent = descent;
+    if (skip > l.skip) l.skip = skip;
+    if (item.ch != ' ' && item.ch != '\n') {
+      // Italic glyphs can reach past their advance.
+      int extent = item.glyph->w - item.glyph->ox;
+      if (extent < item.glyph->advance) extent = item.glyph->advance;
+      if (item.x + extent > l.width) l.width = item.x + extent;
+    }
+  }
+
+  *width = 0;
+  *height = 0;
+  for (size_t i = 0; i < lines.size(); i++) {
+    TextLine& l = lines[i];
+    // A trailing newline leaves an empty line; size it like the one above.
+    if (!l.skip && i > 0) {
+      l.ascent = lines[i - 1].ascent;
+      l.descent = lines[i - 1].descent;
+      l.skip = lines[i - 1].skip;
+    }
+    l.top = *height;
+    *height += l.skip > l.ascent + l.descent ? l.skip : l.ascent + l.descent;
+    if (l.width > *width) *width = l.width;
+  }
+}
+
+// Appends the characters of text, taking each one's font from the chain
+// when there is one.
+static void AppendText(std::vector<TextItem>& items, TTF_Font* font, const FontChain* chain,
+    SDL_Color color, Handle<Value> text) {
+  String::Value chars(text);
+  TextItem item;
+  item.color = color;
+  for (int k = 0; k < chars.length(); k++) {
+    item.ch = (*chars)[k];
+    if (item.ch == '\r') continue;
+    Uint16 shape = item.ch == '\n' ? ' ' : item.ch;
+    item.font = chain ? ResolveFont(chain, shape) : font;
+    item.glyph = GetGlyph(item.font, shape);
+    if (!item.glyph) continue;
+    items.push_back(item);
+  }
+}
+
+// Reads an array of { font, color, text } spans, font being a Font or a font
+// chain.  Returns an exception to throw, or an empty handle.
+static Handle<Value> CollectSpans(Handle<Array> spans, std::vector<TextItem>& items, const char* name) {
+  SDL_PixelFormat* vfmt = SDL_GetVideoInfo()->vfmt;
+  Local<String> font_symbol = String::NewSymbol("font");
+  Local<String> color_symbol = String::NewSymbol("color");
+  Local<String> text_symbol = String::NewSymbol("text");
+
+  for (unsigned i = 0; i < spans->Length(); i++) {
+    Local<Value> value = spans->Get(i);
+    Local<Value> font, color, text;
+    if (value->IsObject()) {
+      Local<Object> span = value->ToObject();
+      font = span->Get(font_symbol);
+      color = span->Get(color_symbol);
+      text = span->Get(text_symbol);
+    }
+    if (!(value->IsObject() && font->IsObject() && color->IsNumber() && text->IsString())) {
+      return ThrowException(Exception::TypeError(String::Concat(String::New(name),
+        String::New(": Expected spans of { font: Font, color: Number, text: String }"))));
+    }
+
+    SDL_Color c;
+    SDL_GetRGB(color->Int32Value(), vfmt, &c.r, &c.g, &c.b);
+    c.unused = 0;
+    FontChain* chain = UnwrapFontChain(font);
+    AppendText(items, chain ? NULL : UnwrapFont(font->ToObject()), chain, c, text);
+  }
+  return Handle<Value>();
+}
+
+static SDL_Surface* RenderItems(std::vector<TextItem>& items, int max_width) {
+  std::vector<TextLine> lines;
+  int width, height;
+  LayoutText(items, max_width, lines, &width, &height);
+
+  SDL_Surface* surface = CreateAlignedSurface(SDL_SWSURFACE, width > 0 ? width : 1, height > 0 ? height : 1, 32,
+    0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000);
+  if (!surface) return NULL;
+
+  for (size_t i = 0; i < items.size(); i++) {
+    const TextItem& item = items[i];
+    if (item.ch == ' ' || item.ch == '\n') continue;
+    const TextLine& l = lines[item.line];
+    DrawGlyph(surface, item.glyph, item.x, l.top + l.ascent - TTF_FontAscent(item.font), item.color);
+  }
+  return surface;
+}
+
+static Handle<Object> SizeObject(int width, int height) {
+  HandleScope scope;
+
+  TrackAlloc(ALLOC_SIZE_TEXT, 1, 0);
+  Local<Object> size = Object::New();
+  size->Set(String::NewSymbol("w"), Number::New(width));
+  size->Set(String::NewSymbol("h"), Number::New(height));
+  return scope.Close(size);
+}
+
+SDL_Surface* RenderCachedText(TTF_Font* font, const FontChain* chain, Handle<String> text, SDL_Color color) {
+  std::vector<TextItem> items;
+  AppendText(items, font, chain, color, text);
+  return RenderItems(items, 0);
+}
+
+// Builds a fallback chain from an array of fonts, most preferred first.
+// Works out which characters each font covers up front.
+Handle<Value> TTF::CreateFontChain(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 1 && args[0]->IsArray())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected TTF::CreateFontChain(Array)")));
+  }
+
+  Handle<Array> fonts = Handle<Array>::Cast(args[0]);
+  int count = fonts->Length();
+  if (count < 1 || count > MAX_CHAIN_FONTS) {
+    return ThrowException(Exception::RangeError(String::New("TTF::CreateFontChain: Expected 1 to 16 fonts")));
+  }
+  for (int i = 0; i < count; i++) {
+    Local<Value> font = fonts->Get(i);
+    if (!font->IsObject() || UnwrapFontChain(font)) {
+      return ThrowException(Exception::TypeError(String::New("TTF::CreateFontChain: Expected an array of fonts")));
+    }
+  }
+
+  FontChain* chain = new FontChain();
+  chain->count = count;
+  for (int i = 0; i < count; i++) {
+    chain->fonts[i] = UnwrapFont(fonts->Get(i)->ToObject());
+    chain->coverage[i] = FontCoverage(chain->fonts[i]);
+    if (!chain->coverage[i]) {
+      delete chain;
+      return ThrowException(Exception::Error(String::New("TTF::CreateFontChain: Out of memory")));
+    }
+  }
+
+  return scope.Close(WrapFontChain(chain));
+}
+
+// Measures a string in a Font or font chain as renderRichText would lay it
+// out.  Returns { w, h }.
+Handle<Value> TTF::SizeText(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 2 && args[0]->IsObject() && args[1]->IsString())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected TTF::SizeText(Font, String)")));
+  }
+
+  FontChain* chain = UnwrapFontChain(args[0]);
+  SDL_Color color = { 0, 0, 0, 0 };
+  std::vector<TextItem> items;
+  AppendText(items, chain ? NULL : UnwrapFont(args[0]->ToObject()), chain, color, args[1]);
+
+  std::vector<TextLine> lines;
+  int width, height;
+  LayoutText(items, 0, lines, &width, &height);
+  return scope.Close(SizeObject(width, height));
+}
+
+// Renders an array of { font, color, text } spans into one 32 bit surface
+// with per pixel alpha, like TTF::RenderTextBlended.  Spans share baselines
+// line by line and wrap at maxWidth pixels (0 for no wrapping); "\n" starts
+// a new line.  A span's font may be a Font or a font chain.
+Handle<Value> TTF::RenderRichText(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 2 && args[0]->IsArray() && args[1]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected TTF::RenderRichText(Array, Number)")));
+  }
+
+  std::vector<TextItem> items;
+  Handle<Value> error = CollectSpans(Handle<Array>::Cast(args[0]), items, "TTF::RenderRichText");
+  if (!error.IsEmpty()) return error;
+
+  PROBE1(text__start, (int)items.size());
+  PROBE_TIMER(timer, text__done);
+  SDL_Surface* surface = RenderItems(items, args[1]->Int32Value());
+  PROBE_DONE2(text__done, timer, surface ? surface->w : 0, surface ? surface->h : 0);
+  if (!surface) return ThrowSDLException("TTF::RenderRichText");
+
+  return scope.Close(WrapSurface(surface));
+}
+
+// Lays out spans like TTF::RenderRichText without rendering.  Returns
+// { w, h }.
+Handle<Value> TTF::SizeRichText(const Arguments& args) {
+  HandleScope scope;
+
+  if (!(args.Length() == 2 && args[0]->IsArray() && args[1]->IsNumber())) {
+    return ThrowException(Exception::TypeError(String::New("Invalid arguments: Expected TTF::SizeRichText(Array, Number)")));
+  }
+
+  std::vector<TextItem> items;
+  Handle<Value> error = CollectSpans(Handle<Array>::Cast(args[0]), items, "TTF::SizeRichText");
+  if (!error.IsEmpty()) return error;
+
+  std::vector<TextLine> lines;
+  int width, height;
+  LayoutText(items, args[1]->Int32Value(), lines, &width, &height);
+  return scope.Close(SizeObject(width, height));
+}
+
+} // sdl
@@ -0,0 +1,72 @@
+#ifndef NODE_SDL_TEXT_H_
+#define NODE_SDL_TEXT_H_
+
+#include <v8.h>
+#include <node.h>
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <vector>
+
+using namespace v8;
+
+namespace sdl {
+
+  // A rasterized glyph as coverage values.  The bitmap's top row is the
+  // font's ascent line and the pen origin sits ox pixels in from its left.
+  struct Glyph {
+    bool loaded;
+    int ox;
+    int advance;
+    int w;
+    int h;
+    Uint8* alpha;  // w * h, NULL for blank glyphs such as spaces
+  };
+
+  // Returns the cached glyph for ch, rendering it through FreeType the first
+  // time.  The result lives as long as the process.
+  const Glyph* GetGlyph(TTF_Font* font, Uint16 ch);
+
+  // The cache slot for ch, loaded or not (NULL when out of memory).  The
+  // first call for a font gives the on disk glyph cache a chance to fill it.
+  Glyph* GlyphSlot(TTF_Font* font, Uint16 ch);
+
+  // Appends the characters whose glyphs are cached for font.
+  void CachedGlyphs(TTF_Font* font, std::vector<Uint16>* chars);
+
+  // Composites a glyph in the given color onto a locked 32 bit ARGB surface
+  // with the pen at x and the font's ascent line at y (the baseline minus
+  // TTF_FontAscent).  Clips to the surface.
+  void DrawGlyph(SDL_Surface* dst, const Glyph* glyph, int x, int y, SDL_Color color);
+
+  const int MAX_CHAIN_FONTS = 16;
+
+  // A font fallback chain: each character comes from the first font that
+  // provides a glyph for it, looked up in per font coverage bitmaps.
+  struct FontChain {
+    int count;
+    TTF_Font* fonts[MAX_CHAIN_FONTS];
+    const Uint32* coverage[MAX_CHAIN_FONTS];  // 65536 bits each
+  };
+
+  // The font of the chain to draw ch with.  Characters no font provides fall
+  // back to the first one, which draws its missing glyph box.
+  TTF_Font* ResolveFont(const FontChain* chain, Uint16 ch);
+
+  // Returns the chain wrapped by value, or NULL if it isn't a font chain.
+  FontChain* UnwrapFontChain(Handle<Value> value);
+
+  // Renders a string with a font, or through a fallback chain when `chain`
+  // isn't NULL, into a new 32 bit ARGB surface the way
+  // TTF_RenderUNICODE_Blended would, drawing glyphs from the glyph cache.
+  SDL_Surface* RenderCachedText(TTF_Font* font, const FontChain* chain, Handle<String> text, SDL_Color color);
+
+  namespace TTF {
+    Handle<Value> CreateFontChain(const Arguments& args);
+    Handle<Value> SizeText(const Arguments& args);
+    Handle<Value> RenderRichText(const Arguments& args);
+    Handle<Value> SizeRichText(const Arguments& args);
+  }
+
+} // sdl
+
+#endif  // NODE_SDL_TEXT_H_
@@ -0,0 +1,335 @@
+#include <SDL.h>
+#include <SDL_thread.h>
+#include <vorbis/vorbisfile.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "dsp.h"
+#include "vorbis.h"
+
+namespace sdl {
+
+// How often the decoder thread tops up its streams, in milliseconds.  Streams
+// are kept a good deal further ahead than this.
+static const Uint32 DECODE_INTERVAL = 10;
+
+// Frames asked of libvorbis per read.
+static const int DECODE_FRAMES = 1024;
+
+// Converts decoded planar blocks to interleaved frames in another rate and
+// channel count, with linear interpolation between source frames.
+struct Converter {
+  int in_channels;
+  int out_channels;
+  long in_rate;
+  double step;     // source frames per output frame
+  double pos;      // source position of the next output frame; -1 is `last`
+  float last[MAX_AUDIO_CHANNELS];
+};
+
+static void InitConverter(Converter* conv, const vorbis_info* info, int rate, int channels) {
+  conv->in_channels = info->channels;
+  conv->out_channels = channels;
+  conv->in_rate = info->rate;
+  conv->step = (double)info->rate / rate;
+  conv->pos = 0;
+  memset(conv->last, 0, sizeof(conv->last));
+}
+
+static inline void MapFrame(const Converter* conv, float** pcm, int i, float* out) {
+  const int in = conv->in_channels, channels = conv->out_channels;
+  if (in == channels) {
+    for (int c = 0; c < channels; c++) out[c] = pcm[c][i];
+  } else if (in == 1) {
+    for (int c = 0; c < channels; c++) out[c] = pcm[0][i];
+  } else if (channels == 1) {
+    out[0] = (pcm[0][i] + pcm[1][i]) * 0.5f;
+  } else {
+    for (int c = 0; c < channels; c++) out[c] = c < in ? pcm[c][i] : 0.0f;
+  }
+}
+
+// Appends the output frames for a block of n source frames.
+static void Convert(Converter* conv, float** pcm, int n, std::vector<float>& out) {
+  if (n <= 0) return;
+  const int channels = conv->out_channels;
+  float a[MAX_AUDIO_CHANNELS], b[MAX_AUDIO_CHANNELS];
+
+  if (conv->step == 1.0 && conv->pos == 0) {
+    size_t at = out.size();
+    out.resize(at + (size_t)n * channels);
+    for (int i = 0; i < n; i++) MapFrame(conv, pcm, i, &out[at + (size_t)i * channels]);
+    return;
+  }
+
+  int loaded = -2;
+  while (conv->pos < n - 1) {
+    int i = (int)(conv->pos + 1.0) - 1;   // floor for pos >= -1
+    float t = (float)(conv->pos - i);
+    if (i != loaded) {
+      if (i < 0) memcpy(a, conv->last, sizeof(float) * channels);
+      else MapFrame(conv, pcm, i, a);
+      MapFrame(conv, pcm, i + 1, b);
+      loaded = i;
+    }
+    for (int c = 0; c < channels; c++) out.push_back(a[c] + (b[c] - a[c]) * t);
+    conv->pos += conv->step;
+  }
+  conv->pos -= n;
+  MapFrame(conv, pcm, n - 1, conv->last);
+}
+
+struct OggDecoder {
+  Stream* stream;
+  FILE* file;
+  OggVorbis_File vf;
+  bool opened;
+  bool loop;
+  bool finished;       // nothing more to decode
+  int rate;
+  Converter conv;
+  std::vector<float> pending;   // converted frames that didn't fit the ring
+  size_t offset;                // samples of pending already written
+  OggDecoder* next;
+};
+
+static SDL_Thread* thread_ = NULL;
+static SDL_mutex* lock_ = NULL;
+static SDL_cond* wake_ = NULL;
+static bool running_ = false;
+static OggDecoder* incoming_ = NULL;   // handed over by the JS thread
+
+static void FreeDecoder(OggDecoder* dec) {
+  if (dec->opened) ov_clear(&dec->vf);      // closes the file too
+  else if (dec->file) fclose(dec->file);
+  free(dec->stream->ring);
+  delete dec->stream;
+  delete dec;
+}
+
+static void Finish(OggDecoder* dec) {
+  dec->finished = true;
+  __sync_synchronize();
+  dec->stream->eof = 1;
+}
+
+// Writes as much pending output as the ring has room for.  Returns true when
+// all of it went in.
+static bool Flush(OggDecoder* dec) {
+  if (dec->pending.empty()) return true;
+  Stream* s = dec->stream;
+  const int channels = s->channels;
+  Uint32 head = s->head;
+  Uint32 target = s->target < s->capacity ? s->target : s->capacity;
+  Uint32 buffered = head - s->tail;
+  __sync_synchronize();
+  Uint32 room = buffered < target ? target - buffered : 0;
+  Uint32 frames = (Uint32)((dec->pending.size() - dec->offset) / channels);
+  if (frames > room) frames = room;
+
+  const float* from = &dec->pending[0] + dec->offset;
+  Uint32 at = head & (s->capacity - 1);
+  Uint32 first = s->capacity - at < frames ? s->capacity - at : frames;
+  memcpy(s->ring + at * channels, from, first * channels * sizeof(float));
+  memcpy(s->ring, from + first * channels, (frames - first) * channels * sizeof(float));
+  __sync_synchronize();
+  s->head = head + frames;
+
+  dec->offset += frames * channels;
+  if (dec->offset < dec->pending.size()) return false;
+  dec->pending.clear();
+  dec->offset = 0;
+  return true;
+}
+
+// Decodes until the stream holds its target or the file ends.
+static void Fill(OggDecoder* dec) {
+  if (!dec->opened) {
+    if (ov_open(dec->file, &dec->vf, NULL, 0) < 0) {
+      fclose(dec->file);
+      dec->file = NULL;
+      Finish(dec);
+      return;
+    }
+    dec->opened = true;
+    InitConverter(&dec->conv, ov_info(&dec->vf, -1), dec->rate, dec->stream->channels);
+  }
+
+  bool rewound = false;
+  while (Flush(dec)) {
+    float** pcm;
+    int bitstream;
+    long n = ov_read_float(&dec->vf, &pcm, DECODE_FRAMES, &bitstream);
+    if (n == OV_HOLE) continue;
+    if (n == 0 && dec->loop && !rewound && ov_pcm_seek(&dec->vf, 0) == 0) {
+      // Guards against files without a single frame.
+      rewound = true;
+      continue;
+    }
+    if (n <= 0) {
+      Finish(dec);
+      return;
+    }
+    rewound = false;
+
+    // Chained files may change format between links.
+    vorbis_info* info = ov_info(&dec->vf, -1);
+    if (info->channels != dec->conv.in_channels || info->rate != dec->conv.in_rate) {
+      InitConverter(&dec->conv, info, dec->rate, dec->stream->channels);
+    }
+    Convert(&dec->conv, pcm, (int)n, dec->pending);
+  }
+}
+
+static int DecoderMain(void* data) {
+  OggDecoder* decoders = NULL;
+
+  SDL_LockMutex(lock_);
+  while (running_) {
+    while (incoming_) {
+      OggDecoder* dec = incoming_;
+      incoming_ = dec->next;
+      dec->next = decoders;
+      decoders = dec;
+    }
+    SDL_UnlockMutex(lock_);
+
+    for (OggDecoder** link = &decoders; *link; ) {
+      OggDecoder* dec = *link;
+      if (dec->stream->released) {
+        *link = dec->next;
+        FreeDecoder(dec);
+        continue;
+      }
+      if (!dec->finished) Fill(dec);
+      link = &dec->next;
+    }
+
+    SDL_LockMutex(lock_);
+    if (running_ && !incoming_) SDL_CondWaitTimeout(wake_, lock_, DECODE_INTERVAL);
+  }
+  while (incoming_) {
+    OggDecoder* dec = incoming_;
+    incoming_ = dec->next;
+    dec->next = decoders;
+    decoders = dec;
+  }
+  SDL_UnlockMutex(lock_);
+
+  while (decoders) {
+    OggDecoder* dec = decoders;
+    decoders = dec->next;
+    FreeDecoder(dec);
+  }
+  return 0;
+}
+
+bool StartDecoder() {
+  if (thread_) return true;
+  if (!lock_) {
+    lock_ = SDL_CreateMutex();
+    wake_ = SDL_CreateCond();
+  }
+  running_ = true;
+  thread_ = SDL_CreateThread(DecoderMain, NULL);
+  if (!thread_) running_ = false;
+  return thread_ != NULL;
+}
+
+void StopDecoder() {
+  if (!thread_) return;
+  SDL_LockMutex(lock_);
+  running_ = false;
+  SDL_CondSignal(wake_);
+  SDL_UnlockMutex(lock_);
+  SDL_WaitThread(thread_, NULL);
+  thread_ = NULL;
+}
+
+Stream* OpenOggStream(FILE* file, int rate, int channels, int frames, bool loop) {
+  Uint32 capacity = 1024;
+  while (capacity < (Uint32)frames) capacity <<= 1;
+
+  Stream* stream = new Stream();
+  stream->ring = (float*)malloc(capacity * channels * sizeof(float));
+  if (!stream->ring) {
+    delete stream;
+    fclose(file);
+    return NULL;
+  }
+  stream->capacity = capacity;
+  stream->target = capacity;
+  stream->channels = channels;
+  stream->head = stream->tail = 0;
+  stream->eof = stream->released = 0;
+
+  OggDecoder* dec = new OggDecoder();
+  dec->stream = stream;
+  dec->file = file;
+  dec->opened = false;
+  dec->loop = loop;
+  dec->finished = false;
+  dec->rate = rate;
+  dec->offset = 0;
+
+  SDL_LockMutex(lock_);
+  dec->next = incoming_;
+  incoming_ = dec;
+  SDL_CondSignal(wake_);
+  SDL_UnlockMutex(lock_);
+  return stream;
+}
+
+Sound* DecodeOgg(const char* file, int rate, int channels, const char** error) {
+  FILE* f = fopen(file, "rb");
+  if (!f) {
+    *error = "Couldn't open file";
+    return NULL;
+  }
+  OggVorbis_File vf;
+  if (ov_open(f, &vf, NULL, 0) < 0) {
+    fclose(f);
+    *error = "Not an Ogg Vorbis file";
+    return NULL;
+  }
+
+  Converter conv;
+  InitConverter(&conv, ov_info(&vf, -1), rate, channels);
+  std::vector<float> pcm;
+  ogg_int64_t total = ov_pcm_total(&vf, -1);
+  if (total > 0) pcm.reserve((size_t)(total / conv.step + 1) * channels);
+
+  for (;;) {
+    float** block;
+    int bitstream;
+    long n = ov_read_float(&vf, &block, DECODE_FRAMES, &bitstream);
+    if (n == OV_HOLE) continue;
+    if (n < 0) {
+      ov_clear(&vf);
+      *error = "Corrupt Ogg Vorbis data";
+      return NULL;
+    }
+    if (n == 0) break;
+    vorbis_info* info = ov_info(&vf, -1);
+    if (info->channels != conv.in_channels || info->rate != conv.in_rate) {
+      InitConverter(&conv, info, rate, channels);
+    }
+    Convert(&conv, block, (int)n, pcm);
+  }
+  ov_clear(&vf);
+
+  Sound* sound = new Sound();
+  sound->channels = channels;
+  sound->frames = (int)(pcm.size() / channels);
+  sound->samples = (float*)malloc(pcm.size() * sizeof(float) + 1);
+  if (!sound->samples) {
+    delete sound;
+    *error = "Out of memory";
+    return NULL;
+  }
+  if (!pcm.empty()) memcpy(sound->samples, &pcm[0], pcm.size() * sizeof(float));
+  return sound;
+}
+
+} // sdl
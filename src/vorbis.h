@@ -0,0 +1,28 @@
+#ifndef NODE_SDL_VORBIS_H_
+#define NODE_SDL_VORBIS_H_
+
+#include <stdio.h>
+#include <SDL.h>
+
+#include "audio.h"
+
+namespace sdl {
+
+  // Starts and stops the thread that decodes streams.  Stopping frees every
+  // stream it still owns, so the audio device must be closed first.
+  bool StartDecoder();
+  void StopDecoder();
+
+  // Hands an open Ogg Vorbis file to the decoder thread, which takes ownership
+  // of it and fills the returned stream converted to the given rate and
+  // channel count.  The stream's ring holds at least `frames` frames.
+  // Returns NULL when out of memory (the file is closed).
+  Stream* OpenOggStream(FILE* file, int rate, int channels, int frames, bool loop);
+
+  // Decodes a whole Ogg Vorbis file converted to the given rate and channel
+  // count.  Safe on any thread.  Returns NULL and sets error on failure.
+  Sound* DecodeOgg(const char* file, int rate, int channels, const char** error);
+
+} // sdl
+
+#endif  // NODE_SDL_VORBIS_H_
@@ -0,0 +1,268 @@
+#include <SDL.h>
+#include <SDL_thread.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+#include <deque>
+
+#include "workers.h"
+
+namespace sdl {
+
+static const int MAX_WORKERS = 16;
+
+// One job at a time: ParallelFor holds job_lock_ for the whole call, so pixel
+// kernels invoked from different threads simply take turns.
+static SDL_mutex* job_lock_ = NULL;
+static SDL_mutex* lock_ = NULL;
+static SDL_cond* start_ = NULL;
+static SDL_cond* done_ = NULL;
+static int threads_ = 0;
+
+static ParallelBody body_;
+static void* ctx_;
+static int count_;
+static int grain_;
+static volatile int next_;
+static int generation_ = 0;
+static int busy_ = 0;
+
+static int CpuCount() {
+#ifdef _WIN32
+  return 1;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n < 1 ? 1 : (int)n;
+#endif
+}
+
+// Claims chunks until the loop is exhausted.
+static void RunChunks(int worker) {
+  for (;;) {
+    int begin = __sync_fetch_and_add(&next_, grain_);
+    if (begin >= count_) break;
+    int end = begin + grain_ < count_ ? begin + grain_ : count_;
+    body_(ctx_, begin, end, worker);
+  }
+}
+
+static int WorkerMain(void* data) {
+  int worker = (int)(long)data;
+  int seen = 0;
+  SDL_LockMutex(lock_);
+  for (;;) {
+    while (generation_ == seen) SDL_CondWait(start_, lock_);
+    seen = generation_;
+    SDL_UnlockMutex(lock_);
+
+    RunChunks(worker);
+
+    SDL_LockMutex(lock_);
+    if (--busy_ == 0) SDL_CondSignal(done_);
+  }
+  return 0;
+}
+
+// 0 = not started, 1 = starting, 2 = ready.
+static volatile int pool_state_ = 0;
+
+static bool StartPool() {
+  if (pool_state_ != 2) {
+    if (!__sync_bool_compare_and_swap(&pool_state_, 0, 1)) {
+      while (pool_state_ != 2) SDL_Delay(0);
+      return threads_ > 0;
+    }
+  } else {
+    return threads_ > 0;
+  }
+
+  job_lock_ = SDL_CreateMutex();
+  lock_ = SDL_CreateMutex();
+  start_ = SDL_CreateCond();
+  done_ = SDL_CreateCond();
+
+  int wanted = CpuCount() - 1;
+  if (wanted > MAX_WORKERS - 1) wanted = MAX_WORKERS - 1;
+  // Slot 0 belongs to the calling thread.
+  for (int i = 1; i <= wanted; i++) {
+    if (!SDL_CreateThread(WorkerMain, (void*)(long)i)) break;
+    threads_++;
+  }
+  __sync_synchronize();
+  pool_state_ = 2;
+  return threads_ > 0;
+}
+
+int WorkerCount() {
+  int n = CpuCount();
+  return n > MAX_WORKERS ? MAX_WORKERS : n;
+}
+
+void ParallelFor(int count, int grain, ParallelBody body, void* ctx) {
+  if (count <= 0) return;
+  if (grain < 1) grain = 1;
+  if (count <= grain || !StartPool()) {
+    body(ctx, 0, count, 0);
+    return;
+  }
+
+  SDL_LockMutex(job_lock_);
+
+  SDL_LockMutex(lock_);
+  body_ = body;
+  ctx_ = ctx;
+  count_ = count;
+  grain_ = grain;
+  next_ = 0;
+  busy_ = threads_;
+  generation_++;
+  SDL_CondBroadcast(start_);
+  SDL_UnlockMutex(lock_);
+
+  RunChunks(0);
+
+  SDL_LockMutex(lock_);
+  while (busy_ > 0) SDL_CondWait(done_, lock_);
+  SDL_UnlockMutex(lock_);
+
+  SDL_UnlockMutex(job_lock_);
+}
+
+// Task pool
+
+struct QueuedTask {
+  TaskBody body;
+  void* data;
+};
+
+// Queue 0 takes tasks spawned from outside the pool; queue i belongs to task
+// worker i.  Owners push and pop at the back, thieves take from the front.
+struct TaskQueue {
+  SDL_mutex* lock;
+  std::deque<QueuedTask> tasks;
+};
+
+static TaskQueue task_queues_[MAX_WORKERS];
+static Uint32 task_thread_ids_[MAX_WORKERS];
+static int task_threads_ = 0;
+static volatile int tasks_queued_ = 0;
+
+// Idle workers and RunTasksUntil callers sleep on task_wake_.
+static SDL_mutex* task_lock_ = NULL;
+static SDL_cond* task_wake_ = NULL;
+
+// The calling thread's queue: its own for pool threads, 0 for anyone else.
+static int TaskQueueIndex() {
+  Uint32 id = SDL_ThreadID();
+  for (int i = 1; i <= task_threads_; i++) {
+    if (task_thread_ids_[i] == id) return i;
+  }
+  return 0;
+}
+
+static bool PopTask(int index, bool back, QueuedTask* task) {
+  TaskQueue& queue = task_queues_[index];
+  bool found = false;
+  SDL_LockMutex(queue.lock);
+  if (!queue.tasks.empty()) {
+    if (back) {
+      *task = queue.tasks.back();
+      queue.tasks.pop_back();
+    } else {
+      *task = queue.tasks.front();
+      queue.tasks.pop_front();
+    }
+    found = true;
+  }
+  SDL_UnlockMutex(queue.lock);
+  if (found) __sync_fetch_and_sub(&tasks_queued_, 1);
+  return found;
+}
+
+// The newest task of our own queue, else the oldest of someone else's.
+static bool TakeTask(int self, QueuedTask* task) {
+  if (self && PopTask(self, true, task)) return true;
+  for (int i = 1; i <= task_threads_ + 1; i++) {
+    int victim = (self + i) % (task_threads_ + 1);
+    if (victim != self && PopTask(victim, false, task)) return true;
+  }
+  return !self && PopTask(0, false, task);
+}
+
+// Sleeps first: nothing is queued until the pool has finished starting.
+static int TaskWorkerMain(void* data) {
+  int self = (int)(long)data;
+  QueuedTask task;
+  for (;;) {
+    SDL_LockMutex(task_lock_);
+    while (tasks_queued_ == 0) SDL_CondWait(task_wake_, task_lock_);
+    SDL_UnlockMutex(task_lock_);
+    while (TakeTask(self, &task)) task.body(task.data);
+  }
+  return 0;
+}
+
+// 0 = not started, 1 = starting, 2 = ready.
+static volatile int task_pool_state_ = 0;
+
+static void StartTaskPool() {
+  if (task_pool_state_ == 2) return;
+  if (!__sync_bool_compare_and_swap(&task_pool_state_, 0, 1)) {
+    while (task_pool_state_ != 2) SDL_Delay(0);
+    return;
+  }
+
+  task_lock_ = SDL_CreateMutex();
+  task_wake_ = SDL_CreateCond();
+  for (int i = 0; i < MAX_WORKERS; i++) task_queues_[i].lock = SDL_CreateMutex();
+
+  // Threads waiting in RunTasksUntil help out, so one fewer than the cores.
+  int wanted = CpuCount() - 1;
+  if (wanted > MAX_WORKERS - 1) wanted = MAX_WORKERS - 1;
+  for (int i = 1; i <= wanted; i++) {
+    SDL_Thread* thread = SDL_CreateThread(TaskWorkerMain, (void*)(long)i);
+    if (!thread) break;
+    task_thread_ids_[i] = SDL_GetThreadID(thread);
+    task_threads_++;
+  }
+  __sync_synchronize();
+  task_pool_state_ = 2;
+}
+
+void SpawnTask(TaskBody body, void* data) {
+  StartTaskPool();
+  QueuedTask task = { body, data };
+  TaskQueue& queue = task_queues_[TaskQueueIndex()];
+  SDL_LockMutex(queue.lock);
+  queue.tasks.push_back(task);
+  SDL_UnlockMutex(queue.lock);
+
+  SDL_LockMutex(task_lock_);
+  __sync_fetch_and_add(&tasks_queued_, 1);
+  SDL_CondSignal(task_wake_);
+  SDL_UnlockMutex(task_lock_);
+}
+
+void RunTasksUntil(volatile int* counter) {
+  StartTaskPool();
+  QueuedTask task;
+  // A full barrier on the read, so whatever the tasks wrote is visible once
+  // the caller sees zero.
+  while (__sync_add_and_fetch(counter, 0) > 0) {
+    if (TakeTask(0, &task)) {
+      task.body(task.data);
+      continue;
+    }
+    SDL_LockMutex(task_lock_);
+    while (*counter > 0 && tasks_queued_ == 0) SDL_CondWait(task_wake_, task_lock_);
+    SDL_UnlockMutex(task_lock_);
+  }
+}
+
+void WakeTaskWaiters() {
+  SDL_LockMutex(task_lock_);
+  SDL_CondBroadcast(task_wake_);
+  SDL_UnlockMutex(task_lock_);
+}
+
+} // sdl
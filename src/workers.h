@@ -0,0 +1,35 @@
+#ifndef NODE_SDL_WORKERS_H_
+#define NODE_SDL_WORKERS_H_
+
+namespace sdl {
+
+  // Body of a parallel loop: processes items [begin, end) on behalf of the
+  // given worker slot (0 .. WorkerCount() - 1, stable for the whole call).
+  typedef void (*ParallelBody)(void* ctx, int begin, int end, int worker);
+
+  // Number of worker slots a ParallelFor body may be called with.
+  int WorkerCount();
+
+  // Runs body over [0, count) split into chunks of at least `grain` items on a
+  // lazily started pool of SDL threads, with the calling thread helping out.
+  // Returns when every chunk is done.  Small loops run inline on the caller.
+  // Calls are serialized, so a body must not start another ParallelFor.
+  void ParallelFor(int count, int grain, ParallelBody body, void* ctx);
+
+  // A step of a larger job, run once on some thread of the task pool.
+  typedef void (*TaskBody)(void* data);
+
+  // Queues a task on the work stealing pool, a second set of threads separate
+  // from ParallelFor's.  Spawned from a task, it goes on top of that worker's
+  // own queue, so a chain of steps tends to stay on one core while idle
+  // workers steal the oldest tasks from the other end.
+  void SpawnTask(TaskBody body, void* data);
+
+  // Runs queued tasks on the calling thread until *counter is zero.  Whoever
+  // takes a counter to zero must then call WakeTaskWaiters().
+  void RunTasksUntil(volatile int* counter);
+  void WakeTaskWaiters();
+
+} // sdl
+
+#endif  // NODE_SDL_WORKERS_H_